@@ -2498,10 +2498,11 @@ void Continuity::saveFile(int slot, Vector position, unsigned char *scrShotData,
 
 #else  // !BBGE_BUILD_PSP
 
-	doc.SaveFile(dsq->getSaveDirectory() + "/poot.tmp");
-
-	packFile(dsq->getSaveDirectory() + "/poot.tmp", getSaveFileName(slot, "aqs"), 9);
-	remove((dsq->getSaveDirectory() + "/poot.tmp").c_str());
+	// Compression and the actual write happen on DSQ's save writer
+	// thread; DSQ::onSaveWritten() reports the outcome.
+	TiXmlPrinter printer;
+	doc.Accept(&printer);
+	dsq->saveWriter.write(getSaveFileName(slot, "aqs"), printer.Str(), 9, slot);
 
 #endif
 
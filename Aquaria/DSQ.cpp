@@ -225,6 +225,9 @@ DSQ::DSQ(std::string fileSystem) : Core(fileSystem, LR_MAX, APPNAME, PARTICLE_AM
 	inputMode = INPUT_MOUSE;
 	overlay = 0;
 	recentSaveSlot = -1;
+#ifndef BBGE_BUILD_PSP
+	saveFailed = false;
+#endif
 	arialFontData = 0;
 
 #ifdef BBGE_BUILD_ACHIEVEMENTS_INTERNAL
@@ -608,7 +611,7 @@ void DSQ::debugMenu()
 		{
 			core->frameOutputMode = false;
 			dsq->game->togglePause(true);
-			std::string s = dsq->getUserInputString("1: Refresh\n2: Heal\n3: Reset Cont.\n5: Set Invincible\n6: Set Flag\n8: All Songs\n9: All Ups\nS: learn song #\nF: Find Entity\nC: Set Costume\n0: Learn MArea Songs\nR: Record Demo\nP: Playback Demo\nT: Rewind Demo\nU: Ouput Demo Frames\nB: Unload Resources\nA: Reload Resources\nM: AutoMap\nJ: JumpState\nQ: QuitNestedMain", "");
+			std::string s = dsq->getUserInputString("1: Refresh\n2: Heal\n3: Reset Cont.\n5: Set Invincible\n6: Set Flag\n8: All Songs\n9: All Ups\nS: learn song #\nF: Find Entity\nC: Set Costume\n0: Learn MArea Songs\nR: Record Demo\nP: Playback Demo\nT: Rewind Demo\nU: Ouput Demo Frames\nB: Unload Resources\nA: Reload Resources\nG: Path Benchmark\nL: Trace Benchmark\nN: Audio Benchmark\nX: Shot Benchmark\nM: AutoMap\nJ: JumpState\nQ: QuitNestedMain", "");
 			stringToUpper(s);
 
 			/*
@@ -794,6 +797,22 @@ void DSQ::debugMenu()
 				{
 					dsq->demo.clearRecordedFrames();
 				}
+				else if (c == 'G')
+				{
+					dsq->pathFinding.benchmark(200);
+				}
+				else if (c == 'L')
+				{
+					dsq->game->benchmarkTrace(2000);
+				}
+				else if (c == 'X')
+				{
+					dsq->game->benchmarkShotCollisions(300, 200);
+				}
+				else if (c == 'N')
+				{
+					dsq->benchmarkAudio(600);
+				}
 				else if (c == 'M')
 				{
 					dsq->game->autoMap->toggle(!dsq->game->autoMap->isOn());
@@ -816,6 +835,91 @@ void DSQ::debugMenu()
 	}
 }
 
+void DSQ::benchmarkAudio(int frames)
+{
+	if (!sound->enabled || sound->isPaused())
+	{
+		debugLog("Audio benchmark: sound is disabled or paused");
+		return;
+	}
+
+	// Run with the "nosound" device to measure the mixing cost without
+	// a sound card; the loopback renders as much audio as real time has
+	// passed, so the frames are paced rather than run flat out.
+	static const char *sfx[] = {"click", "menu-open", "PowerUp", "heartbeat"};
+	const int numSfx = sizeof(sfx)/sizeof(sfx[0]);
+	const float sec = 1.0f/60.0f;
+	const std::string oldMusic = sound->currentMusic;
+
+	SoundCacheStats cache0, cache1;
+	SoundStreamStats streams0, streams1;
+	sound->getStats(&cache0);
+	sound->getStats(&streams0);
+
+	// Fixed seed and schedule, so runs can be compared.
+	unsigned int seed = 12345;
+	uint32 updateMs = 0, worstMs = 0;
+	int played = 0;
+	const uint32 startTime = core->getTicks();
+	for (int i = 0; i < frames; i++)
+	{
+		if (i == 0)
+			sound->playMusic("openwaters3", SLT_LOOP);
+		else if (i == frames/2)
+			sound->playMusic("Veil", SLT_LOOP, SFT_CROSS, 1);
+		if (i == frames/5)
+			sound->playVoice("Naija_Intro1");
+		else if (i == (frames*3)/4)
+			sound->playVoice("titleb", SVT_INTERRUPT);
+		if (i % 5 == 0)
+		{
+			seed = seed*1103515245 + 12345;
+			const float pan = ((seed>>8) % 201) / 100.0f - 1;
+			seed = seed*1103515245 + 12345;
+			if (sound->playSfx(sfx[(seed>>8) % numSfx], 0.5f, pan))
+				played++;
+		}
+
+		const uint32 t = core->getTicks();
+		sound->update(sec);
+		const uint32 ms = core->getTicks() - t;
+		updateMs += ms;
+		worstMs = std::max(worstMs, ms);
+
+		const uint32 next = startTime + uint32((i+1)*sec*1000);
+		const uint32 now = core->getTicks();
+		if (next > now)
+		{
+#ifdef BBGE_BUILD_SDL
+			SDL_Delay(next - now);
+#endif
+#ifdef BBGE_BUILD_PSP
+			sys_time_delay((next - now)*0.001f);
+#endif
+		}
+	}
+	const uint32 ms = core->getTicks() - startTime;
+
+	sound->stopVoice();
+	sound->stopMusic();
+	sound->update(sec);
+	if (!oldMusic.empty())
+		sound->playMusic(oldMusic, SLT_LOOP, SFT_IN, 1);
+
+	sound->getStats(&cache1);
+	sound->getStats(&streams1);
+
+	std::ostringstream os;
+	os << "Audio benchmark: " << frames << " frames in " << ms << "ms, " << played << " sfx - update "
+	   << updateMs << "ms (worst " << worstMs << "ms) decode " << int((streams1.decodeSeconds - streams0.decodeSeconds)*1000)
+	   << "ms underruns " << (streams1.underruns - streams0.underruns)
+	   << " peak streams " << streams1.peakStreams << " (" << streams1.bytesPeak/1024 << "k buffers)"
+	   << " - sample cache " << (cache1.hits - cache0.hits) << " hits " << (cache1.misses - cache0.misses) << " misses "
+	   << (cache1.evictions - cache0.evictions) << " evictions, " << cache1.bytesPeak/1024 << "k peak";
+	debugLog(os.str());
+	screenMessage(os.str());
+}
+
 void DSQ::takeScreenshotKey()
 {
 	if (core->getCtrlState() && core->getAltState())
@@ -1584,6 +1688,8 @@ This build is not yet final, and as such there are a couple things lacking. They
 	}
 
 	precacher.precacheList("data/precache.txt", loadBitForTexPrecache);
+	if (debugLogTextures)
+		precacher.logReport();
 
 	setTexturePointers();
 
@@ -2237,14 +2343,167 @@ ModEntry* DSQ::getSelectedModEntry()
 	return 0;
 }
 
+// Bump this when the catalog format or the data taken from mod XML
+// files changes.
+const int MOD_CATALOG_VERSION = 1;
+
+static std::string getModCatalogFile()
+{
+	return dsq->getSaveDirectory() + "/modcache.xml";
+}
+
 void DSQ::loadMods()
 {
 	modEntries.clear();
-	
-	forEachFile(mod.getBaseModPath(), ".xml", loadModsCallback, 0);
+
+	// The catalog saved last time is still good as long as nothing was
+	// added to or removed from the mod folder.  Mod XML files edited in
+	// place are caught by comparing their own times below.
+	const std::string basePath = mod.getBaseModPath();
+	const unsigned long dirTime = getFileModTime(basePath);
+	if (!dirTime)
+	{
+		// Without file times (as on the PSP) the catalog could never be
+		// trusted, so just list the mods; the mod selector reads each
+		// description when it is first shown.
+		forEachFile(basePath, ".xml", loadModsCallback, 0);
+		selectedMod = 0;
+		return;
+	}
+
+	bool changed = false;
+	if (!loadModCatalog(basePath, dirTime))
+	{
+		modEntries.clear();
+		forEachFile(basePath, ".xml", loadModsCallback, 0);
+		changed = true;
+	}
+
+	for (int i = 0; i < modEntries.size(); i++)
+	{
+		ModEntry &e = modEntries[i];
+		const unsigned long xmlTime = getFileModTime(basePath + e.path + ".xml");
+		if (!xmlTime || xmlTime != e.xmlTime)
+		{
+			readModDescription(e);
+			e.xmlTime = xmlTime;
+			changed = true;
+		}
+	}
+
+	if (changed)
+		saveModCatalog(basePath, dirTime);
+
 	selectedMod = 0;
 }
 
+void DSQ::readModDescription(ModEntry &e)
+{
+	TiXmlDocument d;
+	mod.loadModXML(&d, e.path);
+
+	e.description = "";
+	e.described = true;
+	TiXmlElement *top = d.FirstChildElement("AquariaMod");
+	if (top)
+	{
+		TiXmlElement *desc = top->FirstChildElement("Description");
+		if (desc && desc->Attribute("text"))
+		{
+			e.description = desc->Attribute("text");
+			if (e.description.size() > 255)
+				e.description.resize(255);
+		}
+	}
+}
+
+bool DSQ::loadModCatalog(const std::string &basePath, unsigned long dirTime)
+{
+	TiXmlDocument doc;
+	if (!doc.LoadFile(getModCatalogFile()))
+		return false;
+
+	TiXmlElement *top = doc.FirstChildElement("ModCatalog");
+	if (!top)
+		return false;
+	int version = 0;
+	top->Attribute("version", &version);
+	const char *base = top->Attribute("base");
+	const char *time = top->Attribute("dirTime");
+	if (version != MOD_CATALOG_VERSION || !base || basePath != base
+		|| !time || strtoul(time, 0, 10) != dirTime)
+	{
+		return false;
+	}
+
+	for (TiXmlElement *m = top->FirstChildElement("Mod"); m; m = m->NextSiblingElement("Mod"))
+	{
+		const char *path = m->Attribute("path");
+		if (!path)
+			continue;
+		ModEntry e;
+		e.path = path;
+		if (m->Attribute("description"))
+			e.description = m->Attribute("description");
+		if (m->Attribute("xmlTime"))
+			e.xmlTime = strtoul(m->Attribute("xmlTime"), 0, 10);
+		e.described = true;
+		modEntries.push_back(e);
+	}
+
+	debugLog("Loaded mod catalog");
+	return true;
+}
+
+void DSQ::saveModCatalog(const std::string &basePath, unsigned long dirTime)
+{
+	TiXmlDocument doc;
+	TiXmlElement top("ModCatalog");
+	top.SetAttribute("version", MOD_CATALOG_VERSION);
+	top.SetAttribute("base", basePath);
+	std::ostringstream os;
+	os << dirTime;
+	top.SetAttribute("dirTime", os.str());
+
+	for (int i = 0; i < modEntries.size(); i++)
+	{
+		TiXmlElement m("Mod");
+		m.SetAttribute("path", modEntries[i].path);
+		m.SetAttribute("description", modEntries[i].description);
+		std::ostringstream os2;
+		os2 << modEntries[i].xmlTime;
+		m.SetAttribute("xmlTime", os2.str());
+		top.InsertEndChild(m);
+	}
+	doc.InsertEndChild(top);
+
+	if (!doc.SaveFile(getModCatalogFile()))
+		debugLog("Could not save mod catalog");
+}
+
+// Read the icons of the mods on either side of the selected one in the
+// background, so that flipping to them doesn't stall on the disk.  The
+// textures themselves still have to be created on the main thread.
+void DSQ::prefetchModIcons()
+{
+	const int range = 2;
+	std::vector<std::string> files;
+	const int n = modEntries.size();
+	for (int d = 1; d <= range && d*2 <= n; d++)
+	{
+		const int sides[2] = {selectedMod + d, selectedMod - d};
+		for (int j = 0; j < 2; j++)
+		{
+			const std::string png = modEntries[(sides[j] + n) % n].getIconTexture() + ".png";
+			if (!::exists(png, false))
+				continue;
+			const std::string cacheFile = Texture::getCacheFile(png);
+			files.push_back(cacheFile.empty() ? png : cacheFile);
+		}
+	}
+	modIconPrefetcher.prefetch(files);
+}
+
 void DSQ::playMenuSelectSfx()
 {
 	core->sound->playSfx("MenuSelect");
@@ -2252,6 +2511,13 @@ void DSQ::playMenuSelectSfx()
 
 void DSQ::playPositionalSfx(const std::string &sfx, const Vector &position, float f, float fadeOut)
 {
+	playPositionalSfx(sound->findSfxHandle(sfx), position, f, fadeOut);
+}
+
+void DSQ::playPositionalSfx(int sfx, const Vector &position, float f, float fadeOut)
+{
+	if (!sfx)
+		return;
 	if (f == 0)
 		f = 1;
 	if (dsq->game && dsq->game->avatar)
@@ -2301,6 +2567,10 @@ void DSQ::playPositionalSfx(const std::string &sfx, const Vector &position, floa
 
 void DSQ::shutdown()
 {
+#ifndef BBGE_BUILD_PSP
+	saveWriter.shutdown();
+#endif
+	modIconPrefetcher.shutdown();
 	scriptInterface.shutdown();
 	precacher.clean();
 	/*
@@ -2552,39 +2822,12 @@ void DSQ::clickRingEffect(Vector pos, int type, Vector color, float ut)
 
 Entity *DSQ::getEntityByName(std::string name)
 {
-	Entity *e = 0;
-	FOR_ENTITIES(i)
-	{
-		e = (*i);
-
-		if (e->life == 1 && (nocasecmp(e->name, name)==0))
-		{
-			break;
-		}
-		e = 0;
-	}
-	return e;
+	return entityGrid.getEntityByName(name);
 }
 
-// HACK: warning SLOW!
-// really?
 Entity *DSQ::getEntityByNameNoCase(std::string name)
 {
-	stringToUpper(name);
-	Entity *e = 0;
-	FOR_ENTITIES(i)
-	{
-		e = (*i);
-
-		std::string check =  e->name;
-		stringToUpper(check);
-		if (e->life == 1 && check == name)
-		{
-			break;
-		}
-		e = 0;
-	}
-	return e;
+	return entityGrid.getEntityByName(name);
 }
 
 void DSQ::doLoadMenu()
@@ -3193,6 +3436,46 @@ void DSQ::transitionSaveSlots()
 	}
 }
 
+#ifndef BBGE_BUILD_PSP
+
+void DSQ::onSaveWritten(const BackgroundWriter::Result &result)
+{
+	if (result.ok)
+	{
+		debugLog("Wrote " + result.file);
+	}
+	else
+	{
+		saveFailed = true;
+		errorLog("Failed to write save file [" + result.file + "]");
+	}
+}
+
+// Build the same uncompressed TGA file Core::tgaSave() would write for
+// 32-bit RGBA data.
+static std::string makeSaveScreenTGA(short width, short height, const unsigned char *imageData)
+{
+	const unsigned char header[12] = {0, 0, 2, 0, 0, 0, 0, 0, 0, 0, 0, 0};
+	const unsigned char bits[2] = {32, 0};
+	std::string tga((const char*)header, sizeof(header));
+	tga.append((const char*)&width, sizeof(width));
+	tga.append((const char*)&height, sizeof(height));
+	tga.append((const char*)bits, sizeof(bits));
+
+	const int size = width * height * 4;
+	tga.reserve(tga.size() + size);
+	for (int i = 0; i < size; i += 4)
+	{
+		tga += (char)imageData[i+2];
+		tga += (char)imageData[i+1];
+		tga += (char)imageData[i];
+		tga += (char)imageData[i+3];
+	}
+	return tga;
+}
+
+#endif  // !BBGE_BUILD_PSP
+
 void DSQ::doSaveSlotMenu(SaveSlotMode ssm, const Vector &position)
 {
 	int scrShotWidth = 0, scrShotHeight = 0;
@@ -3268,6 +3551,9 @@ void DSQ::doSaveSlotMenu(SaveSlotMode ssm, const Vector &position)
 		user.data.saveSlot = recentSaveSlot;
 		if (saveSlotMode == SSM_SAVE)
 		{
+#ifndef BBGE_BUILD_PSP
+			saveFailed = false;
+#endif
 			continuity.saveFile(selectedSaveSlot->getSlotIndex(), position, scrShotData, scrShotWidth, scrShotHeight);
 
 #ifndef BBGE_BUILD_PSP
@@ -3275,7 +3561,6 @@ void DSQ::doSaveSlotMenu(SaveSlotMode ssm, const Vector &position)
 			{
 				std::ostringstream os;
 				os << dsq->getSaveDirectory() << "/screen-" << numToZeroString(selectedSaveSlot->getSlotIndex(), 4) << ".zga";
-				std::string tempfile = dsq->getSaveDirectory() + "/poot-s.tmp";
 
 				//saveCenteredScreenshotTGA(tempfile, scrShotWidth);
 				//saveSizedScreenshotTGA(tempfile,512,1);
@@ -3287,19 +3572,34 @@ void DSQ::doSaveSlotMenu(SaveSlotMode ssm, const Vector &position)
 				int adjOffset = scrShotWidth * ((scrShotHeight-adjHeight)/2) * 4;
 				memmove(scrShotData, scrShotData + adjOffset, adjImageSize);
 				memset(scrShotData + adjImageSize, 0, imageDataSize - adjImageSize);
-				tgaSave(tempfile.c_str(), scrShotWidth, scrShotHeight, 32, scrShotData);
-				scrShotData = 0;  // deleted by tgaSave()
+				saveWriter.write(os.str(), makeSaveScreenTGA(scrShotWidth, scrShotHeight, scrShotData), 9, selectedSaveSlot->getSlotIndex());
+			}
 
-				packFile(dsq->getSaveDirectory() + "/poot-s.tmp", os.str(),9);
-				remove((dsq->getSaveDirectory() + "/poot-s.tmp").c_str());
+			// Keep the screen alive while the files are written.
+			if (saveWriter.isBusy())
+			{
+				Quad *spinner = new Quad("Progress", selectedSaveSlot->getWorldPosition());
+				spinner->followCamera = 1;
+				spinner->alpha = 0;
+				spinner->alpha.interpolateTo(1, 0.2);
+				spinner->rotation.interpolateTo(Vector(0,0,360), 1, -1);
+				addRenderObject(spinner, LR_MENU);
+				while (saveWriter.isBusy())
+					main(FRAME_TIME);
+				spinner->safeKill();
 			}
 #endif  // !BBGE_BUILD_PSP
 
-			PlaySfx sfx;
-			sfx.name = "saved";
-			sfx.vol = 0.55;
-			dsq->sound->playSfx(sfx);
-			confirm("", "saved", 1);
+#ifndef BBGE_BUILD_PSP
+			if (!saveFailed)
+#endif
+			{
+				PlaySfx sfx;
+				sfx.name = "saved";
+				sfx.vol = 0.55;
+				dsq->sound->playSfx(sfx);
+				confirm("", "saved", 1);
+			}
 
 			clearSaveSlots(true);
 		}
@@ -3852,28 +4152,21 @@ std::string DSQ::getDialogueFilename(const std::string &f)
 	return "dialogue/" + languagePack + "/" + f + ".txt";
 }
 
-void DSQ::jumpToSection(std::ifstream &inFile, const std::string &section)
+// Returns the index, within textCache.get(getDialogueFilename(dialogueFile)).lines,
+// of the first line of the given section, or -1 if it can't be found.
+int DSQ::jumpToSection(const std::string &section)
 {
-	if (section.empty()) return;
+	if (section.empty()) return -1;
 	std::string file = dsq->getDialogueFilename(dialogueFile);
-	if (!exists(file))
+	if (!textCache.get(file).found)
 	{
 		debugLog("Could not find dialogue [" + file + "]");
-		return;
+		return -1;
 	}
-	inFile.open(core->adjustFilenameCase(file).c_str());
-	std::string s;
-	while (std::getline(inFile, s))
-	{
-		if (!s.empty())
-		{
-			if (s.find("[")!=std::string::npos && s.find(section) != std::string::npos)
-			{
-				return;
-			}
-		}
-	}
-	debugLog("could not find section [" + section + "]");
+	int line = textCache.findSection(file, section);
+	if (line < 0)
+		debugLog("could not find section [" + section + "]");
+	return line;
 }
 
 
@@ -4238,6 +4531,12 @@ void DSQ::jiggleCursor()
 float skipSfxVol = 1.0;
 void DSQ::onUpdate(float dt)
 {
+#ifndef BBGE_BUILD_PSP
+	BackgroundWriter::Result saveResult;
+	while (saveWriter.getResult(saveResult))
+		onSaveWritten(saveResult);
+#endif
+
 	/*
 	if (hintTimer > 0)
 	{
@@ -4561,6 +4860,12 @@ void DSQ::onUpdate(float dt)
 		int ca, ma;
 		dsq->sound->getStats(&ca, &ma);
 		os << " ca: " << ca << " ma: " << ma << std::endl;
+		SoundCacheStats scs;
+		dsq->sound->getStats(&scs);
+		os << "sfxCache: " << scs.bytesUsed/1024 << "/" << scs.budget/1024 << "k (" << scs.numSounds << ") hits: " << scs.hits << " misses: " << scs.misses << " evict: " << scs.evictions << std::endl;
+		SoundStreamStats sss;
+		dsq->sound->getStats(&sss);
+		os << "streams: " << sss.activeStreams << " (peak " << sss.peakStreams << ") decode: " << sss.decodeSeconds << "s underruns: " << sss.underruns << std::endl;
 		os << dsq->sound->getVolumeString() << std::endl;
 		os << core->globalResolutionScale.x << ", " << core->globalResolutionScale.y << std::endl;
 		
@@ -4575,6 +4880,7 @@ void DSQ::onUpdate(float dt)
 		os << " | p: " << core->processedRenderObjectCount << " | t: " << core->totalRenderObjectCount;
 		os << " | s: " << dsq->continuity.seconds;
 		os << " | evQ: " << core->eventQueue.getSize();
+		os << " | iv: " << InterpolatedVector::getNumActive();
 		/*
 		os << " | s: " << dsq->continuity.seconds;
 		os << " cr: " << core->cullRadius;
@@ -4985,6 +5291,7 @@ void DSQ::addEntity(Entity *entity)
 		entities.resize(entities.size()*2, 0);
 	entities[i] = entity;
 	entities[i+1] = 0;
+	entityGrid.add(entity);
 }
 
 void DSQ::removeEntity(Entity *entity)
@@ -4995,6 +5302,8 @@ void DSQ::removeEntity(Entity *entity)
 		if (entities[i] == entity)
 			break;
 	}
+	if (entities[i] != 0)
+		entityGrid.remove(entity);
 	for (; entities[i] != 0; i++)
 	{
 		entities[i] = entities[i+1];
@@ -5009,6 +5318,7 @@ void DSQ::clearEntities()
 	{
 		entities[i] = 0;
 	}
+	entityGrid.clear();
 }
 
 
@@ -27,8 +27,11 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 #include "../BBGE/BitmapFont.h"
 #include "../BBGE/ScreenTransition.h"
 #include "../BBGE/Precacher.h"
+#include "../BBGE/BackgroundWriter.h"
+#include "../BBGE/FilePrefetcher.h"
 #include "../ExternalLibs/tinyxml.h"
 #include "AquariaMenuItem.h"
+#include "EntityGrid.h"
 #include "ScriptInterface.h"
 
 #include "PathFinding.h"
@@ -170,7 +173,6 @@ enum EditorLock
 const EditorLock editorLock = EDITORLOCK_USER;
 
 typedef std::list<Entity*> EntityList;
-typedef std::vector<Entity*> EntityContainer;
 
 #define FOR_ENTITIES(i) for (Entity **i = &dsq->entities[0]; *i != 0; i++)
 
@@ -201,6 +203,37 @@ struct SubLine
 	std::string line;
 };
 
+// Keeps the lines of small text files (dialogue, subtitles, the string
+// bank) in memory so that repeated lookups don't go back to the disk.
+// Section headers ("[name]" lines) are indexed when a file is read.
+// Entries are keyed by path, so switching language packs simply reads
+// the new files; everything is dropped when a mod is started or stopped.
+class TextCache
+{
+public:
+	struct File
+	{
+		File() : found(false) {}
+		bool found;
+		std::vector<std::string> lines;
+		// Section name -> index of the line following its header
+		std::map<std::string, int> sections;
+	};
+
+	TextCache();
+	const File &get(const std::string &path);
+	int findSection(const std::string &path, const std::string &section);
+	void clear();
+
+	// Incremented by clear(), so users can tell when to reparse.
+	int getGeneration() const { return generation; }
+
+protected:
+	typedef std::map<std::string, File> FileMap;
+	FileMap files;
+	int generation;
+};
+
 class StringBank
 {
 public:
@@ -212,6 +245,8 @@ protected:
 
 	typedef std::map<int, std::string> StringMap;
 	StringMap stringMap;
+	std::string loadedFile;
+	int loadedGeneration;
 };
 
 class SubtitlePlayer
@@ -237,7 +272,13 @@ protected:
 
 struct ModEntry
 {
+	ModEntry() : xmlTime(0), described(false) {}
 	std::string path;
+	std::string description;	// From the mod XML, cut to display length
+	unsigned long xmlTime;		// Mod time of the mod XML when it was read
+	bool described;				// False until description has been read
+
+	std::string getIconTexture() const;
 };
 
 class Mod
@@ -1315,6 +1356,7 @@ public:
 	void clearEntities();
 
 	EntityContainer entities;
+	EntityGrid entityGrid;
 
 	bool useFrameBuffer;
 	Continuity continuity;
@@ -1370,6 +1412,7 @@ public:
 	Element *getSolidElementNear(Vector pos, int rad);
 
 	std::string languagePack;
+	TextCache textCache;
 
 	int getEntityTypeIndexByName(std::string s);
 	void screenMessage(const std::string &msg);
@@ -1380,13 +1423,14 @@ public:
 	void toggleConsole();
 	void toggleEffects();
 	void debugMenu();
+	void benchmarkAudio(int frames);
 
 	std::string dialogueFile;
 
 	void takeScreenshot();
 	void takeScreenshotKey();
 
-	void jumpToSection(std::ifstream &inFile, const std::string &section);
+	int jumpToSection(const std::string &section);
 
 	PathFinding pathFinding;
 	void runGesture(const std::string &line);
@@ -1414,7 +1458,15 @@ public:
 	bool voiceOversEnabled;
 	int recentSaveSlot;
 
+#ifndef BBGE_BUILD_PSP
+	// Writes save files and save slot screenshots in the background.
+	BackgroundWriter saveWriter;
+	void onSaveWritten(const BackgroundWriter::Result &result);
+	bool saveFailed;
+#endif
+
 	void playPositionalSfx(const std::string &name, const Vector &position, float freq=1.0, float fadeOut=0);
+	void playPositionalSfx(int handle, const Vector &position, float freq=1.0, float fadeOut=0);
 
 	void playMenuSelectSfx();
 
@@ -1475,6 +1527,7 @@ public:
 	Mod mod;
 
 	void loadMods();
+	void prefetchModIcons();
 
 	std::vector<ModEntry> modEntries;
 	int selectedMod;
@@ -1484,6 +1537,15 @@ public:
 	void selectNextMod();
 	void selectPrevMod();
 	ModEntry* getSelectedModEntry();
+	void readModDescription(ModEntry &e);
+
+protected:
+	bool loadModCatalog(const std::string &basePath, unsigned long dirTime);
+	void saveModCatalog(const std::string &basePath, unsigned long dirTime);
+
+	FilePrefetcher modIconPrefetcher;
+
+public:
 
 #ifdef BBGE_BUILD_ACHIEVEMENTS_INTERNAL
 	BitmapText *achievement_text;
@@ -238,6 +238,8 @@ Entity::Entity() : StateMachine(), DFSprite()
 	followPos = 0;
 	watchingEntity = 0;
 	swimPath = false;
+	pathSpeedType = 0;
+	pathRequest = 0;
 	currentEntityTarget = 0;
 	deleteOnPathEnd = false;
 	shockTimer = 0;
@@ -496,6 +498,7 @@ void Entity::doFriction(float dt, int len)
 void Entity::setName(const std::string &name)
 {
 	this->name = name;
+	dsq->entityGrid.update(this);
 }
 
 Path *Entity::getNode()
@@ -560,30 +563,74 @@ void Entity::moveToNode(Path *path, int speedType, int dieOnPathEnd, bool swim)
 	position.ensureData();
 	position.data->path.clear();
 	position.stop();
+	position.stopPath();
 
 	ondulateTimer = 0;
 	swimPath = swim;
 	debugLog("Generating path to: " + path->name);
-	dsq->pathFinding.generatePath(this, TileVector(start), TileVector(dest));
-	int sz = position.data->path.getNumPathNodes();
-	position.data->path.addPathNode(path->nodes[0].position, 1);
-	VectorPath old = position.data->path;
+
+	// Long paths are planned on the zone graph and searched a leg at a
+	// time, as each one is finished.
+	std::vector<TileVector> waypoints;
+	dsq->pathFinding.getWaypoints(TileVector(start), TileVector(dest), waypoints);
+	pathWaypoints.clear();
+	for (int i = 0; i < int(waypoints.size())-1; i++)
+		pathWaypoints.push_back(waypoints[i].worldVector());
+	pathWaypoints.push_back(dest);
+	pathSpeedType = speedType;
+
 	std::ostringstream os;
-	os << "Path length: " << sz;
+	os << "Path legs: " << pathWaypoints.size();
 	debugLog(os.str());
 
-	debugLog("Regenerating section");
+	moveToNextWaypoint();
 
-	//int ms = sz % 12;
-	/*
-	if (sz > 12)
+	debugLog("Set delete on Path end");
+	deleteOnPathEnd = dieOnPathEnd;
+
+	debugLog("End of Generate Path");
+
+	//position.startSpeedPath(dsq->continuity.getSpeedType(speedType));
+	//position.startPath(((position.data->path.getNumPathNodes()*TILE_SIZE*4)-2)/dsq->continuity.getSpeedType(speedType));
+}
+
+// Queue the search for the next leg of a moveToNode() path.
+void Entity::moveToNextWaypoint()
+{
+	pathLegDest = pathWaypoints.front();
+	pathWaypoints.erase(pathWaypoints.begin());
+
+	if (pathRequest)
+		dsq->pathFinding.cancelRequest(pathRequest);
+	pathRequest = dsq->pathFinding.requestPath(TileVector(position), TileVector(pathLegDest));
+	this->vel = 0;
+}
+
+// Start along the leg once its search is done.
+void Entity::followPathLeg()
+{
+	Vector start = position;
+	Vector dest = pathLegDest;
+
+	if (dsq->pathFinding.getRequestState(pathRequest) == PATHREQUEST_FAILED && !pathWaypoints.empty())
 	{
-		int node = sz/2;
-		dsq->pathFinding.generatePath(this, TileVector(position), TileVector(position.path.getPathNode(node)->value));
-		old.splice(position.data->path, node);
-		position.data->path = old;
+		// The leg couldn't be found; try for the end directly.
+		debugLog("Path leg failed, searching to the end");
+		dsq->pathFinding.cancelRequest(pathRequest);
+		pathLegDest = pathWaypoints.back();
+		pathWaypoints.clear();
+		pathRequest = dsq->pathFinding.requestPath(TileVector(start), TileVector(pathLegDest));
+		return;
 	}
-	*/
+
+	dsq->pathFinding.finishRequest(pathRequest, this);
+	pathRequest = 0;
+	int sz = position.data->path.getNumPathNodes();
+	position.data->path.addPathNode(dest, 1);
+	std::ostringstream os;
+	os << "Path length: " << sz;
+	debugLog(os.str());
+
 	this->vel = 0;
 
 	debugLog("Molesting Path");
@@ -597,23 +644,10 @@ void Entity::moveToNode(Path *path, int speedType, int dieOnPathEnd, bool swim)
 	debugLog("Done");
 
 	debugLog("Calculating Time");
-	float time = position.data->path.getLength()/(float)dsq->continuity.getSpeedType(speedType);
+	float time = position.data->path.getLength()/(float)dsq->continuity.getSpeedType(pathSpeedType);
 	debugLog("Starting");
 	position.data->path.getPathNode(0)->value = position;
 	position.startPath(time);//, 1.0f/2.0f);
-
-	/*
-	if (dieOnPathEnd)
-		position.endOfPathEvent.set(MakeFunctionEvent(Entity, safeKill));
-	*/
-
-	debugLog("Set delete on Path end");
-	deleteOnPathEnd = dieOnPathEnd;
-
-	debugLog("End of Generate Path");
-
-	//position.startSpeedPath(dsq->continuity.getSpeedType(speedType));
-	//position.startPath(((position.data->path.getNumPathNodes()*TILE_SIZE*4)-2)/dsq->continuity.getSpeedType(speedType));
 }
 
 void Entity::addNodeToNodeGroup(int group, Path *p)
@@ -650,6 +684,12 @@ void Entity::setNodeGroupActive(int group, bool v)
 void Entity::stopFollowingPath()
 {
 	followingPath = 0;
+	pathWaypoints.clear();
+	if (pathRequest)
+	{
+		dsq->pathFinding.cancelRequest(pathRequest);
+		pathRequest = 0;
+	}
 	position.stopPath();
 }
 
@@ -759,6 +799,11 @@ void Entity::destroy()
 		// let the engine clean up hair
 		hair = 0;
 	}
+	if (pathRequest)
+	{
+		dsq->pathFinding.cancelRequest(pathRequest);
+		pathRequest = 0;
+	}
 	Shot::targetDied(this);
 	dsq->removeEntity(this);
 	Quad::destroy();
@@ -1461,7 +1506,7 @@ bool Entity::pathBurst(bool wallJump)
 
 bool Entity::isFollowingPath()
 {
-	return followingPath != 0 || position.isFollowingPath();
+	return followingPath != 0 || position.isFollowingPath() || pathRequest != 0;
 }
 
 void Entity::onPathEnd()
@@ -1935,6 +1980,9 @@ void Entity::onUpdate(float dt)
 	velocity.z = 0;
 	vel.z = 0;
 
+	if (pathRequest && dsq->pathFinding.getRequestState(pathRequest) != PATHREQUEST_PENDING)
+		followPathLeg();
+
 	bool wasFollowing = false;
 	if (isFollowingPath())
 		wasFollowing = true;
@@ -2005,7 +2053,16 @@ void Entity::onUpdate(float dt)
 
 	if (wasFollowing && !isFollowingPath())
 	{
-		onPathEnd();
+		// Go on to the next leg only if this one ran to its end.
+		if (!pathWaypoints.empty() && position.data->pathTimer > position.data->pathTime)
+		{
+			moveToNextWaypoint();
+		}
+		else
+		{
+			pathWaypoints.clear();
+			onPathEnd();
+		}
 	}
 	multColor.update(dt);
 
@@ -406,6 +406,8 @@ public:
 	void disableOverideMaxSpeed();
 	int currentEntityTarget;
 	void moveToNode(Path *path, int speedType, int dieOnPathEnd=0, bool swim = false);
+	void moveToNextWaypoint();
+	void followPathLeg();
 	bool isHit();
 	bool pathBurst(bool wallJump = false);
 	Timer burstTimer;
@@ -622,6 +624,13 @@ protected:
 	virtual void onPathEnd();
 	bool swimPath;
 	bool deleteOnPathEnd;
+	// Where a long moveToNode() path still has to go, one leg at a time.
+	// Each leg is searched by a queued request; pathRequest is its handle
+	// while it is pending, and 0 otherwise.
+	std::vector<Vector> pathWaypoints;
+	int pathSpeedType;
+	int pathRequest;
+	Vector pathLegDest;
 	int overideMaxSpeedValue;
 	float overideMaxSpeedTime;
 	InterpolatedVector multColor;
@@ -686,5 +695,35 @@ private:
 	int maxSpeed;
 	int oldMaxSpeed;
 
+	// Bookkeeping for DSQ::entityGrid
+	friend class EntityGrid;
+	Entity *gridNext, *gridPrev;
+	int gridCell;		// -1 while waiting for the next refresh
+	unsigned int gridSeq;
+	float gridReach;
+	Vector gridPos;
+	std::string gridName;
+
+};
+
+// Selects the entities an EntityGrid query is interested in.  The default
+// accept() takes entities that are present, other than the ignored one,
+// of the given type (ET_NOTYPE for any), that can be hit by the given
+// damage type (DT_NONE for any) and that are on a layer in
+// [layerStart, layerEnd] (-1 for any).
+struct EntityFilter
+{
+	EntityFilter(Entity *ignore=0, EntityType type=ET_NOTYPE, DamageType damageTarget=DT_NONE, int layerStart=-1, int layerEnd=-1)
+		: ignore(ignore), type(type), damageTarget(damageTarget), layerStart(layerStart), layerEnd(layerEnd) {}
+	virtual ~EntityFilter() {}
+	virtual bool accept(Entity *e) const;
+	// If not null, accept() only takes entities with this name (ignoring
+	// case), so queries can look them up by name instead of position.
+	virtual const char *getRequiredName() const { return 0; }
+
+	Entity *ignore;
+	EntityType type;
+	DamageType damageTarget;
+	int layerStart, layerEnd;
 };
 
@@ -0,0 +1,434 @@
+/*
+Copyright (C) 2007, 2010 - Bit-Blot
+
+This file is part of Aquaria.
+
+Aquaria is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+
+See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+*/
+#include "EntityGrid.h"
+#include "DSQ.h"
+#include "Game.h"
+#include "Entity.h"
+
+#include <algorithm>
+
+// Width of a grid cell in world units.  Most queries ask for a few
+// hundred pixels around a point, which keeps them to a handful of cells.
+const float ENTITYGRID_CELL_SIZE = 256;
+
+// Least amount of padding added to every query for entities that moved
+// since they were binned.
+const float ENTITYGRID_MIN_SLACK = 64;
+
+bool EntityFilter::accept(Entity *e) const
+{
+	if (e == ignore || !e->isPresent())
+		return false;
+	if (layerStart != -1 && layerEnd != -1 && (e->layer < layerStart || e->layer > layerEnd))
+		return false;
+	if (type != ET_NOTYPE && e->getEntityType() != type)
+		return false;
+	if (damageTarget != DT_NONE && !e->isDamageTarget(damageTarget))
+		return false;
+	return true;
+}
+
+EntityGrid::EntityGrid()
+{
+	// Positions outside the map are clamped into the border cells.
+	const float worldSize = MAX_GRID * TILE_SIZE;
+	cols = rows = int(ceilf(worldSize / ENTITYGRID_CELL_SIZE));
+	cells.resize(cols * rows, 0);
+	pending = 0;
+	numBinned = 0;
+	nextSeq = 0;
+	slack = ENTITYGRID_MIN_SLACK;
+	maxReach = 0;
+}
+
+bool EntityGrid::seqLess(const Entity *a, const Entity *b)
+{
+	return a->gridSeq < b->gridSeq;
+}
+
+int EntityGrid::cellCoord(float v, int n) const
+{
+	if (!(v > 0))
+		return 0;
+	const float c = v / ENTITYGRID_CELL_SIZE;
+	if (c >= n)
+		return n-1;
+	return int(c);
+}
+
+int EntityGrid::cellOf(const Vector &pos) const
+{
+	return cellCoord(pos.y, rows) * cols + cellCoord(pos.x, cols);
+}
+
+void EntityGrid::link(Entity *e, int cell)
+{
+	Entity *&head = (cell < 0) ? pending : cells[cell];
+	if (cell >= 0)
+		numBinned++;
+	e->gridCell = cell;
+	e->gridPrev = 0;
+	e->gridNext = head;
+	if (head)
+		head->gridPrev = e;
+	head = e;
+}
+
+void EntityGrid::unlink(Entity *e)
+{
+	if (e->gridPrev)
+		e->gridPrev->gridNext = e->gridNext;
+	else if (e->gridCell < 0)
+		pending = e->gridNext;
+	else
+		cells[e->gridCell] = e->gridNext;
+	if (e->gridCell >= 0)
+		numBinned--;
+	if (e->gridNext)
+		e->gridNext->gridPrev = e->gridPrev;
+	e->gridNext = e->gridPrev = 0;
+}
+
+void EntityGrid::indexName(Entity *e)
+{
+	e->gridName = e->name;
+	stringToLower(e->gridName);
+	EntityContainer &list = names[e->gridName];
+	list.insert(std::upper_bound(list.begin(), list.end(), e, seqLess), e);
+}
+
+void EntityGrid::unindexName(Entity *e)
+{
+	NameIndex::iterator it = names.find(e->gridName);
+	if (it == names.end())
+		return;
+	EntityContainer &list = it->second;
+	EntityContainer::iterator pos = std::find(list.begin(), list.end(), e);
+	if (pos != list.end())
+		list.erase(pos);
+	if (list.empty())
+		names.erase(it);
+}
+
+// New entities have no position or name yet, so they wait on the pending
+// list until the next refresh (or update()).
+void EntityGrid::add(Entity *e)
+{
+	e->gridSeq = nextSeq++;
+	e->gridReach = 0;
+	link(e, -1);
+}
+
+void EntityGrid::remove(Entity *e)
+{
+	if (e->gridCell >= 0)
+		unindexName(e);
+	unlink(e);
+}
+
+// Only called once DSQ::entities has been emptied, so the entities that
+// were in the grid are already gone.
+void EntityGrid::clear()
+{
+	std::fill(cells.begin(), cells.end(), (Entity*)0);
+	pending = 0;
+	numBinned = 0;
+	names.clear();
+	maxReach = 0;
+	slack = ENTITYGRID_MIN_SLACK;
+}
+
+// Move the entity to the cell for its current position, and recompute how
+// far its collision bones reach from that position.
+void EntityGrid::bin(Entity *e)
+{
+	const int cell = cellOf(e->position);
+	if (e->gridCell < 0)
+	{
+		unlink(e);
+		link(e, cell);
+		indexName(e);
+	}
+	else
+	{
+		if (cell != e->gridCell)
+		{
+			unlink(e);
+			link(e, cell);
+		}
+		if (nocasecmp(e->name, e->gridName) != 0)
+		{
+			unindexName(e);
+			indexName(e);
+		}
+	}
+	e->gridPos = e->position;
+
+	float reach = e->collideRadius;
+	for (int i = 0; i < e->skeletalSprite.bones.size(); i++)
+	{
+		Bone *b = e->skeletalSprite.bones[i];
+		float r;
+		if (!b->collisionMask.empty())
+			r = b->collisionMaskRadius;
+		else if (b->collideRadius)
+			r = b->collideRadius;
+		else
+			continue;
+		r += (b->getWorldCollidePosition() - e->position).getLength2D();
+		if (r > reach)
+			reach = r;
+	}
+	e->gridReach = reach;
+	if (reach > maxReach)
+		maxReach = reach;
+}
+
+// Rebin a single entity right away, e.g. after a teleport or a rename.
+// Pending entities are scanned by every query anyway, and may not have
+// their real position yet, so they stay where they are.
+void EntityGrid::update(Entity *e)
+{
+	if (e->gridCell >= 0)
+		bin(e);
+}
+
+// Rebin every entity.  Called once a frame, after all entities have moved.
+void EntityGrid::refresh()
+{
+	float maxMove = 0;
+	maxReach = 0;
+	FOR_ENTITIES(i)
+	{
+		Entity *e = *i;
+		if (e->gridCell >= 0)
+		{
+			// Anything that moved more than a cell in one frame was
+			// placed there; don't pad every query for it.
+			const float move = (e->position - e->gridPos).getLength2D();
+			if (move < ENTITYGRID_CELL_SIZE && move > maxMove)
+				maxMove = move;
+		}
+		bin(e);
+	}
+	slack = std::max(ENTITYGRID_MIN_SLACK, maxMove * 2);
+}
+
+void EntityGrid::getEntitiesInRange(const Vector &pos, float radius, EntityContainer &out, const EntityFilter *filter) const
+{
+	out.clear();
+	const float sqrRadius = radius*radius;
+	const float pad = radius + slack;
+	const int x0 = cellCoord(pos.x - pad, cols), x1 = cellCoord(pos.x + pad, cols);
+	const int y0 = cellCoord(pos.y - pad, rows), y1 = cellCoord(pos.y + pad, rows);
+	for (int y = y0; y <= y1; y++)
+	{
+		for (int x = x0; x <= x1; x++)
+		{
+			for (Entity *e = cells[y*cols+x]; e; e = e->gridNext)
+			{
+				if ((e->position - pos).getSquaredLength2D() <= sqrRadius && (!filter || filter->accept(e)))
+					out.push_back(e);
+			}
+		}
+	}
+	for (Entity *e = pending; e; e = e->gridNext)
+	{
+		if ((e->position - pos).getSquaredLength2D() <= sqrRadius && (!filter || filter->accept(e)))
+			out.push_back(e);
+	}
+	std::sort(out.begin(), out.end(), seqLess);
+}
+
+void EntityGrid::getEntitiesTouching(const Vector &pos, float radius, EntityContainer &out) const
+{
+	out.clear();
+	const float pad = radius + maxReach + slack;
+	const int x0 = cellCoord(pos.x - pad, cols), x1 = cellCoord(pos.x + pad, cols);
+	const int y0 = cellCoord(pos.y - pad, rows), y1 = cellCoord(pos.y + pad, rows);
+	for (int y = y0; y <= y1; y++)
+	{
+		for (int x = x0; x <= x1; x++)
+		{
+			for (Entity *e = cells[y*cols+x]; e; e = e->gridNext)
+			{
+				if ((e->position - pos).isLength2DIn(radius + e->gridReach + slack))
+					out.push_back(e);
+			}
+		}
+	}
+	// Bones haven't been measured for these yet.
+	for (Entity *e = pending; e; e = e->gridNext)
+		out.push_back(e);
+	std::sort(out.begin(), out.end(), seqLess);
+}
+
+// Keep out (and the matching dists) sorted nearest first, holding at most
+// n entities.
+void EntityGrid::consider(Entity *e, const Vector &pos, float sqrRadius, int n, const EntityFilter &filter, EntityContainer &out, std::vector<float> &dists) const
+{
+	const float dist = (e->position - pos).getSquaredLength2D();
+	if (dist > sqrRadius)
+		return;
+	if (out.size() == n && (dist > dists.back() || (dist == dists.back() && e->gridSeq > out.back()->gridSeq)))
+		return;
+	if (!filter.accept(e))
+		return;
+
+	int i = out.size();
+	while (i > 0 && (dists[i-1] > dist || (dists[i-1] == dist && out[i-1]->gridSeq > e->gridSeq)))
+		i--;
+	out.insert(out.begin() + i, e);
+	dists.insert(dists.begin() + i, dist);
+	if (out.size() > n)
+	{
+		out.pop_back();
+		dists.pop_back();
+	}
+}
+
+// Returns the number of entities in the cell.
+int EntityGrid::visitCell(int x, int y, const Vector &pos, float sqrRadius, int n, const EntityFilter &filter, EntityContainer &out, std::vector<float> &dists) const
+{
+	if (x < 0 || x >= cols || y < 0 || y >= rows)
+		return 0;
+	int count = 0;
+	for (Entity *e = cells[y*cols+x]; e; e = e->gridNext, count++)
+		consider(e, pos, sqrRadius, n, filter, out, dists);
+	return count;
+}
+
+// Searches outward from the cell containing pos one ring of cells at a
+// time, stopping once no entity further out could be nearer than the
+// ones already found, or once every binned entity has been looked at.
+// A search that has gone through many more cells than there are
+// entities (one that matches nothing, say) finishes by checking every
+// entity instead.  Queries for a name only look at the entities with
+// that name.
+int EntityGrid::getNearestEntities(const Vector &pos, float radius, int n, const EntityFilter &filter, EntityContainer &out) const
+{
+	out.clear();
+	if (n <= 0)
+		return 0;
+	std::vector<float> dists;
+	const float sqrRadius = radius*radius;
+
+	if (const char *name = filter.getRequiredName())
+	{
+		std::string key = name;
+		stringToLower(key);
+		NameIndex::const_iterator it = names.find(key);
+		if (it != names.end())
+		{
+			const EntityContainer &list = it->second;
+			for (int i = 0; i < list.size(); i++)
+				consider(list[i], pos, sqrRadius, n, filter, out, dists);
+		}
+		for (Entity *e = pending; e; e = e->gridNext)
+			consider(e, pos, sqrRadius, n, filter, out, dists);
+		return out.size();
+	}
+
+	for (Entity *e = pending; e; e = e->gridNext)
+		consider(e, pos, sqrRadius, n, filter, out, dists);
+
+	const int cx = cellCoord(pos.x, cols), cy = cellCoord(pos.y, rows);
+	int maxRing = std::max(std::max(cx, cols-1-cx), std::max(cy, rows-1-cy));
+	const float radiusRings = (radius + slack) / ENTITYGRID_CELL_SIZE + 2;
+	if (radiusRings < maxRing)
+		maxRing = int(radiusRings);
+
+	const int maxCells = 4 * (numBinned + 16);
+	int seen = 0, visited = 0;
+	for (int r = 0; r <= maxRing && seen < numBinned; r++)
+	{
+		if (visited > maxCells)
+		{
+			out.clear();
+			dists.clear();
+			FOR_ENTITIES(i)
+				consider(*i, pos, sqrRadius, n, filter, out, dists);
+			return out.size();
+		}
+
+		// Everything binned in ring r is at least this far away.
+		const float nearest = (r-1) * ENTITYGRID_CELL_SIZE - slack;
+		if (nearest > 0)
+		{
+			if (nearest > radius)
+				break;
+			if (out.size() == n && sqr(nearest) > dists.back())
+				break;
+		}
+
+		if (r == 0)
+		{
+			seen += visitCell(cx, cy, pos, sqrRadius, n, filter, out, dists);
+			visited++;
+			continue;
+		}
+		visited += 8*r;
+		for (int x = cx-r; x <= cx+r; x++)
+		{
+			seen += visitCell(x, cy-r, pos, sqrRadius, n, filter, out, dists);
+			seen += visitCell(x, cy+r, pos, sqrRadius, n, filter, out, dists);
+		}
+		for (int y = cy-r+1; y <= cy+r-1; y++)
+		{
+			seen += visitCell(cx-r, y, pos, sqrRadius, n, filter, out, dists);
+			seen += visitCell(cx+r, y, pos, sqrRadius, n, filter, out, dists);
+		}
+	}
+	return out.size();
+}
+
+Entity *EntityGrid::getNearestEntity(const Vector &pos, float radius, const EntityFilter &filter) const
+{
+	EntityContainer found;
+	getNearestEntities(pos, radius, 1, filter, found);
+	return found.empty() ? 0 : found[0];
+}
+
+Entity *EntityGrid::getEntityByName(const std::string &name) const
+{
+	Entity *found = 0;
+	std::string key = name;
+	stringToLower(key);
+	NameIndex::const_iterator it = names.find(key);
+	if (it != names.end())
+	{
+		const EntityContainer &list = it->second;
+		for (int i = 0; i < list.size(); i++)
+		{
+			if (list[i]->life == 1)
+			{
+				found = list[i];
+				break;
+			}
+		}
+	}
+	for (Entity *e = pending; e; e = e->gridNext)
+	{
+		if (e->life == 1 && nocasecmp(e->name, name) == 0 && (!found || e->gridSeq < found->gridSeq))
+			found = e;
+	}
+	return found;
+}
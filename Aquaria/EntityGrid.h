@@ -0,0 +1,98 @@
+/*
+Copyright (C) 2007, 2010 - Bit-Blot
+
+This file is part of Aquaria.
+
+Aquaria is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+
+See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+*/
+#pragma once
+
+#include "../BBGE/Base.h"
+
+class Entity;
+struct EntityFilter;
+
+typedef std::vector<Entity*> EntityContainer;
+
+// Buckets the entities in DSQ::entities by position on a uniform grid so
+// that range and nearest-entity queries only look at the entities close
+// to the query point.  Each entity remembers its cell; refresh() rebins
+// every entity once per frame, and only entities that changed cells are
+// relinked.  Entities spawned since the last refresh are kept on a
+// separate list that every query scans.
+//
+// Queries test each entity's current position, but they pick cells from
+// the binned positions, so the search area is padded by the distance the
+// entities moved over the last frame.  An entity that jumps further than
+// that outside of its own update (a script teleport, for instance) should
+// be passed to update().
+//
+// Results come back in DSQ::entities order, and ties in distance go to
+// the entity that comes first in that order, so the answers match a
+// FOR_ENTITIES loop over the same test.
+class EntityGrid
+{
+public:
+	EntityGrid();
+
+	void add(Entity *e);
+	void remove(Entity *e);
+	void clear();
+
+	void update(Entity *e);
+	void refresh();
+
+	// Entities within radius of pos that pass the filter (if any).
+	void getEntitiesInRange(const Vector &pos, float radius, EntityContainer &out, const EntityFilter *filter=0) const;
+	// Entities whose collideRadius or collision bones may reach a circle
+	// of the given radius around pos.  This is a conservative test; the
+	// caller still has to check the bones itself.
+	void getEntitiesTouching(const Vector &pos, float radius, EntityContainer &out) const;
+
+	// Nearest entities passing the filter, within radius (which may be
+	// HUGE_VALF), sorted nearest first.  Returns the number found.  If
+	// the filter requires a name, only entities with that name are
+	// looked at.
+	int getNearestEntities(const Vector &pos, float radius, int n, const EntityFilter &filter, EntityContainer &out) const;
+	Entity *getNearestEntity(const Vector &pos, float radius, const EntityFilter &filter) const;
+
+	// First entity with life == 1 whose name matches, ignoring case.
+	Entity *getEntityByName(const std::string &name) const;
+
+private:
+	static bool seqLess(const Entity *a, const Entity *b);
+
+	int cellCoord(float v, int n) const;
+	int cellOf(const Vector &pos) const;
+	void link(Entity *e, int cell);
+	void unlink(Entity *e);
+	void bin(Entity *e);
+	void indexName(Entity *e);
+	void unindexName(Entity *e);
+	int visitCell(int x, int y, const Vector &pos, float sqrRadius, int n, const EntityFilter &filter, EntityContainer &out, std::vector<float> &dists) const;
+	void consider(Entity *e, const Vector &pos, float sqrRadius, int n, const EntityFilter &filter, EntityContainer &out, std::vector<float> &dists) const;
+
+	typedef std::map<std::string, EntityContainer> NameIndex;
+
+	std::vector<Entity*> cells;
+	int cols, rows;
+	Entity *pending;
+	int numBinned;		// entities in cells (not pending)
+	NameIndex names;
+	unsigned int nextSeq;
+	float slack;		// padding for movement since the last refresh
+	float maxReach;		// largest gridReach of any binned entity
+};
@@ -111,6 +111,104 @@ void FlockEntity::destroy()
 }
 
 
+// Side of the cells used to bin a flock's members when looking for each
+// member's nearest flockmate.  SchoolFish only reacts to mates within its
+// separation distance, so cells of about that size usually find the
+// nearest mate in the first ring of cells searched.
+const float FLOCK_CELL_SIZE = 128;
+
+// Member positions (structure of arrays) and cell buckets for the flock
+// currently being processed by updateFlockData().  Kept between frames
+// to avoid reallocating.
+static std::vector<FlockEntity*> flockMembers;
+static std::vector<float> flockX, flockY;
+static std::vector<int> flockCell, flockNext, flockHead;
+
+// Find the nearest flockmate of each member of the current flock, using a
+// uniform grid over the flock's bounding box.  The search works outward
+// a ring of cells at a time and stops once no unsearched cell can hold a
+// closer mate, so the result is the same as comparing every pair.
+void FlockEntity::findNearestFlockMates(int numEntities)
+{
+	float minX = flockX[0], maxX = flockX[0];
+	float minY = flockY[0], maxY = flockY[0];
+	int i;
+	for (i = 1; i < numEntities; i++)
+	{
+		minX = std::min(minX, flockX[i]);
+		maxX = std::max(maxX, flockX[i]);
+		minY = std::min(minY, flockY[i]);
+		maxY = std::max(maxY, flockY[i]);
+	}
+
+	// Widely scattered flocks get bigger cells so the grid stays small.
+	float cellSize = FLOCK_CELL_SIZE;
+	int w, h;
+	for (;;)
+	{
+		w = int((maxX - minX) / cellSize) + 1;
+		h = int((maxY - minY) / cellSize) + 1;
+		if (w*h <= numEntities*4 + 16)
+			break;
+		cellSize *= 2;
+	}
+
+	flockHead.assign(w*h, -1);
+	for (i = numEntities-1; i >= 0; i--)
+	{
+		const int cx = std::min(int((flockX[i] - minX) / cellSize), w-1);
+		const int cy = std::min(int((flockY[i] - minY) / cellSize), h-1);
+		flockCell[i] = cy*w + cx;
+		flockNext[i] = flockHead[flockCell[i]];
+		flockHead[flockCell[i]] = i;
+	}
+
+	for (i = 0; i < numEntities; i++)
+	{
+		const float x = flockX[i], y = flockY[i];
+		const int cx = flockCell[i] % w, cy = flockCell[i] / w;
+		float bestSqr = HUGE_VALF;
+		int best = -1;
+		for (int r = 0; ; r++)
+		{
+			const int x1 = std::max(cx-r, 0), x2 = std::min(cx+r, w-1);
+			const int y1 = std::max(cy-r, 0), y2 = std::min(cy+r, h-1);
+			for (int gy = y1; gy <= y2; gy++)
+			{
+				// Only the outermost ring is new at this radius.
+				const bool edgeRow = (gy == cy-r || gy == cy+r);
+				const int gxStep = edgeRow ? 1 : 2*r;
+				for (int gx = edgeRow ? x1 : cx-r; gx <= x2; gx += gxStep)
+				{
+					if (gx < 0)
+						continue;
+					for (int j = flockHead[gy*w + gx]; j >= 0; j = flockNext[j])
+					{
+						if (j == i)
+							continue;
+						const float dx = flockX[j] - x, dy = flockY[j] - y;
+						const float distanceSqr = dx*dx + dy*dy;
+						if (distanceSqr < bestSqr)
+						{
+							bestSqr = distanceSqr;
+							best = j;
+						}
+					}
+				}
+			}
+			// Anything outside this ring is at least r cells away.
+			const float reach = r * cellSize;
+			if (bestSqr <= reach*reach)
+				break;
+			if (x1 == 0 && y1 == 0 && x2 == w-1 && y2 == h-1)
+				break;
+		}
+		FlockEntity *e = flockMembers[i];
+		e->nearestFlockMate = best >= 0 ? flockMembers[best] : 0;
+		e->nearestDistance = sqrtf(bestSqr);
+	}
+}
+
 void FlockEntity::updateFlockData(void)
 {
 	for (int flockID = 0; flockID < flocks.size(); flockID++)
@@ -125,29 +223,20 @@ void FlockEntity::updateFlockData(void)
 			{
 				flock->center += e->position;
 				flock->heading += e->vel;
-				e->nearestFlockMate = 0;
-				e->nearestDistance = HUGE_VALF;
-				for (FlockEntity *e2 = flock->firstEntity; e2 != e; e2 = e2->nextInFlock)
+				if (numEntities >= flockMembers.size())
 				{
-					const float distanceSqr = (e2->position - e->position).getSquaredLength2D();
-					if (distanceSqr < e->nearestDistance)
-					{
-						e->nearestFlockMate = e2;
-						// Record the square for now (we'll sqrt it later)
-						e->nearestDistance = distanceSqr;
-					}
-					if (distanceSqr < e2->nearestDistance)
-					{
-						e2->nearestFlockMate = e;
-						e2->nearestDistance = distanceSqr;
-					}
+					flockMembers.resize(numEntities*2 + 16);
+					flockX.resize(flockMembers.size());
+					flockY.resize(flockMembers.size());
+					flockCell.resize(flockMembers.size());
+					flockNext.resize(flockMembers.size());
 				}
+				flockMembers[numEntities] = e;
+				flockX[numEntities] = e->position.x;
+				flockY[numEntities] = e->position.y;
 				numEntities++;
 			}
-			for (FlockEntity *e = flock->firstEntity; e; e = e->nextInFlock)
-			{
-				e->nearestDistance = sqrtf(e->nearestDistance);
-			}
+			findNearestFlockMates(numEntities);
 			flock->center /= numEntities;
 			flock->heading /= numEntities;
 		}
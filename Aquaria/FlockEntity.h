@@ -66,4 +66,7 @@ protected:
 	FlockEntity *nextInFlock, *prevInFlock;
 	FlockEntity *nearestFlockMate;
 	float nearestDistance;
+
+private:
+	static void findNearestFlockMates(int numEntities);
 };
@@ -967,36 +967,7 @@ Ingredient *Game::getNearestIngredient(const Vector &pos, int radius)
 
 Entity *Game::getNearestEntity(const Vector &pos, int radius, Entity *ignore, EntityType et, DamageType dt, int lrStart, int lrEnd)
 {
-	int sqrRadius = radius*radius;
-	Entity *closest = 0;
-	int sml=-1;
-	int dist = 0;
-	FOR_ENTITIES(i)
-	{
-		Entity *e = *i;
-		dist = (e->position - pos).getSquaredLength2D();
-		if (dist <= sqrRadius)
-		{
-			if (e != ignore && e->isPresent())
-			{
-				if (lrStart == -1 || lrEnd == -1 || (e->layer >= lrStart && e->layer <= lrEnd))
-				{
-					if (et == ET_NOTYPE || e->getEntityType() == et)
-					{
-						if (dt == DT_NONE || e->isDamageTarget(dt))
-						{
-							if (sml == -1 || dist < sml)
-							{
-								closest = e;
-								sml = dist;
-							}
-						}
-					}
-				}
-			}
-		}
-	}
-	return closest;
+	return dsq->entityGrid.getNearestEntity(pos, radius, EntityFilter(ignore, et, dt, lrStart, lrEnd));
 }
 
 /*
@@ -1190,9 +1161,10 @@ void Game::spawnIngredientFromEntity(Entity *ent, IngredientData *data)
 	//addRenderObject(i, LR_ENTITIES);
 }
 
-Game::Game() : StateObject()
+Game::Game() : StateObject(), grid(MAX_GRID, 3), baseGrid(MAX_GRID, 3), wallDist(MAX_GRID, 7)
 {
 	applyingState = false;
+	trackGridWrites = false;
 	blurEffectsCheck = 0;
 	ripplesCheck = 0;
 
@@ -2203,19 +2175,110 @@ std::string Game::getNoteName(int n, const std::string &pre)
 
 void Game::reconstructEntityGrid()
 {
-	for (int x = 0; x < MAX_GRID; x++)
+	// Only the tiles entities filled in last time can differ from the map.
+	int i;
+	for (i = 0; i < gridOverlays.size(); i++)
 	{
-		for (int y = 0; y < MAX_GRID; y++)
-		{
-			grid[x][y] = baseGrid[x][y];
-		}
+		grid.copyRect(baseGrid, gridOverlays[i]);
+		dsq->pathFinding.invalidateZones(gridOverlays[i]);
 	}
 
+	fillEntityGrid();
+
+	for (i = 0; i < gridOverlays.size(); i++)
+		dsq->pathFinding.invalidateZones(gridOverlays[i]);
+}
+
+// Let every entity fill in its tiles, noting the area each one touched.
+void Game::fillEntityGrid()
+{
+	gridOverlays.clear();
+	trackGridWrites = true;
 	FOR_ENTITIES(i)
 	{
 		Entity *e = *i;
+		trackedGridWrites.x1 = trackedGridWrites.y1 = 0;
+		trackedGridWrites.x2 = trackedGridWrites.y2 = -1;
 		e->fillGrid();
+		if (trackedGridWrites.x1 <= trackedGridWrites.x2)
+			gridOverlays.push_back(trackedGridWrites);
+	}
+	trackGridWrites = false;
+}
+
+// Two-pass chessboard distance transform of baseGrid, a column at a
+// time.  Tiles outside the map count as obstructed, as getGrid() reports
+// them.
+void Game::computeWallDistance()
+{
+	std::vector<int> col(MAX_GRID), other(MAX_GRID);
+	int x, y;
+
+	wallDist.clear(0);
+	for (x = 0; x < MAX_GRID; x++)
+	{
+		const signed char *base = baseGrid.getColumn(x);
+		for (y = 0; y < MAX_GRID; y++)
+		{
+			if (base[y])
+			{
+				col[y] = 0;
+				continue;
+			}
+			int d = std::min(std::min(x+1, y+1), std::min(MAX_GRID-x, MAX_GRID-y));
+			if (y > 0)
+				d = std::min(d, col[y-1]+1);
+			if (x > 0)
+			{
+				d = std::min(d, other[y]+1);
+				if (y > 0)
+					d = std::min(d, other[y-1]+1);
+				if (y < MAX_GRID-1)
+					d = std::min(d, other[y+1]+1);
+			}
+			col[y] = std::min(d, WALLDIST_MAX);
+			wallDist.set(x, y, col[y]);
+		}
+		col.swap(other);
+	}
+	for (x = MAX_GRID-1; x >= 0; x--)
+	{
+		for (y = MAX_GRID-1; y >= 0; y--)
+		{
+			int d = wallDist.get(x, y);
+			if (y < MAX_GRID-1)
+				d = std::min(d, col[y+1]+1);
+			if (x < MAX_GRID-1)
+			{
+				d = std::min(d, other[y]+1);
+				if (y > 0)
+					d = std::min(d, other[y-1]+1);
+				if (y < MAX_GRID-1)
+					d = std::min(d, other[y+1]+1);
+			}
+			col[y] = d;
+			wallDist.set(x, y, d);
+		}
+		col.swap(other);
+	}
+	wallDist.compact();
+}
+
+// Returns a lower bound on the chessboard distance in tiles from the tile
+// to the nearest obstructed tile, taking entity obstructions into
+// account.  0 means the tile itself may be obstructed.
+int Game::getWallDistance(const TileVector &tile)
+{
+	if (tile.x < 0 || tile.x >= MAX_GRID || tile.y < 0 || tile.y >= MAX_GRID) return 0;
+	int d = wallDist.get(tile.x, tile.y);
+	for (int i = 0; i < gridOverlays.size(); i++)
+	{
+		const GridRect &r = gridOverlays[i];
+		const int dx = std::max(std::max(r.x1 - tile.x, tile.x - r.x2), 0);
+		const int dy = std::max(std::max(r.y1 - tile.y, tile.y - r.y2), 0);
+		d = std::min(d, std::max(dx, dy));
 	}
+	return d;
 }
 
 void Game::reconstructGrid(bool force)
@@ -2271,19 +2334,11 @@ void Game::reconstructGrid(bool force)
 		}
 	}
 
-	for (int x = 0; x < MAX_GRID; x++)
-	{
-		for (int y = 0; y < MAX_GRID; y++)
-		{
-			baseGrid[x][y] = grid[x][y];
-		}
-	}
+	grid.compact();
+	baseGrid.copy(grid);
+	computeWallDistance();
 
-	FOR_ENTITIES(i)
-	{
-		Entity *e = *i;
-		e->fillGrid();
-	}
+	fillEntityGrid();
 
 	dsq->pathFinding.generateZones();
 }
@@ -2291,6 +2346,8 @@ void Game::reconstructGrid(bool force)
 float Game::getCoverage(Vector pos, int sampleArea)
 {
 	TileVector t(pos);
+	if (getWallDistance(t) > sampleArea)
+		return 0;
 	int total = 0, covered = 0;
 	for (int x = t.x-sampleArea; x <= t.x+sampleArea; x++)
 	{
@@ -2314,6 +2371,8 @@ float Game::getPercObsInArea(Vector pos, int sampleArea, int obs)
 	int sz = sampleArea * sampleArea;
 	int c = 0;
 	TileVector t(pos);
+	if (obs == -1 && getWallDistance(t) > sampleArea)
+		return 0;
 
 	for (int x = t.x-sampleArea; x <= t.x+sampleArea; x++)
 	{
@@ -2335,9 +2394,13 @@ Vector Game::getWallNormal(Vector pos, int sampleArea, float *dist, int obs)
 	Vector avg;
 	int c = 0;
 	//float maxLen = -1;
-	std::vector<Vector> vs;
 	if (dist != NULL)
 		*dist = -1;
+	// Nothing in the sample area, so no normal.
+	if (obs == -1 && getWallDistance(t) > sampleArea)
+		return avg;
+	// Only walls closer than this push on the normal.
+	int sz = (TILE_SIZE*(sampleArea-1));
 	for (int x = t.x-sampleArea; x <= t.x+sampleArea; x++)
 	{
 		for (int y = t.y-sampleArea; y <= t.y+sampleArea; y++)
@@ -2371,7 +2434,13 @@ Vector Game::getWallNormal(Vector pos, int sampleArea, float *dist, int obs)
 				*/
 				//Vector v(xDiff*xEffect, yDiff*yEffect);
 				Vector v(xDiff, yDiff);
-				vs.push_back (v);
+				float len = v.getLength2D();
+				if (len < sz)
+				{
+					v.setLength2D(sz - len);
+					c++;
+					avg += v;
+				}
 
 				if (dist!=NULL)
 				{
@@ -2392,17 +2461,6 @@ Vector Game::getWallNormal(Vector pos, int sampleArea, float *dist, int obs)
 			}
 		}
 	}
-	int sz = (TILE_SIZE*(sampleArea-1));
-	for (int i = 0; i < vs.size(); i++)
-	{
-		float len = vs[i].getLength2D();
-		if (len < sz)
-		{
-			vs[i].setLength2D(sz - len);
-			c++;
-			avg += vs[i];
-		}
-	}
 	if (avg != 0)
 	{
 		avg /= c;
@@ -5368,6 +5426,11 @@ void Game::setMusicToPlay(const std::string &m)
 {
 	musicToPlay = m;
 	stringToLower(musicToPlay);
+
+	// Get the track ready now so updateMusic() can crossfade into it
+	// without waiting on the file.
+	if (overrideMusic.empty() && musicToPlay != "none")
+		core->sound->prefetchMusic(musicToPlay, SLT_LOOP);
 }
 
 void Game::findMaxCameraValues()
@@ -5469,6 +5532,40 @@ Entity *Game::getEntityInGroup(int gid, int iter)
 	return 0;
 }
 
+// Start reading the files for every scene the player can warp to from
+// here, so the next transition finds them in the OS file cache.
+void Game::prefetchAdjacentScenes()
+{
+	std::vector<std::string> scenes;
+	int i;
+	for (i = 0; i < warpAreas.size(); i++)
+		scenes.push_back(warpAreas[i].sceneName);
+	for (i = 0; i < paths.size(); i++)
+	{
+		if (!paths[i]->warpMap.empty())
+			scenes.push_back(paths[i]->warpMap);
+	}
+
+	std::vector<std::string> neighbors;
+	for (i = 0; i < scenes.size(); i++)
+	{
+		std::string scene = scenes[i];
+		stringToLower(scene);
+		if (scene.empty() || nocasecmp(scene, sceneName) == 0)
+			continue;
+		if (std::find(neighbors.begin(), neighbors.end(), scene) == neighbors.end())
+			neighbors.push_back(scene);
+	}
+
+	if (!neighbors.empty())
+	{
+		std::ostringstream os;
+		os << "Prefetching " << neighbors.size() << " adjacent scene(s)";
+		debugLog(os.str());
+		scenePrefetcher.prefetchScenes(neighbors);
+	}
+}
+
 bool Game::loadScene(std::string scene)
 {
 	stringToLower(scene);
@@ -6378,6 +6475,9 @@ void Game::applyState()
 	bool verbose = true;
 	applyingState = true;	
 
+	// Don't compete with the scene load for the disk.
+	scenePrefetcher.cancel();
+
 	helpText = 0;
 	helpUp = helpDown = 0;
 	inHelpScreen = false;
@@ -7156,6 +7256,8 @@ void Game::applyState()
 	
 	dsq->forceInputGrabOff();
 
+	prefetchAdjacentScenes();
+
 	debugLog("Game::applyState Done");
 }
 
@@ -8729,13 +8831,20 @@ bool Game::isEntityCollideWithShot(Entity *e, Shot *shot)
 	return true;
 }
 
+// The shot collision checks only look at the shots near the entity.  A
+// shot removed by an earlier hit in the same loop is skipped, just as it
+// would have dropped out of Shot::shots.
 void Game::handleShotCollisions(Entity *e, bool hasShield)
 {
 	BBGE_PROF(Game_handleShotCollisions);
 	bool isRegValid=true;
-	for (Shot::Shots::iterator i = Shot::shots.begin(); i != Shot::shots.end(); i++)
+	std::vector<Shot*> shots;
+	Shot::grid.getShotsNear(e->getNumTargetPoints()>0 ? e->getTargetPoint(0) : e->position+e->offset, e->collideRadius, shots);
+	for (int i = 0; i < shots.size(); i++)
 	{
-		Shot *shot = *i;
+		Shot *shot = shots[i];
+		if (shot->isRemoved())
+			continue;
 		if (isEntityCollideWithShot(e, shot) && (!hasShield || (!shot->shotData || !shot->shotData->ignoreShield)))
 		{
 			Vector collidePoint = e->position+e->offset;
@@ -8765,9 +8874,27 @@ bool Game::isDamageTypeEnemy(DamageType dt)
 void Game::handleShotCollisionsSkeletal(Entity *e)
 {
 	BBGE_PROF(Game_HSSKELETAL);
-	for (Shot::Shots::iterator i = Shot::shots.begin(); i != Shot::shots.end(); i++)
+	// How far from the entity a bone could be hit; collideSkeletalVsCircle()
+	// gives up beyond 2000 regardless.
+	float reach = 0;
+	for (int i = 0; i < e->skeletalSprite.bones.size(); i++)
 	{
-		Shot *shot = *i;
+		Bone *b = e->skeletalSprite.bones[i];
+		if (b->alpha.x == 1 && b->renderQuad && (!b->collisionMask.empty() || b->collideRadius))
+		{
+			float r = b->collisionMask.empty() ? b->collideRadius : b->collisionMaskRadius;
+			r += (b->getWorldCollidePosition() - e->position).getLength2D();
+			if (r > reach)
+				reach = r;
+		}
+	}
+	std::vector<Shot*> shots;
+	Shot::grid.getShotsNear(e->position, std::min(reach, 2000.0f), shots);
+	for (int i = 0; i < shots.size(); i++)
+	{
+		Shot *shot = shots[i];
+		if (shot->isRemoved())
+			continue;
 		if (isEntityCollideWithShot(e, shot))
 		{
 			Bone *b = collideSkeletalVsCircle(e, shot->position, shot->collideRadius);
@@ -8782,9 +8909,24 @@ void Game::handleShotCollisionsSkeletal(Entity *e)
 
 void Game::handleShotCollisionsHair(Entity *e, int num)
 {
-	for (Shot::Shots::iterator i = Shot::shots.begin(); i != Shot::shots.end(); i++)
+	if (!e->hair)
+		return;
+	// Hair nodes are the only thing tested, so look around them.
+	const int numNodes = num ? num : e->hair->hairNodes.size();
+	float reach = 0;
+	for (int i = 0; i < numNodes; i++)
+	{
+		const float r = (e->hair->hairNodes[i].position - e->position).getLength2D();
+		if (r > reach)
+			reach = r;
+	}
+	std::vector<Shot*> shots;
+	Shot::grid.getShotsNear(e->position, reach + e->hair->hairWidth + 8, shots);
+	for (int i = 0; i < shots.size(); i++)
 	{
-		Shot *shot = *i;
+		Shot *shot = shots[i];
+		if (shot->isRemoved())
+			continue;
 		if (isEntityCollideWithShot(e, shot))
 		{
 			bool b = collideHairVsCircle(e, num, shot->position, 8);
@@ -8802,9 +8944,11 @@ CollideData Game::collideCircleWithAllEntities(Vector pos, float r, Entity *me,
 	CollideData c;
 	//if (me && (checkHitEntitiesFlag && !me->hitEntity)) return 0;
 	//Avatar *a = dynamic_cast<Avatar*>(me);
-	FOR_ENTITIES(i)
+	static EntityContainer nearby;
+	dsq->entityGrid.getEntitiesTouching(pos, r, nearby);
+	for (int n = 0; n < nearby.size(); n++)
 	{
-		Entity *e = *i;
+		Entity *e = nearby[n];
 
 		if (me != e)
 		{
@@ -10240,52 +10384,373 @@ bool Game::isControlHint()
 	return controlHint_bg->alpha.x != 0;
 }
 
+// Steps along the line a tile at a time.  Each step checks the tile
+// under it, then stops if within two tiles of the target, then checks
+// six tiles on either side.  This is the line-of-sight test the game
+// uses; traceLine() and traceWide() are exact alternatives that only
+// benchmarkTrace() calls so far.
 bool Game::trace(Vector start, Vector target)
 {
-	/*
-	TileVector tstart(start);
-	TileVector ttarget(target);
-	*/
+	return traceSampled(start, target, true);
+}
+
+// With cull set, steps that are far enough from any wall skip the side
+// checks, which can't find anything there.  The result is the same.
+bool Game::traceSampled(const Vector &start, const Vector &target, bool cull)
+{
 	int i = 0;
 	Vector mov(target-start);
 	Vector pos = start;
-	//mov.normalize2D();
-	//mov |= g;
-	//mov |= 0.5;
 	mov.setLength2D(TILE_SIZE*1);
+	const Vector pl = mov.getPerpendicularLeft();
+	const Vector pr = mov.getPerpendicularRight();
+	int skip = 0;
 	int c = 0;
 	// 1024
 	while (c < 2048*10)
 	{
+		c++;
 		pos += mov;
 
-
-		if (dsq->game->isObstructed(TileVector(pos)))
+		if (isObstructed(TileVector(pos)))
 			return false;
 
-
-		//Vector diff(tstart.x - ttarget.x, tstart.y - ttarget.y);
 		Vector diff = target - pos;
 		if (diff.getSquaredLength2D() <= sqr(TILE_SIZE*2))
 			//close enough!
 			return true;
 
-		Vector pl = mov.getPerpendicularLeft();
-		Vector pr = mov.getPerpendicularRight();
-		i = 1;
+		if (skip > 0)
+		{
+			skip--;
+			continue;
+		}
+		if (cull)
+		{
+			// The side checks land within 7 tiles of this step's tile,
+			// and each step moves at most one tile.
+			const int d = getWallDistance(TileVector(pos));
+			if (d > 7)
+			{
+				skip = d - 8;
+				continue;
+			}
+		}
+
 		for (i = 1; i <= 6; i++)
 		{
-			TileVector tl(pos + pl*i);//(start.x + pl.x*i, start.y + pl.y*i);
-			TileVector tr(pos + pr*i);//(start.x + pr.x*i, start.y + pr.y*i);
-			if (dsq->game->isObstructed(tl) || dsq->game->isObstructed(tr))
+			TileVector tl(pos + pl*i);
+			TileVector tr(pos + pr*i);
+			if (isObstructed(tl) || isObstructed(tr))
 				return false;
 		}
-
-		c++;
 	}
 	return false;
 }
 
+// Set up a grid walk from start to end (Amanatides & Woo).  Returns the
+// number of tile steps to the end tile.
+static int beginTileWalk(const Vector &start, const Vector &end, int &x, int &y, int &stepX, int &stepY,
+						 float &tMaxX, float &tMaxY, float &tDeltaX, float &tDeltaY, int &tx, int &ty)
+{
+	const float sx = start.x/TILE_SIZE, sy = start.y/TILE_SIZE;
+	const float ex = end.x/TILE_SIZE, ey = end.y/TILE_SIZE;
+	x = int(floorf(sx));
+	y = int(floorf(sy));
+	tx = int(floorf(ex));
+	ty = int(floorf(ey));
+	stepX = tx > x ? 1 : -1;
+	stepY = ty > y ? 1 : -1;
+	const float dx = ex - sx, dy = ey - sy;
+	tDeltaX = dx != 0 ? fabsf(1/dx) : 0;
+	tDeltaY = dy != 0 ? fabsf(1/dy) : 0;
+	tMaxX = dx > 0 ? (x+1 - sx)/dx : (dx < 0 ? (x - sx)/dx : 0);
+	tMaxY = dy > 0 ? (y+1 - sy)/dy : (dy < 0 ? (y - sy)/dy : 0);
+	return abs(tx - x) + abs(ty - y);
+}
+
+// Move to the next tile the line passes through.  Returns true for a
+// step in x.  Once one axis has reached the end tile, only the other
+// one moves, so rounding can't carry the walk past the end.
+static inline bool stepTileWalk(int &x, int &y, int stepX, int stepY, float &tMaxX, float &tMaxY,
+								float tDeltaX, float tDeltaY, int tx, int ty)
+{
+	if (y == ty || (x != tx && tMaxX < tMaxY))
+	{
+		x += stepX;
+		tMaxX += tDeltaX;
+		return true;
+	}
+	y += stepY;
+	tMaxY += tDeltaY;
+	return false;
+}
+
+// True if no tile the segment passes through is obstructed, the start
+// and end tiles included.
+bool Game::traceLine(const Vector &start, const Vector &end)
+{
+	int x, y, stepX, stepY, tx, ty;
+	float tMaxX, tMaxY, tDeltaX, tDeltaY;
+	int n = beginTileWalk(start, end, x, y, stepX, stepY, tMaxX, tMaxY, tDeltaX, tDeltaY, tx, ty);
+	for (;;)
+	{
+		if (isObstructed(TileVector(x, y)))
+			return false;
+		if (n-- == 0)
+			return true;
+		// The rest of the line stays inside the box between here and the
+		// end tile.
+		if (getWallDistance(TileVector(x, y)) > std::max(abs(tx - x), abs(ty - y)))
+			return true;
+		stepTileWalk(x, y, stepX, stepY, tMaxX, tMaxY, tDeltaX, tDeltaY, tx, ty);
+	}
+}
+
+// The swept-width form of trace(): every tile touched by the rectangle
+// extending radius tiles to either side of the segment must be clear.
+// Like trace(), the corridor stops two tiles short of the end; a segment
+// shorter than that only needs traceLine().  Columns of the rectangle
+// that are far enough from any wall aren't checked tile by tile.
+bool Game::traceWide(const Vector &start, const Vector &end, int radius)
+{
+	const float cutoff = TILE_SIZE*2;
+	Vector dir = end - start;
+	const float len = dir.getLength2D();
+	if (len <= cutoff)
+		return traceLine(start, end);
+	dir /= len;
+
+	// Corners of the corridor, in tiles.
+	const Vector a = start / TILE_SIZE;
+	const Vector b = (start + dir * (len - cutoff)) / TILE_SIZE;
+	const Vector side = dir.getPerpendicularLeft() * radius;
+	const Vector corners[4] = { a + side, b + side, b - side, a - side };
+
+	float minX = corners[0].x, maxX = corners[0].x;
+	int k;
+	for (k = 1; k < 4; k++)
+	{
+		minX = std::min(minX, corners[k].x);
+		maxX = std::max(maxX, corners[k].x);
+	}
+
+	const int x1 = int(floorf(minX)), x2 = int(floorf(maxX));
+	for (int x = x1; x <= x2; x++)
+	{
+		// The rectangle is convex, so its extent within this column
+		// comes from where its edges cross the column.
+		const float sx1 = std::max(float(x), minX), sx2 = std::min(float(x+1), maxX);
+		float minY = HUGE_VALF, maxY = -HUGE_VALF;
+		for (k = 0; k < 4; k++)
+		{
+			const Vector &p = corners[k], &q = corners[(k+1)%4];
+			const float ex1 = std::max(std::min(p.x, q.x), sx1);
+			const float ex2 = std::min(std::max(p.x, q.x), sx2);
+			if (ex1 > ex2)
+				continue;
+			if (p.x == q.x)
+			{
+				minY = std::min(minY, std::min(p.y, q.y));
+				maxY = std::max(maxY, std::max(p.y, q.y));
+				continue;
+			}
+			const float slope = (q.y - p.y) / (q.x - p.x);
+			const float y1 = p.y + (ex1 - p.x) * slope, y2 = p.y + (ex2 - p.x) * slope;
+			minY = std::min(minY, std::min(y1, y2));
+			maxY = std::max(maxY, std::max(y1, y2));
+		}
+		if (minY > maxY)
+			continue;
+
+		const int y1 = int(floorf(minY)), y2 = int(floorf(maxY));
+		const int mid = (y1 + y2) / 2;
+		if (getWallDistance(TileVector(x, mid)) > std::max(mid - y1, y2 - mid))
+			continue;
+		for (int y = y1; y <= y2; y++)
+		{
+			if (isObstructed(TileVector(x, y)))
+				return false;
+		}
+	}
+	return true;
+}
+
+// Time the trace functions on random segments of the current map, and
+// count how often each agrees with the original trace().
+void Game::benchmarkTrace(int numRays)
+{
+	TileVector tmin(cameraMin), tmax(cameraMax);
+	tmin.x = std::max(tmin.x, 0);
+	tmin.y = std::max(tmin.y, 0);
+	tmax.x = std::min(tmax.x, MAX_GRID-1);
+	tmax.y = std::min(tmax.y, MAX_GRID-1);
+	if (tmax.x <= tmin.x || tmax.y <= tmin.y)
+	{
+		debugLog("Trace benchmark: no map loaded");
+		return;
+	}
+
+	// Fixed seed, so runs on the same map can be compared.  Half the
+	// segments are short, as most line-of-sight checks are.
+	std::vector<Vector> starts, ends;
+	unsigned int seed = 12345;
+	for (int tries = 0; starts.size() < numRays && tries < numRays*200; tries++)
+	{
+		int p[4];
+		for (int k = 0; k < 4; k++)
+		{
+			seed = seed*1103515245 + 12345;
+			p[k] = (seed>>8) % 10000;
+		}
+		const int x1 = tmin.x + p[0] % (tmax.x - tmin.x + 1);
+		const int y1 = tmin.y + p[1] % (tmax.y - tmin.y + 1);
+		int x2 = tmin.x + p[2] % (tmax.x - tmin.x + 1);
+		int y2 = tmin.y + p[3] % (tmax.y - tmin.y + 1);
+		if (starts.size() % 2)
+		{
+			x2 = std::min(std::max(x1 + p[2] % 61 - 30, tmin.x), tmax.x);
+			y2 = std::min(std::max(y1 + p[3] % 61 - 30, tmin.y), tmax.y);
+		}
+		if (isObstructed(TileVector(x1, y1)) || isObstructed(TileVector(x2, y2)))
+			continue;
+		starts.push_back(TileVector(x1, y1).worldVector());
+		ends.push_back(TileVector(x2, y2).worldVector());
+	}
+	const int num = starts.size();
+
+	std::vector<bool> reference(num), result(num);
+	for (int mode = 0; mode < 4; mode++)
+	{
+		const uint32 startTime = core->getTicks();
+		if (mode == 2)
+		{
+			for (int i = 0; i < num; i++)
+				result[i] = traceLine(starts[i], ends[i]);
+		}
+		else if (mode == 3)
+		{
+			for (int i = 0; i < num; i++)
+				result[i] = traceWide(starts[i], ends[i], 6);
+		}
+		else
+		{
+			for (int i = 0; i < num; i++)
+				result[i] = traceSampled(starts[i], ends[i], mode == 1);
+		}
+		const uint32 ms = core->getTicks() - startTime;
+
+		if (mode == 0)
+			reference = result;
+		int agree = 0, numClear = 0;
+		for (int i = 0; i < num; i++)
+		{
+			if (result[i] == reference[i])
+				agree++;
+			if (result[i])
+				numClear++;
+		}
+
+		static const char *names[] = { "trace (original)", "trace", "traceLine", "traceWide(6)" };
+		std::ostringstream os;
+		os << "Trace benchmark [" << sceneName << "] " << names[mode] << ": " << num << " rays in " << ms
+		   << "ms - clear: " << numClear << " agree with original: " << agree;
+		debugLog(os.str());
+		dsq->screenMessage(os.str());
+	}
+}
+
+// Time the shot lookup of handleShotCollisions() with Shot::grid against
+// a scan of every shot, and check both find the same hits.  Uses its own
+// shots and circular targets, so nothing in the scene is hit; the live
+// shots and grid are set aside meanwhile.
+void Game::benchmarkShotCollisions(int numShots, int numTargets)
+{
+	Shot::Shots liveShots;
+	liveShots.swap(Shot::shots);
+	const ShotGrid liveGrid = Shot::grid;
+	Shot::grid.clear();
+
+	// Fixed seed and area, so runs can be compared.
+	const float area = 3000;
+	const Vector origin(1000, 1000);
+	unsigned int seed = 12345;
+	for (int i = 0; i < numShots; i++)
+	{
+		Shot *shot = new Shot();
+		seed = seed*1103515245 + 12345;
+		shot->position.x = origin.x + (seed>>8) % int(area);
+		seed = seed*1103515245 + 12345;
+		shot->position.y = origin.y + (seed>>8) % int(area);
+		seed = seed*1103515245 + 12345;
+		shot->collideRadius = 8 + (seed>>8) % 33;
+	}
+	std::vector<Vector> targets(numTargets);
+	std::vector<float> radii(numTargets);
+	for (int i = 0; i < numTargets; i++)
+	{
+		seed = seed*1103515245 + 12345;
+		targets[i].x = origin.x + (seed>>8) % int(area);
+		seed = seed*1103515245 + 12345;
+		targets[i].y = origin.y + (seed>>8) % int(area);
+		seed = seed*1103515245 + 12345;
+		radii[i] = 16 + (seed>>8) % 81;
+	}
+	Shot::grid.rebuild();
+
+	const int passes = 20;
+	std::vector<Shot*> near;
+	std::vector<Shot*> hits[2];
+	for (int mode = 0; mode < 2; mode++)
+	{
+		const uint32 startTime = core->getTicks();
+		for (int pass = 0; pass < passes; pass++)
+		{
+			hits[mode].clear();
+			for (int i = 0; i < numTargets; i++)
+			{
+				if (mode == 0)
+				{
+					for (Shot::Shots::iterator j = Shot::shots.begin(); j != Shot::shots.end(); j++)
+					{
+						if (((*j)->position - targets[i]).isLength2DIn((*j)->collideRadius + radii[i]))
+							hits[mode].push_back(*j);
+					}
+				}
+				else
+				{
+					Shot::grid.getShotsNear(targets[i], radii[i], near);
+					for (int j = 0; j < near.size(); j++)
+					{
+						if ((near[j]->position - targets[i]).isLength2DIn(near[j]->collideRadius + radii[i]))
+							hits[mode].push_back(near[j]);
+					}
+				}
+				// Keeps targets apart in the comparison.
+				hits[mode].push_back(0);
+			}
+		}
+		const uint32 ms = core->getTicks() - startTime;
+
+		std::ostringstream os;
+		os << "Shot benchmark " << (mode ? "grid" : "all shots") << ": " << numShots << " shots, " << numTargets
+		   << " targets x " << passes << " in " << ms << "ms - hits: " << (hits[mode].size() - numTargets);
+		if (mode == 1)
+			os << (hits[0] == hits[1] ? " (same as all shots)" : " (DIFFERENT from all shots)");
+		debugLog(os.str());
+		dsq->screenMessage(os.str());
+	}
+
+	Shot::grid.clear();
+	for (Shot::Shots::iterator i = Shot::shots.begin(); i != Shot::shots.end(); i++)
+	{
+		(*i)->destroy();
+		delete *i;
+	}
+	Shot::shots.swap(liveShots);
+	Shot::grid = liveGrid;
+}
+
 const float bgLoopFadeTime = 1;
 void Game::updateBgSfxLoop()
 {
@@ -10356,6 +10821,10 @@ void Game::onHelpUp()
 
 void Game::update(float dt)
 {
+	dsq->entityGrid.refresh();
+	Shot::grid.rebuild();
+	dsq->pathFinding.update();
+
 	particleManager->clearInfluences();
 
 	if (inHelpScreen)
@@ -11047,13 +11516,11 @@ void Game::loadElementTemplates(std::string pack)
 
 void Game::clearGrid(int v)
 {
-	for (int x = 0; x < MAX_GRID; x++)
-	{
-		for (int y = 0; y < MAX_GRID; y++)
-		{
-			grid[x][y] = v;
-		}
-	}
+	grid.clear(v);
+	// Treat every tile as next to a wall until reconstructGrid() works
+	// out the real distances.
+	wallDist.clear(0);
+	gridOverlays.clear();
 }
 
 void Game::resetFromTitle()
@@ -11348,6 +11815,12 @@ bool Game::collideCircleWithGrid(Vector position, int r, Vector *fill)
 	xrange = (r/TILE_SIZE)+1;
 	yrange = (r/TILE_SIZE)+1;
 
+	if (getWallDistance(t) > xrange)
+	{
+		lastCollideTileType = OT_EMPTY;
+		return false;
+	}
+
 	for (int x = tile.x-xrange; x <= tile.x+xrange; x++)
 	{
 		for (int y = tile.y-yrange; y <= tile.y+yrange; y++)
@@ -28,6 +28,7 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 #include "AquariaMenuItem.h"
 #include "ScriptedEntity.h"
 #include "TileVector.h"
+#include "ObsGrid.h"
 #include "Shot.h"
 #include "AquariaProgressBar.h"
 
@@ -109,6 +110,7 @@ class WaterSurfaceRender;
 class ToolTip;
 
 #include "Path.h"
+#include "ScenePrefetcher.h"
 
 #ifdef AQUARIA_BUILD_SCENEEDITOR
 struct EntityGroupEntity
@@ -182,6 +184,8 @@ protected:
 	void onUpdate(float dt);
 };
 
+std::string getSceneFilename(const std::string &scene);
+
 class WarpArea
 {
 public:
@@ -607,6 +611,12 @@ enum ObsType
 	OT_HURT			= 4
 };
 
+// Cap on the distances stored in Game::wallDist.  Must stay above the
+// largest area the wall queries sample (20 tiles, from molestPath()), or
+// their early-outs never fire; 127 also keeps ObsGrid::getColumn()'s
+// signed chars valid.
+const int WALLDIST_MAX = 127;
+
 struct EntitySaveData
 {
 public:
@@ -639,7 +649,7 @@ public:
 	std::string getSelectedChoice() { return selectedChoice; }
 
 	int getGrid(const TileVector &tile);
-	const signed char *getGridColumn(int tileX);
+	void getGridColumn(int tileX, int y1, int y2, signed char *out);
 	void setGrid(const TileVector &tile, int v);
 	bool isObstructed(const TileVector &tile, int t = -1);
 
@@ -651,6 +661,7 @@ public:
 	void transitionToScene(std::string scene);
 	void transitionToSceneUnder(std::string scene);
 	bool loadScene(std::string scene);
+	void prefetchAdjacentScenes();
 
 	void clearGrid(int v = 0);
 
@@ -736,6 +747,7 @@ public:
 
 	float getPercObsInArea(Vector position, int range, int obs=-1);
 	Vector getWallNormal(Vector pos, int sampleArea = 5, float *dist=0, int obs = -1);
+	int getWallDistance(const TileVector &tile);
 
 	// HACK:: clean up these vars
 	std::string warpAreaType, warpAreaSide;
@@ -811,6 +823,7 @@ public:
 	int currentFoodPage, currentTreasurePage;
 
 	Precacher tileCache;
+	ScenePrefetcher scenePrefetcher;
 
 	//void cameraPanToNode(Path *p, int speed=500);
 	//void cameraRestore();
@@ -854,6 +867,10 @@ public:
 	void playSongInMenu(int songType, bool override=false);
 
 	bool trace(Vector start, Vector target);
+	bool traceLine(const Vector &start, const Vector &end);
+	bool traceWide(const Vector &start, const Vector &end, int radius);
+	void benchmarkTrace(int numRays);
+	void benchmarkShotCollisions(int numShots, int numTargets);
 
 	Quad *menuSongs;
 	std::vector<SongSlot*> songSlots;
@@ -1188,8 +1205,23 @@ protected:
 
 
 
-	signed char grid[MAX_GRID][MAX_GRID];
-	signed char baseGrid[MAX_GRID][MAX_GRID];
+	// Obstruction types, indexed [x][y].  baseGrid holds the map alone;
+	// grid adds what the entities fill in, whose extents are kept in
+	// gridOverlays so reconstructEntityGrid() only has to restore those.
+	ObsGrid grid;
+	ObsGrid baseGrid;
+
+	// Chessboard distance in tiles from each tile to the nearest
+	// obstruction in baseGrid (0 on an obstruction), capped at
+	// WALLDIST_MAX.  Entity obstructions are covered by gridOverlays
+	// instead, so moving an entity doesn't mean recomputing the field.
+	ObsGrid wallDist;
+	std::vector<GridRect> gridOverlays;
+	bool trackGridWrites;
+	GridRect trackedGridWrites;
+	void computeWallDistance();
+	void fillEntityGrid();
+	bool traceSampled(const Vector &start, const Vector &target, bool cull);
 
 
 	Quad *bg, *bg2;
@@ -1218,25 +1250,41 @@ inline
 int Game::getGrid(const TileVector &tile)
 {
 	if (tile.x < 0 || tile.x >= MAX_GRID || tile.y < 0 || tile.y >= MAX_GRID) return 1;
-	return grid[tile.x][tile.y];
+	return grid.get(tile.x, tile.y);
 }
 
 inline
-const signed char *Game::getGridColumn(int tileX)
+void Game::getGridColumn(int tileX, int y1, int y2, signed char *out)
 {
 	if (tileX < 0)
-		return grid[0];
+		grid.getColumn(0, y1, y2, out);
 	else if (tileX >= MAX_GRID)
-		return grid[MAX_GRID-1];
+		grid.getColumn(MAX_GRID-1, y1, y2, out);
 	else
-		return grid[tileX];
+		grid.getColumn(tileX, y1, y2, out);
 }
 
 inline
 void Game::setGrid(const TileVector &tile, int v)
 {
 	if (tile.x < 0 || tile.x >= MAX_GRID || tile.y < 0 || tile.y >= MAX_GRID) return;
-	grid[tile.x][tile.y] = v;
+	grid.set(tile.x, tile.y, v);
+	if (trackGridWrites)
+	{
+		GridRect &r = trackedGridWrites;
+		if (r.x1 > r.x2)
+		{
+			r.x1 = r.x2 = tile.x;
+			r.y1 = r.y2 = tile.y;
+		}
+		else
+		{
+			r.x1 = std::min(r.x1, tile.x);
+			r.x2 = std::max(r.x2, tile.x);
+			r.y1 = std::min(r.y1, tile.y);
+			r.y2 = std::max(r.y2, tile.y);
+		}
+	}
 }
 
 inline
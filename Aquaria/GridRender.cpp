@@ -77,17 +77,30 @@ void GridRender::onRender()
 		startY = 0;
 	if (endY >= MAX_GRID)
 		endY = MAX_GRID-1;
+	if (startY > endY)
+		return;
+
+	// Each column is decoded once, over the visible rows only, and the
+	// buffers are rotated as we move right.
+	const int numRows = endY - startY + 1;
+	for (int i = 0; i < 3; i++)
+		columns[i].resize(numRows);
+	dsq->game->getGridColumn(startX-1, startY, endY, &columns[0][0]);
+	dsq->game->getGridColumn(startX, startY, endY, &columns[1][0]);
 	for (int x = startX; x <= endX; x++)
 	{
-		const signed char *gridColumn = dsq->game->getGridColumn(x);
+		dsq->game->getGridColumn(x+1, startY, endY, &columns[2][0]);
+		const signed char *leftColumn = &columns[0][0];
+		const signed char *gridColumn = &columns[1][0];
+		const signed char *rightColumn = &columns[2][0];
 		int startCol = -1, endCol;
 		for (int y = startY; y <= endY; y++)
 		{
-			int v = gridColumn[y];
+			int v = gridColumn[y-startY];
 			// HACK: Don't draw the leftmost or rightmost column of
 			// black tiles (otherwise they "leak out" around the
 			// edges of the Sun Temple).  --achurch
-			if (v == OT_BLACK && ((dsq->game->getGridColumn(x-1))[y] != OT_BLACK || (dsq->game->getGridColumn(x+1))[y] != OT_BLACK))
+			if (v == OT_BLACK && (leftColumn[y-startY] != OT_BLACK || rightColumn[y-startY] != OT_BLACK))
 				v = OT_EMPTY;
 
 			if (v == obsType && startCol == -1)
@@ -124,6 +137,8 @@ void GridRender::onRender()
 				startCol = -1;
 			}
 		}
+		columns[0].swap(columns[1]);
+		columns[1].swap(columns[2]);
 	}
 }
 
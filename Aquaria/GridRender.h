@@ -34,6 +34,10 @@ protected:
 	ObsType obsType;
 	void onUpdate(float dt);
 	void onRender();
+
+	// Visible rows of the columns to the left of, at and to the right of
+	// the one being drawn.
+	std::vector<signed char> columns[3];
 };
 
 class MiniMapRender : public RenderObject
@@ -120,6 +120,8 @@ void Mod::load(const std::string &p)
 #else
 	dsq->secondaryTexturePath = "./" + path + "graphics/";
 #endif
+	// Cached textures may have been loaded from the wrong place.
+	dsq->flushUnusedTextures();
 
 	dsq->sound->audioPath2 = path + "audio/";
 	dsq->sound->setVoicePath2(path + "audio/");
@@ -221,12 +223,16 @@ void Mod::setActive(bool a)
 
 	active = a;
 
+	// Mods can shadow text files, so drop anything read so far.
+	dsq->textCache.clear();
+
 	if (wasActive != active)
 	{
 		if (!active)
 		{
 			name = path = "";
 			dsq->secondaryTexturePath = "";
+			dsq->flushUnusedTextures();
 			dsq->sound->audioPath2 = "";
 			dsq->sound->setVoicePath2("");
 			SkeletalSprite::secondaryAnimationPath = "";
@@ -23,6 +23,17 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 #include "DSQ.h"
 
 
+std::string ModEntry::getIconTexture() const
+{
+	std::string texToLoad = path + "/" + "mod-icon";
+#if defined(BBGE_BUILD_UNIX)
+	texToLoad = dsq->getUserDataFolder() + "/_mods/" + texToLoad;
+#else
+	texToLoad = "./_mods/" + texToLoad;
+#endif
+	return texToLoad;
+}
+
 ModSelector::ModSelector() : AquariaGuiQuad(), label(0)
 {
 	label = new BitmapText(&dsq->smallFont);
@@ -55,43 +66,24 @@ void ModSelector::refreshTexture()
 	ModEntry *e = dsq->getSelectedModEntry();
 	if (e)
 	{
-		std::string texToLoad = e->path + "/" + "mod-icon";
-	#if defined(BBGE_BUILD_UNIX)
-		texToLoad = dsq->getUserDataFolder() + "/_mods/" + texToLoad;
-	#else
-		texToLoad = "./_mods/" + texToLoad;
-	#endif
-		setTexture(texToLoad);
+		setTexture(e->getIconTexture());
 		width = 256;
 		height = 256;
+		dsq->prefetchModIcons();
 	}
 	else
 	{
 		return;
 	}
 	
-	TiXmlDocument d;
-	
-	dsq->mod.loadModXML(&d, e->path);
-	
 	if (label)
 	{
-		label->setText("No Description");
-		TiXmlElement *top = d.FirstChildElement("AquariaMod");
-		if (top)
-		{
-			TiXmlElement *desc = top->FirstChildElement("Description");
-			if (desc)
-			{
-				if (desc->Attribute("text"))
-				{
-					std::string txt = desc->Attribute("text");
-					if (txt.size() > 255)
-						txt.resize(255);
-					label->setText(txt);
-				}
-			}
-		}
+		if (!e->described)
+			dsq->readModDescription(*e);
+		if (e->description.empty())
+			label->setText("No Description");
+		else
+			label->setText(e->description);
 	}
 	if (doit)
 	{
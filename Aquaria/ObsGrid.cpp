@@ -0,0 +1,213 @@
+/*
+Copyright (C) 2007, 2010 - Bit-Blot
+
+This file is part of Aquaria.
+
+Aquaria is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+
+See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+*/
+#include "ObsGrid.h"
+
+ObsGrid::ObsGrid(int size, int bits) : size(size), bits(bits)
+{
+	blocksPerSide = (size + BLOCK_MASK) >> BLOCK_SHIFT;
+	blocks.resize(blocksPerSide * blocksPerSide, 0);
+	uniform.resize(blocksPerSide * blocksPerSide, 0);
+	for (int i = 0; i < COLUMN_CACHE; i++)
+	{
+		columnX[i] = -1;
+		columnStamp[i] = 0;
+	}
+	nextColumn = 0;
+	stamp = 1;
+}
+
+ObsGrid::~ObsGrid()
+{
+	for (int b = 0; b < blocks.size(); b++)
+		freeBlock(b);
+}
+
+// Give block b its own storage, filled with its uniform value.
+unsigned int *ObsGrid::allocBlock(int b)
+{
+	unsigned int *data = new unsigned int[BLOCK_WORDS * bits];
+	for (int w = 0; w < BLOCK_WORDS; w++)
+	{
+		for (int p = 0; p < bits; p++)
+			data[w*bits + p] = (uniform[b] >> p) & 1 ? ~0u : 0u;
+	}
+	blocks[b] = data;
+	return data;
+}
+
+void ObsGrid::freeBlock(int b)
+{
+	delete[] blocks[b];
+	blocks[b] = 0;
+}
+
+void ObsGrid::set(int x, int y, int v)
+{
+	const int b = (x >> BLOCK_SHIFT) * blocksPerSide + (y >> BLOCK_SHIFT);
+	unsigned int *data = blocks[b];
+	if (!data)
+	{
+		if (v == uniform[b])
+			return;
+		data = allocBlock(b);
+	}
+	const int i = ((x & BLOCK_MASK) << BLOCK_SHIFT) | (y & BLOCK_MASK);
+	unsigned int *w = data + (i >> 5) * bits;
+	const unsigned int mask = 1u << (i & 31);
+	for (int p = 0; p < bits; p++)
+	{
+		if ((v >> p) & 1)
+			w[p] |= mask;
+		else
+			w[p] &= ~mask;
+	}
+	stamp++;
+}
+
+void ObsGrid::clear(int v)
+{
+	for (int b = 0; b < blocks.size(); b++)
+	{
+		freeBlock(b);
+		uniform[b] = v;
+	}
+	stamp++;
+}
+
+void ObsGrid::copy(const ObsGrid &from)
+{
+	for (int b = 0; b < blocks.size(); b++)
+	{
+		uniform[b] = from.uniform[b];
+		if (!from.blocks[b])
+		{
+			freeBlock(b);
+			continue;
+		}
+		if (!blocks[b])
+			blocks[b] = new unsigned int[BLOCK_WORDS * bits];
+		memcpy(blocks[b], from.blocks[b], BLOCK_WORDS * bits * sizeof(unsigned int));
+	}
+	stamp++;
+}
+
+void ObsGrid::copyRect(const ObsGrid &from, const GridRect &r)
+{
+	const int x1 = std::max(r.x1, 0), x2 = std::min(r.x2, size-1);
+	const int y1 = std::max(r.y1, 0), y2 = std::min(r.y2, size-1);
+	for (int x = x1; x <= x2; x++)
+	{
+		for (int y = y1; y <= y2; y++)
+			set(x, y, from.get(x, y));
+	}
+	stamp++;
+}
+
+// Release every block whose cells all hold the same value.
+void ObsGrid::compact()
+{
+	for (int b = 0; b < blocks.size(); b++)
+	{
+		const unsigned int *data = blocks[b];
+		if (!data)
+			continue;
+		bool same = true;
+		for (int p = 0; p < bits && same; p++)
+		{
+			const unsigned int first = data[p];
+			if (first != 0 && first != ~0u)
+				same = false;
+			for (int w = 1; w < BLOCK_WORDS && same; w++)
+			{
+				if (data[w*bits + p] != first)
+					same = false;
+			}
+		}
+		if (same)
+		{
+			int v = 0;
+			for (int p = 0; p < bits; p++)
+				v |= (data[p] & 1) << p;
+			freeBlock(b);
+			uniform[b] = v;
+		}
+	}
+}
+
+const signed char *ObsGrid::getColumn(int x) const
+{
+	int slot;
+	for (slot = 0; slot < COLUMN_CACHE; slot++)
+	{
+		if (columnX[slot] == x && columnStamp[slot] == stamp)
+			return &columns[slot][0];
+	}
+
+	slot = nextColumn;
+	nextColumn = (nextColumn + 1) % COLUMN_CACHE;
+	std::vector<signed char> &column = columns[slot];
+	column.resize(size);
+	for (int y = 0; y < size; y++)
+		column[y] = get(x, y);
+	columnX[slot] = x;
+	columnStamp[slot] = stamp;
+	return &column[0];
+}
+
+void ObsGrid::getColumn(int x, int y1, int y2, signed char *out) const
+{
+	const int bx = (x >> BLOCK_SHIFT) * blocksPerSide;
+	int y = y1;
+	while (y <= y2)
+	{
+		const int b = bx + (y >> BLOCK_SHIFT);
+		const int end = std::min((y | BLOCK_MASK), y2);
+		const unsigned int *data = blocks[b];
+		if (!data)
+		{
+			memset(out, uniform[b], end - y + 1);
+			out += end - y + 1;
+			y = end + 1;
+			continue;
+		}
+		for (; y <= end; y++)
+		{
+			const int i = ((x & BLOCK_MASK) << BLOCK_SHIFT) | (y & BLOCK_MASK);
+			const unsigned int *w = data + (i >> 5) * bits;
+			const int shift = i & 31;
+			int v = 0;
+			for (int p = 0; p < bits; p++)
+				v |= ((w[p] >> shift) & 1) << p;
+			*out++ = v;
+		}
+	}
+}
+
+int ObsGrid::getNumAllocatedBlocks() const
+{
+	int n = 0;
+	for (int b = 0; b < blocks.size(); b++)
+	{
+		if (blocks[b])
+			n++;
+	}
+	return n;
+}
@@ -0,0 +1,100 @@
+/*
+Copyright (C) 2007, 2010 - Bit-Blot
+
+This file is part of Aquaria.
+
+Aquaria is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+
+See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+*/
+#pragma once
+
+#include "../BBGE/Base.h"
+
+// Inclusive range of grid tiles.
+struct GridRect
+{
+	int x1, y1, x2, y2;
+};
+
+// A square grid of small values (up to 'bits' bits each), stored as
+// 64x64 blocks.  Each block keeps its values as bit planes, with the
+// planes for each run of 32 cells next to each other.  A block whose
+// cells all hold the same value isn't allocated at all; clear() and
+// compact() leave most of a map's open water and solid rock that way.
+//
+// Coordinates are not range checked.
+class ObsGrid
+{
+public:
+	ObsGrid(int size, int bits);
+	~ObsGrid();
+
+	int get(int x, int y) const
+	{
+		const int b = (x >> BLOCK_SHIFT) * blocksPerSide + (y >> BLOCK_SHIFT);
+		const unsigned int *data = blocks[b];
+		if (!data)
+			return uniform[b];
+		const int i = ((x & BLOCK_MASK) << BLOCK_SHIFT) | (y & BLOCK_MASK);
+		const unsigned int *w = data + (i >> 5) * bits;
+		const int shift = i & 31;
+		int v = 0;
+		for (int p = 0; p < bits; p++)
+			v |= ((w[p] >> shift) & 1) << p;
+		return v;
+	}
+
+	void set(int x, int y, int v);
+	void clear(int v = 0);
+	void copy(const ObsGrid &from);
+	void copyRect(const ObsGrid &from, const GridRect &r);
+	void compact();
+
+	// The values in column x, decoded.  The pointer stays valid until a
+	// few more columns have been asked for, or the grid changes.
+	const signed char *getColumn(int x) const;
+	// Decode rows y1 to y2 (inclusive) of column x into out.
+	void getColumn(int x, int y1, int y2, signed char *out) const;
+
+	int getSize() const { return size; }
+	int getNumBlocks() const { return blocksPerSide * blocksPerSide; }
+	int getNumAllocatedBlocks() const;
+
+private:
+	enum
+	{
+		BLOCK_SHIFT = 6,
+		BLOCK_SIZE = 1 << BLOCK_SHIFT,
+		BLOCK_MASK = BLOCK_SIZE - 1,
+		BLOCK_WORDS = BLOCK_SIZE * BLOCK_SIZE / 32,
+		COLUMN_CACHE = 4
+	};
+
+	ObsGrid(const ObsGrid &);
+	ObsGrid &operator=(const ObsGrid &);
+
+	unsigned int *allocBlock(int b);
+	void freeBlock(int b);
+
+	int size, bits, blocksPerSide;
+	std::vector<unsigned int*> blocks;
+	std::vector<unsigned char> uniform;	// value of each unallocated block
+
+	mutable std::vector<signed char> columns[COLUMN_CACHE];
+	mutable int columnX[COLUMN_CACHE];
+	mutable unsigned int columnStamp[COLUMN_CACHE];
+	mutable int nextColumn;
+	unsigned int stamp;	// bumped on every change
+};
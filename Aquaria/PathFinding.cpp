@@ -22,322 +22,768 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 #include "DSQ.h"
 #include "Game.h"
 
+#include <queue>
+
 
 const int divs = 6;
-const int MAX_ZONES=1000;
 const int MAX_STEPS = 5000;
+// Zones are this many lattice cells square.
+const int ZONE_SIZE = 8;
+// Long paths are walked in legs of this many zones.
+const int ZONES_PER_LEG = 2;
+// Nodes update() may expand per frame, across all queued requests.
+const int REQUEST_STEPS_PER_FRAME = 1500;
 const int cutOff = int((divs*divs)*0.75f);
 
-namespace PathFindingGlobals
+PathFinding::PathFinding()
 {
-	// This isn't used by the current code, so I've commented it out to
-	// save 4MB of RAM.  --achurch
-	//int zones[MAX_ZONES][MAX_ZONES];
+	jumpPoints = false;
+	originX = originY = 0;
+	latticeW = latticeH = 0;
+	goalX = goalY = 0;
+	expanded = 0;
+	searchHateDiagonals = false;
+	nextRequest = 1;
+	activeRequest = 0;
+	zonesW = zonesH = 0;
+	zoneLatticeW = zoneLatticeH = 0;
+	zonesDirty = false;
+}
 
-	MapSearchNode node_goal;
-	MapSearchNode node_start;
-	RenderObject *render_object;
-	bool hate_diagonals;
+int PathFinding::getCell(int lx, int ly)
+{
+	if (lx < 0 || lx >= latticeW || ly < 0 || ly >= latticeH)
+		return -1;
+	return ly*latticeW + lx;
 }
 
-float MapSearchNode::GoalDistanceEstimate( MapSearchNode &nodeGoal )
-{	
-	float xd = float( ( (float)x - (float)nodeGoal.x ) );
-	float yd = float( ( (float)y - (float)nodeGoal.y) );
+// Anything off the map is obstructed, so a lattice point that isn't
+// blocked always has a cell.
+bool PathFinding::isBlocked(int lx, int ly)
+{
+	return dsq->game->getGrid(TileVector(originX + lx*divs, originY + ly*divs)) > 0;
+}
 
-	return ((xd*xd) + (yd*yd));
-	//return 0;
-	/*
-	int r = 10;
-	float c = 0;
-	for (int x = -r; x < r; x+=2)
-	{
-		for (int y = -r; y < r; y+=2)
-		{
-			if (dsq->game->getGrid(TileVector(this->x+x, this->y+y)))
-			{
-				//c+= r*TILE_SIZE
-				c++;			
-			}
-		}
-	}	
-	return ((xd*xd) + (yd*yd)) + c * (2*TILE_SIZE);
-	*/
+bool PathFinding::isGoal(int lx, int ly)
+{
+	const int x = originX + lx*divs;
+	const int y = originY + ly*divs;
+	if (sqr(x - goalX) + sqr(y - goalY) <= sqr(divs+1))
+		return true;
+	return x/divs == goalX/divs && y/divs == goalY/divs;
+}
 
+float PathFinding::goalDistanceEstimate(int lx, int ly)
+{
+	const float xd = float(originX + lx*divs - goalX);
+	const float yd = float(originY + ly*divs - goalY);
+	return (xd*xd) + (yd*yd);
+}
 
-	
-	/*
-	float xd = float( ( (float)x - (float)nodeGoal.x ) );
-	float yd = float( ( (float)y - (float)nodeGoal.y) );
-	int dist = ((xd*xd) + (yd*yd));
-	return (int(dist/80)*80);
-	*/
-	
-	//return ((xd*xd) + (yd*yd));
-		
-	
+void PathFinding::setClosed(int cell, bool on)
+{
+	if (on)
+		closed[cell>>5] |= 1u << (cell&31);
+	else
+		closed[cell>>5] &= ~(1u << (cell&31));
+}
 
-	
+void PathFinding::heapUp(int pos)
+{
+	const int n = heap[pos];
+	const float f = nodes[n].f;
+	while (pos > 0)
+	{
+		const int up = (pos-1)/2;
+		if (nodes[heap[up]].f <= f)
+			break;
+		heap[pos] = heap[up];
+		nodes[heap[pos]].heapIndex = pos;
+		pos = up;
+	}
+	heap[pos] = n;
+	nodes[n].heapIndex = pos;
+}
+
+void PathFinding::heapDown(int pos)
+{
+	const int sz = heap.size();
+	const int n = heap[pos];
+	const float f = nodes[n].f;
+	for (;;)
+	{
+		int child = pos*2+1;
+		if (child >= sz)
+			break;
+		if (child+1 < sz && nodes[heap[child+1]].f < nodes[heap[child]].f)
+			child++;
+		if (f <= nodes[heap[child]].f)
+			break;
+		heap[pos] = heap[child];
+		nodes[heap[pos]].heapIndex = pos;
+		pos = child;
+	}
+	heap[pos] = n;
+	nodes[n].heapIndex = pos;
+}
 
-	// + c; //+ c * (2*TILE_SIZE);
+void PathFinding::heapPush(int n)
+{
+	heap.push_back(n);
+	heapUp(heap.size()-1);
 }
 
-bool MapSearchNode::IsGoal( MapSearchNode &nodeGoal )
+int PathFinding::heapPop()
 {
-	Vector v(x, y);
-	Vector g(nodeGoal.x, nodeGoal.y);
-	if (divs > 1)
+	const int n = heap[0];
+	const int last = heap.back();
+	heap.pop_back();
+	if (!heap.empty())
 	{
-		if ((v - g).getSquaredLength2D() <= sqr(divs+1))
-		{	
-			// HACK: remember this
-			//debugLog ("really close to the goal!");
-			return true;
-		}
+		heap[0] = last;
+		heapDown(0);
 	}
-	if( int(x/divs) == int(nodeGoal.x/divs) && int(y/divs) == int(nodeGoal.y/divs))
+	nodes[n].heapIndex = -1;
+	return n;
+}
+
+// Reach (lx,ly) from node parent.  Each lattice step costs 1, diagonal
+// or not, so a jump costs the number of steps it covers.
+void PathFinding::addSuccessor(int parent, int lx, int ly)
+{
+	const float newg = nodes[parent].g + std::max(abs(lx - nodes[parent].lx), abs(ly - nodes[parent].ly));
+	const int cell = getCell(lx, ly);
+	const int n = cellNode[cell];
+	if (n >= 0 && n < nodes.size() && nodes[n].lx == lx && nodes[n].ly == ly)
 	{
-		return true;
+		Node &node = nodes[n];
+		if (node.g <= newg)
+			return;
+		node.parent = parent;
+		node.g = newg;
+		node.f = newg + goalDistanceEstimate(lx, ly);
+		if (isClosed(cell))
+		{
+			setClosed(cell, false);
+			heapPush(n);
+		}
+		else
+		{
+			heapUp(node.heapIndex);
+		}
+		return;
 	}
 
-	return false;
+	Node node;
+	node.lx = lx;
+	node.ly = ly;
+	node.parent = parent;
+	node.heapIndex = -1;
+	node.g = newg;
+	node.f = newg + goalDistanceEstimate(lx, ly);
+	cellNode[cell] = nodes.size();
+	nodes.push_back(node);
+	heapPush(nodes.size()-1);
 }
 
-// This generates the successors to the given Node. It uses a helper function called
-// AddSuccessor to give the successors to the AStar class. The A* specific initialisation
-// is done for each node internally, so here you just set the state information that
-// is specific to the application
-bool MapSearchNode::GetSuccessors( AStarSearch *astarsearch, MapSearchNode *parent_node )
+void PathFinding::addNeighbours(int n, bool hate_diagonals)
 {
+	const int x = nodes[n].lx;
+	const int y = nodes[n].ly;
+
+	if (!isBlocked(x-1, y))
+		addSuccessor(n, x-1, y);
+	if (!isBlocked(x, y-1))
+		addSuccessor(n, x, y-1);
+	if (!isBlocked(x+1, y))
+		addSuccessor(n, x+1, y);
+	if (!isBlocked(x, y+1))
+		addSuccessor(n, x, y+1);
+
+	if (!hate_diagonals)
+	{
+		if (!isBlocked(x-1, y-1))
+			addSuccessor(n, x-1, y-1);
+		if (!isBlocked(x-1, y+1))
+			addSuccessor(n, x-1, y+1);
+		if (!isBlocked(x+1, y+1))
+			addSuccessor(n, x+1, y+1);
+		if (!isBlocked(x+1, y-1))
+			addSuccessor(n, x+1, y-1);
+	}
+}
 
-	int parent_x = -1; 
-	int parent_y = -1; 
-
-	if( parent_node )
+// Walk from (lx,ly) along a row or column and stop at the first point
+// worth expanding: the goal, or a point with a forced neighbour.
+bool PathFinding::jumpStraight(int lx, int ly, int dx, int dy, int &jx, int &jy)
+{
+	for (;;)
 	{
-		parent_x = parent_node->x;
-		parent_y = parent_node->y;
+		lx += dx;
+		ly += dy;
+		if (isBlocked(lx, ly))
+			return false;
+		if (isGoal(lx, ly)
+			|| (dy == 0 && ((isBlocked(lx, ly+1) && !isBlocked(lx+dx, ly+1))
+							|| (isBlocked(lx, ly-1) && !isBlocked(lx+dx, ly-1))))
+			|| (dx == 0 && ((isBlocked(lx+1, ly) && !isBlocked(lx+1, ly+dy))
+							|| (isBlocked(lx-1, ly) && !isBlocked(lx-1, ly+dy)))))
+		{
+			jx = lx;
+			jy = ly;
+			return true;
+		}
 	}
-	
+}
 
-	MapSearchNode NewNode;
+bool PathFinding::jump(int lx, int ly, int dx, int dy, int &jx, int &jy)
+{
+	if (dx == 0 || dy == 0)
+		return jumpStraight(lx, ly, dx, dy, jx, jy);
 
-	int i = divs;
-	// push each possible move except allowing the search to go backwards
-	if ((GetMap (x-i, y) <= 0)  && !((parent_x == x-i) && (parent_y == y)))
+	int sx, sy;
+	for (;;)
 	{
-		NewNode = MapSearchNode( x-i, y );
-		astarsearch->AddSuccessor( NewNode );
-	}	
+		lx += dx;
+		ly += dy;
+		if (isBlocked(lx, ly))
+			return false;
+		if (isGoal(lx, ly)
+			|| (isBlocked(lx-dx, ly) && !isBlocked(lx-dx, ly+dy))
+			|| (isBlocked(lx, ly-dy) && !isBlocked(lx+dx, ly-dy))
+			|| jumpStraight(lx, ly, dx, 0, sx, sy)
+			|| jumpStraight(lx, ly, 0, dy, sx, sy))
+		{
+			jx = lx;
+			jy = ly;
+			return true;
+		}
+	}
+}
 
-	if ((GetMap (x, y-i) <= 0)  && !((parent_x == x) && (parent_y == y-i)))
-	{
-		NewNode = MapSearchNode( x, y-i );
-		astarsearch->AddSuccessor( NewNode );
-	}	
+// Jump-point search: only follow the directions that can't be reached
+// at least as cheaply through the parent, and skip ahead along each one.
+void PathFinding::addJumpPoints(int n)
+{
+	const int x = nodes[n].lx;
+	const int y = nodes[n].ly;
+	int dirs[8][2];
+	int numDirs = 0;
 
-	if ((GetMap (x+i, y) <= 0) && !((parent_x == x+i) && (parent_y == y)))
+	if (nodes[n].parent < 0)
 	{
-		NewNode = MapSearchNode( x+i, y );
-		astarsearch->AddSuccessor( NewNode );
+		for (int dy = -1; dy <= 1; dy++)
+		{
+			for (int dx = -1; dx <= 1; dx++)
+			{
+				if (dx || dy)
+				{
+					dirs[numDirs][0] = dx;
+					dirs[numDirs][1] = dy;
+					numDirs++;
+				}
+			}
+		}
 	}
-	
-	if ((GetMap (x, y+i) <= 0) && !((parent_x == x) && (parent_y == y+i)))
+	else
 	{
-		NewNode = MapSearchNode( x, y+i );
-		astarsearch->AddSuccessor( NewNode );
-	}	
+		const Node &parent = nodes[nodes[n].parent];
+		const int dx = (x > parent.lx) - (x < parent.lx);
+		const int dy = (y > parent.ly) - (y < parent.ly);
+		#define ADD_DIR(ddx, ddy) { dirs[numDirs][0] = ddx; dirs[numDirs][1] = ddy; numDirs++; }
+		ADD_DIR(dx, dy);
+		if (dx && dy)
+		{
+			ADD_DIR(dx, 0);
+			ADD_DIR(0, dy);
+			if (isBlocked(x-dx, y))
+				ADD_DIR(-dx, dy);
+			if (isBlocked(x, y-dy))
+				ADD_DIR(dx, -dy);
+		}
+		else if (dx)
+		{
+			if (isBlocked(x, y+1))
+				ADD_DIR(dx, 1);
+			if (isBlocked(x, y-1))
+				ADD_DIR(dx, -1);
+		}
+		else
+		{
+			if (isBlocked(x+1, y))
+				ADD_DIR(1, dy);
+			if (isBlocked(x-1, y))
+				ADD_DIR(-1, dy);
+		}
+		#undef ADD_DIR
+	}
 
-	if (!PathFindingGlobals::hate_diagonals)
+	for (int i = 0; i < numDirs; i++)
 	{
-		if ((GetMap (x-i, y-i) < 1)  && !((parent_x == x-i) && (parent_y == y-i)))
-		{
-			NewNode = MapSearchNode( x-i, y-i );
-			astarsearch->AddSuccessor( NewNode );
-		}	
+		int jx, jy;
+		if (jump(x, y, dirs[i][0], dirs[i][1], jx, jy))
+			addSuccessor(n, jx, jy);
+	}
+}
 
-		if ((GetMap (x-i, y+i) < 1)  && !((parent_x == x-i) && (parent_y == y+i)))
-		{
-			NewNode = MapSearchNode( x-i, y+i );
-			astarsearch->AddSuccessor( NewNode );
-		}	
+void PathFinding::beginSearch(const TileVector &start, const TileVector &goal, bool hate_diagonals)
+{
+	searchStart = start;
+	searchGoal = goal;
+	searchHateDiagonals = hate_diagonals;
+	// Whatever request was loaded has to start over.
+	activeRequest = 0;
+
+	originX = ((start.x % divs) + divs) % divs;
+	originY = ((start.y % divs) + divs) % divs;
+	latticeW = (MAX_GRID - originX + divs-1) / divs;
+	latticeH = (MAX_GRID - originY + divs-1) / divs;
+	goalX = goal.x;
+	goalY = goal.y;
+
+	const int numCells = latticeW*latticeH;
+	if (cellNode.size() < numCells)
+		cellNode.resize(numCells, -1);
+	closed.assign((numCells+31)/32, 0);
+	nodes.clear();
+	heap.clear();
+	solution.clear();
+	expanded = 0;
+
+	Node node;
+	node.lx = (start.x - originX) / divs;
+	node.ly = (start.y - originY) / divs;
+	node.parent = -1;
+	node.heapIndex = -1;
+	node.g = 0;
+	node.f = goalDistanceEstimate(node.lx, node.ly);
+	nodes.push_back(node);
+	// The start may be off the map; it just won't be found again.
+	if (getCell(node.lx, node.ly) >= 0)
+		cellNode[getCell(node.lx, node.ly)] = 0;
+	heapPush(0);
+}
 
-		if ((GetMap (x+i, y+i) <1) && !((parent_x == x+i) && (parent_y == y+i)))
-		{
-			NewNode = MapSearchNode( x+i, y+i );
-			astarsearch->AddSuccessor( NewNode );
-		}	
+// Expand up to maxSteps more nodes of the search begun by beginSearch().
+PathFinding::SearchResult PathFinding::continueSearch(int maxSteps)
+{
+	const bool jps = jumpPoints && !searchHateDiagonals;
+	while (!heap.empty())
+	{
+		if (maxSteps-- <= 0)
+			return SEARCH_SEARCHING;
 
-		if ((GetMap (x+i, y-i) < 1) && !((parent_x == x+i) && (parent_y == y-i)))
+		const int n = heapPop();
+		if (isGoal(nodes[n].lx, nodes[n].ly))
 		{
-			NewNode = MapSearchNode( x+i, y-i );
-			astarsearch->AddSuccessor( NewNode );
-		}	
+			// The goal tile takes the place of the node that reached it.
+			// Jumps are filled back in so the path has a point every
+			// lattice step, as molestPath() expects.
+			if (nodes[n].parent < 0)
+			{
+				solution.push_back(searchStart);
+				return SEARCH_SUCCEEDED;
+			}
+			solution.push_back(searchGoal);
+			for (int m = n; nodes[m].parent >= 0; m = nodes[m].parent)
+			{
+				const Node &child = nodes[m];
+				const Node &parent = nodes[child.parent];
+				const int dx = (parent.lx > child.lx) - (parent.lx < child.lx);
+				const int dy = (parent.ly > child.ly) - (parent.ly < child.ly);
+				int x = child.lx + dx, y = child.ly + dy;
+				for (; x != parent.lx || y != parent.ly; x += dx, y += dy)
+					solution.push_back(TileVector(originX + x*divs, originY + y*divs));
+				solution.push_back(TileVector(originX + x*divs, originY + y*divs));
+			}
+			std::reverse(solution.begin(), solution.end());
+			return SEARCH_SUCCEEDED;
+		}
+
+		if (++expanded > MAX_STEPS)
+			return SEARCH_TOO_LONG;
+
+		const int cell = getCell(nodes[n].lx, nodes[n].ly);
+		if (cell >= 0)
+			setClosed(cell, true);
+
+		if (jps)
+			addJumpPoints(n);
+		else
+			addNeighbours(n, searchHateDiagonals);
 	}
+	return SEARCH_FAILED;
+}
 
-	return true;
+PathFinding::SearchResult PathFinding::search(const TileVector &start, const TileVector &goal, bool hate_diagonals)
+{
+	beginSearch(start, goal, hate_diagonals);
+	return continueSearch(MAX_STEPS+1);
 }
 
-// given this node, what does it cost to move to successor. In the case
-// of our map the answer is the map terrain value at this node since that is 
-// conceptually where we're moving
-float MapSearchNode::GetCost( MapSearchNode &successor )
+bool PathFinding::isZoneBlocked(int lx, int ly)
 {
-	float cost = 1;	
-	/*
-	if (PathFindingGlobals::hate_diagonals)
+	return dsq->game->getGrid(TileVector(lx*divs, ly*divs)) > 0;
+}
+
+// Find the nearest open zone lattice point among the four around the tile.
+bool PathFinding::findZonePoint(const TileVector &t, int &lx, int &ly)
+{
+	const int bx = t.x / divs, by = t.y / divs;
+	int best = -1;
+	for (int i = 0; i < 4; i++)
 	{
-		if (successor.x != x && successor.y != y)
+		const int x = bx + (i&1), y = by + (i>>1);
+		const int d = sqr(x*divs - t.x) + sqr(y*divs - t.y);
+		if ((best < 0 || d < best) && !isZoneBlocked(x, y))
 		{
-			cost = 0.1;
+			best = d;
+			lx = x;
+			ly = y;
 		}
 	}
-	*/
-	
-	//Vector p(x, y);
-	//penalize moving towards obstructions
-	/*
-	int r = 20;
-	float costy=0;
-	int c = 0;
-	float v = 0;
-	float dist = sqr(r*TILE_SIZE);
-	TileVector tme(this->x, this->y);
-	for (int x = -r; x < r; x++)
-	{
-		for (int y = -r; y < r; y++)
-		{
-			TileVector t(this->x + x, this->y + y);
-			if (dsq->game->isObstructed(t))
-			{
-				
-				Vector diff = t.worldVector() - tme.worldVector();
-				int d = diff.getSquaredLength2D();
-				if (d < dist)
-				{
-					costy += 0.1;
-				}
+	return best >= 0;
+}
 
-				//TileVector tme(this->x, this->y);
-				//Vector diff = t.worldVector() - tme.worldVector();
-				//int d = diff.getSquaredLength2D();
-				//if (d < dist)
-				//{
-				//	v += dist-diff.getSquaredLength2D();
-				//}
-				
+int PathFinding::addPortal(int lx, int ly, int zone)
+{
+	int p;
+	if (freePortals.empty())
+	{
+		p = portals.size();
+		portals.push_back(Portal());
+	}
+	else
+	{
+		p = freePortals.back();
+		freePortals.pop_back();
+	}
+	portals[p].lx = lx;
+	portals[p].ly = ly;
+	portals[p].zone = zone;
+	portals[p].link = -1;
+	portals[p].edges.clear();
+	return p;
+}
+
+// Distances in lattice steps from (lx,ly) to every cell of the zone,
+// moving as the search does but without leaving the zone.  dist is
+// indexed by the cell's offset in the zone, and is -1 where unreachable.
+void PathFinding::zoneDistances(int zone, int lx, int ly, std::vector<int> &dist)
+{
+	const int x0 = (zone % zonesW) * ZONE_SIZE, y0 = (zone / zonesW) * ZONE_SIZE;
+	const int w = std::min(ZONE_SIZE, zoneLatticeW - x0), h = std::min(ZONE_SIZE, zoneLatticeH - y0);
+	int queue[ZONE_SIZE*ZONE_SIZE];
+	int head = 0, tail = 0;
+
+	dist.assign(ZONE_SIZE*ZONE_SIZE, -1);
+	dist[(lx-x0) + (ly-y0)*ZONE_SIZE] = 0;
+	queue[tail++] = (lx-x0) + (ly-y0)*ZONE_SIZE;
+	while (head < tail)
+	{
+		const int c = queue[head++];
+		const int cx = c % ZONE_SIZE, cy = c / ZONE_SIZE;
+		for (int dy = -1; dy <= 1; dy++)
+		{
+			for (int dx = -1; dx <= 1; dx++)
+			{
+				const int x = cx + dx, y = cy + dy;
+				if (x < 0 || x >= w || y < 0 || y >= h)
+					continue;
+				const int n = x + y*ZONE_SIZE;
+				if (dist[n] >= 0 || isZoneBlocked(x0 + x, y0 + y))
+					continue;
+				dist[n] = dist[c] + 1;
+				queue[tail++] = n;
 			}
-			c++;
 		}
 	}
-	cost += costy;
-	*/
-	/*
-	if (v > 0)
+}
+
+// Replace the portals on one border.  A run of lattice points that can
+// step straight across gets a pair of portals at its middle.
+void PathFinding::buildBorder(int border)
+{
+	std::vector<int> &list = borders[border];
+	for (int i = 0; i < list.size(); i++)
 	{
-		v /= float(c);
-		v /= float(dist);
-		cost += v*TILE_SIZE*10;
+		portals[list[i]].zone = -1;
+		portals[list[i]].edges.clear();
+		freePortals.push_back(list[i]);
 	}
-	*/
+	list.clear();
 
-	
-	
-	
-	//penalize changing direction to tempt computer into moving in "straighter" paths
-	/*
-	if (successor.y != y && (dir == LEFT || dir == RIGHT))
-		cost +=39;
-	if (successor.x != x && (dir == UP || dir == DOWN))
-		cost +=39;
-	*/
-	
-	return cost;
+	const int zone = border / 2;
+	const bool south = (border & 1) != 0;
+	const int zx = zone % zonesW, zy = zone / zonesW;
+	if (south ? zy+1 >= zonesH : zx+1 >= zonesW)
+		return;
+	const int other = south ? zone + zonesW : zone + 1;
+
+	// Lattice coordinate of the last row or column in this zone, and the
+	// range running along the border.
+	const int a = (south ? zy+1 : zx+1) * ZONE_SIZE - 1;
+	const int start = (south ? zx : zy) * ZONE_SIZE;
+	const int end = std::min(start + ZONE_SIZE, south ? zoneLatticeW : zoneLatticeH);
+
+	int runStart = -1;
+	for (int i = start; i <= end; i++)
+	{
+		bool open = false;
+		if (i < end)
+		{
+			if (south)
+				open = !isZoneBlocked(i, a) && !isZoneBlocked(i, a+1);
+			else
+				open = !isZoneBlocked(a, i) && !isZoneBlocked(a+1, i);
+		}
+		if (open && runStart < 0)
+		{
+			runStart = i;
+		}
+		else if (!open && runStart >= 0)
+		{
+			const int mid = (runStart + i-1) / 2;
+			const int p = south ? addPortal(mid, a, zone) : addPortal(a, mid, zone);
+			const int q = south ? addPortal(mid, a+1, other) : addPortal(a+1, mid, other);
+			portals[p].link = q;
+			portals[q].link = p;
+			list.push_back(p);
+			list.push_back(q);
+			runStart = -1;
+		}
+	}
 }
 
-int MapSearchNode::GetMap (int tx, int ty)
+// Rebuild the borders of every dirty zone, then the edges of every zone
+// that has a rebuilt border.
+void PathFinding::updateZones()
 {
-	//return 0;
-	//return PathFindingGlobals::zones[int(tx/divs)][int(ty/divs)] > cutOff;
-	int v = dsq->game->getGrid(TileVector(tx,ty));
-	/*
-	if (v != 0 && v != 1)
+	if (!zonesDirty)
+		return;
+	zonesDirty = false;
+
+	std::vector<char> borderDirty(borders.size(), 0);
+	std::vector<char> zoneAffected(zones.size(), 0);
+	int z, i, j;
+
+	for (z = 0; z < zones.size(); z++)
 	{
-		std::ostringstream os;
-		os << "v: " << v;
-		debugLog(os.str());
+		if (!zones[z].dirty)
+			continue;
+		zones[z].dirty = false;
+		borderDirty[z*2] = borderDirty[z*2+1] = 1;
+		if (z % zonesW > 0)
+			borderDirty[(z-1)*2] = 1;
+		if (z / zonesW > 0)
+			borderDirty[(z-zonesW)*2+1] = 1;
 	}
-	*/
-	return v;
-	/*
-	if (dsq->game->getGrid(TileVector(x,y))
-		|| dsq->game->getGrid(TileVector(x+1,y))
-		|| dsq->game->getGrid(TileVector(x-1,y))
-		|| dsq->game->getGrid(TileVector(x+2,y))
-		|| dsq->game->getGrid(TileVector(x-2,y))
-		*/
-	
-	/*
-	int r = 3;
-	for (int x = -r; x < r; x++)
+	for (i = 0; i < borders.size(); i++)
 	{
-		for (int y = -r; y < r; y++)
+		if (!borderDirty[i])
+			continue;
+		buildBorder(i);
+		z = i / 2;
+		zoneAffected[z] = 1;
+		if (i & 1)
+		{
+			if (z + zonesW < zones.size())
+				zoneAffected[z + zonesW] = 1;
+		}
+		else if (z % zonesW + 1 < zonesW)
 		{
-			if (dsq->game->getGrid(TileVector(tx+x, ty+y)))
-				return 1;
+			zoneAffected[z + 1] = 1;
 		}
 	}
-	return 0;
-	*/
 
-	/*
-	// ignore the start node
-	if (x == KittyTown::instance->nodeStart->x && y == KittyTown::instance->nodeStart->y)
+	std::vector<int> dist;
+	for (z = 0; z < zones.size(); z++)
 	{
-		obs = -1;
+		if (!zoneAffected[z])
+			continue;
+		const int zx = z % zonesW, zy = z / zonesW;
+		const int x0 = zx * ZONE_SIZE, y0 = zy * ZONE_SIZE;
+
+		std::vector<int> &zonePortals = zones[z].portals;
+		zonePortals.clear();
+		int zoneBorders[4] = { z*2, z*2+1, zx > 0 ? (z-1)*2 : -1, zy > 0 ? (z-zonesW)*2+1 : -1 };
+		for (i = 0; i < 4; i++)
+		{
+			if (zoneBorders[i] < 0)
+				continue;
+			const std::vector<int> &list = borders[zoneBorders[i]];
+			for (j = 0; j < list.size(); j++)
+			{
+				if (portals[list[j]].zone == z)
+					zonePortals.push_back(list[j]);
+			}
+		}
+
+		for (i = 0; i < zonePortals.size(); i++)
+		{
+			Portal &p = portals[zonePortals[i]];
+			zoneDistances(z, p.lx, p.ly, dist);
+			p.edges.clear();
+			for (j = 0; j < zonePortals.size(); j++)
+			{
+				const Portal &q = portals[zonePortals[j]];
+				const int d = dist[(q.lx-x0) + (q.ly-y0)*ZONE_SIZE];
+				if (j != i && d >= 0)
+				{
+					ZoneEdge e;
+					e.portal = zonePortals[j];
+					e.cost = d;
+					p.edges.push_back(e);
+				}
+			}
+		}
 	}
-	return obs;
-	*/
 }
 
-// same state in a maze search is simply when (x,y) are the same
-bool MapSearchNode::IsSameState( MapSearchNode &rhs )
-{	
-	if( (int(x/divs) == int(rhs.x/divs)) && (int(y/divs) == int(rhs.y/divs)) )
-		return true;
-	else
-		return false;
+void PathFinding::generateZones()
+{
+	zoneLatticeW = zoneLatticeH = (MAX_GRID + divs-1) / divs;
+	zonesW = zonesH = (zoneLatticeW + ZONE_SIZE-1) / ZONE_SIZE;
+	zones.clear();
+	zones.resize(zonesW*zonesH);
+	for (int z = 0; z < zones.size(); z++)
+		zones[z].dirty = true;
+	borders.clear();
+	borders.resize(zones.size()*2);
+	portals.clear();
+	freePortals.clear();
+	zonesDirty = true;
+
+	updateZones();
+
+	std::ostringstream os;
+	os << "Path zones: " << (portals.size() - freePortals.size()) << " portals";
+	debugLog(os.str());
 }
 
-void PathFinding::generateZones()
+// Tiles in r have changed.  The zones they cover are rebuilt the next
+// time a path is planned.
+void PathFinding::invalidateZones(const GridRect &r)
 {
-	return;
+	if (zones.empty())
+		return;
+	const int zx1 = std::max(0, r.x1 / divs / ZONE_SIZE);
+	const int zy1 = std::max(0, r.y1 / divs / ZONE_SIZE);
+	const int zx2 = std::min(zonesW-1, (r.x2 / divs + 1) / ZONE_SIZE);
+	const int zy2 = std::min(zonesH-1, (r.y2 / divs + 1) / ZONE_SIZE);
+	for (int zy = zy1; zy <= zy2; zy++)
+	{
+		for (int zx = zx1; zx <= zx2; zx++)
+		{
+			zones[zy*zonesW + zx].dirty = true;
+			zonesDirty = true;
+		}
+	}
+}
 
-	/*
-	for (int x = 0; x < MAX_ZONES; x++)
+// Plan a long path on the zone graph and return the tiles to walk it
+// through, ending with the goal.  Each leg can then be found with a
+// short search when the previous one is done.  Short paths, and any the
+// zone graph can't plan, get just the goal.
+void PathFinding::getWaypoints(const TileVector &start, const TileVector &goal, std::vector<TileVector> &waypoints)
+{
+	waypoints.clear();
+
+	int slx, sly, glx, gly;
+	if (zones.empty() || !findZonePoint(start, slx, sly) || !findZonePoint(goal, glx, gly)
+		|| std::max(abs(glx - slx), abs(gly - sly)) <= ZONE_SIZE*ZONES_PER_LEG)
+	{
+		waypoints.push_back(goal);
+		return;
+	}
+
+	updateZones();
+
+	const int startZone = (sly / ZONE_SIZE)*zonesW + slx / ZONE_SIZE;
+	const int goalZone = (gly / ZONE_SIZE)*zonesW + glx / ZONE_SIZE;
+	const int gx0 = (goalZone % zonesW) * ZONE_SIZE, gy0 = (goalZone / zonesW) * ZONE_SIZE;
+	std::vector<int> startDist, goalDist;
+	zoneDistances(startZone, slx, sly, startDist);
+	zoneDistances(goalZone, glx, gly, goalDist);
+
+	// The goal is an extra node after the portals.
+	const int goalNode = portals.size();
+	std::vector<int> cost(goalNode+1, -1), from(goalNode+1, -1);
+	std::vector<char> done(goalNode+1, 0);
+	std::priority_queue<std::pair<int, int>, std::vector<std::pair<int, int> >, std::greater<std::pair<int, int> > > open;
+
+	#define ZONE_RELAX(m, c, h) \
+		if (!done[m] && (cost[m] < 0 || (c) < cost[m])) \
+		{ \
+			cost[m] = (c); \
+			from[m] = n; \
+			open.push(std::make_pair((c) + (h), m)); \
+		}
+	#define ZONE_H(m) std::max(abs(portals[m].lx - glx), abs(portals[m].ly - gly))
+
+	const std::vector<int> &startPortals = zones[startZone].portals;
+	const int sx0 = (startZone % zonesW) * ZONE_SIZE, sy0 = (startZone / zonesW) * ZONE_SIZE;
+	for (int i = 0; i < startPortals.size(); i++)
 	{
-		for (int y = 0; y < MAX_ZONES; y++)
+		const int n = -1;
+		const int p = startPortals[i];
+		const int d = startDist[(portals[p].lx-sx0) + (portals[p].ly-sy0)*ZONE_SIZE];
+		if (d >= 0)
+			ZONE_RELAX(p, d, ZONE_H(p));
+	}
+
+	while (!open.empty())
+	{
+		const int n = open.top().second;
+		open.pop();
+		if (done[n])
+			continue;
+		done[n] = 1;
+		if (n == goalNode)
+			break;
+
+		const Portal &p = portals[n];
+		if (p.zone == goalZone)
 		{
-			PathFindingGlobals::zones[x][y] = 0;
+			const int d = goalDist[(p.lx-gx0) + (p.ly-gy0)*ZONE_SIZE];
+			if (d >= 0)
+				ZONE_RELAX(goalNode, cost[n] + d, 0);
+		}
+		ZONE_RELAX(p.link, cost[n] + 1, ZONE_H(p.link));
+		for (int i = 0; i < p.edges.size(); i++)
+		{
+			const int m = p.edges[i].portal;
+			ZONE_RELAX(m, cost[n] + p.edges[i].cost, ZONE_H(m));
 		}
 	}
-	for (int x = 0; x < MAX_GRID; x+=divs)
+	#undef ZONE_RELAX
+	#undef ZONE_H
+
+	if (!done[goalNode])
 	{
-		for (int y = 0; y < MAX_GRID; y+=divs)
+		debugLog("No zone path, searching directly");
+		waypoints.push_back(goal);
+		return;
+	}
+
+	// Walk back from the goal, keeping every ZONES_PER_LEG'th portal
+	// where the path enters a new zone, but none too close to the goal.
+	int entries = 0;
+	for (int n = from[goalNode]; n >= 0; n = from[n])
+	{
+		const int prev = from[n];
+		if (prev >= 0 && portals[prev].link == n)
 		{
-			for (int xx = x; xx < x + divs; xx++)
+			const Portal &p = portals[n];
+			if (++entries % ZONES_PER_LEG == 0
+				&& std::max(abs(p.lx - glx), abs(p.ly - gly)) >= ZONE_SIZE)
 			{
-				for (int yy = y; yy < y + divs; yy++)
-				{
-					if (dsq->game->getGrid(TileVector(xx,yy)) > 0)
-					{
-						PathFindingGlobals::zones[int(x/divs)][int(y/divs)]++;
-					}
-				}
+				waypoints.push_back(TileVector(p.lx*divs, p.ly*divs));
 			}
 		}
 	}
-	*/
+	std::reverse(waypoints.begin(), waypoints.end());
+	waypoints.push_back(goal);
 }
 
 void PathFinding::forceMinimumPath(VectorPath &path, const Vector &start, const Vector &dest)
@@ -689,129 +1135,213 @@ loop:
 	
 }
 
-void PathFinding::generatePath(RenderObject *ro, TileVector start, TileVector goal, int offx, int offy, bool hate_diagonals)
+void PathFinding::setPath(RenderObject *ro, const std::vector<TileVector> &tiles, int offx, int offy)
 {
-	//return;
-
-	int sx = start.x;
-	int sy = start.y;
-	int gx = goal.x;
-	int gy = goal.y;
-	
-
-	PathFindingGlobals::hate_diagonals = hate_diagonals;
-	/*
-	if (offx >= TILE_SIZE/2-1)
-		offx--;
-	if (offy >= TILE_SIZE/2-1)
-		offy--;
-	if (offx <= TILE_SIZE/2+1)
-		offx++;
-	if (offy <= TILE_SIZE/2+1)
-		offy++;
-	*/
 	ro->position.ensureData();
 	ro->position.data->path.clear();
+	for (int i = 0; i < tiles.size(); i++)
+	{
+		const TileVector &t = tiles[i];
+		ro->position.data->path.addPathNode(Vector((t.x*TILE_SIZE)+TILE_SIZE/2+offx, (t.y*TILE_SIZE)+TILE_SIZE/2)+offy, i > 0 ? i-1 : 0);
+	}
+}
 
-	PathFindingGlobals::render_object = ro;
-	AStarSearch astarsearch;
-
-	// Create a start state
-	MapSearchNode nodeStart;
-	nodeStart.x = sx;
-	nodeStart.y = sy;
-	PathFindingGlobals::node_start = nodeStart;
+void PathFinding::generatePath(RenderObject *ro, TileVector start, TileVector goal, int offx, int offy, bool hate_diagonals)
+{
+	ro->position.ensureData();
+	ro->position.data->path.clear();
 
-	if (nodeStart.GetMap(gx, gy) > 0)
+	if (dsq->game->getGrid(goal) > 0)
 	{
 		std::ostringstream os;
-		os << "goal (" << gx << ", " << gy << ") blocked";
+		os << "goal (" << goal.x << ", " << goal.y << ") blocked";
 		debugLog (os.str());
 		return;
 	}
 
-	// Define the goal state
-	
-	MapSearchNode nodeEnd;
-	nodeEnd.x = gx;		
-	nodeEnd.y = gy; 
-
-	PathFindingGlobals::node_goal = nodeEnd;
-	
-	// Set Start and goal states
-	
-	astarsearch.SetStartAndGoalStates( nodeStart, nodeEnd );
-
-	unsigned int SearchState;
-	unsigned int SearchSteps = 0;
+	switch (search(start, goal, hate_diagonals))
+	{
+	case SEARCH_SUCCEEDED:
+		setPath(ro, solution, offx, offy);
+		break;
+	case SEARCH_TOO_LONG:
+		debugLog("Path too long");
+		break;
+	default:
+		debugLog("Search terminated. Did not find goal state");
+		break;
+	}
+}
 
-	do
+PathFinding::PathRequest *PathFinding::getRequest(int handle)
+{
+	for (std::list<PathRequest>::iterator i = requests.begin(); i != requests.end(); i++)
 	{
-		SearchState = astarsearch.SearchStep();
+		if (i->handle == handle)
+			return &(*i);
+	}
+	return 0;
+}
 
-		if (SearchState != AStarSearch::SEARCH_STATE_SEARCHING)
-			break;
+int PathFinding::requestPath(TileVector start, TileVector goal, bool hate_diagonals)
+{
+	PathRequest r;
+	r.handle = nextRequest++;
+	r.start = start;
+	r.goal = goal;
+	r.hate_diagonals = hate_diagonals;
+	r.state = PATHREQUEST_PENDING;
+	if (dsq->game->getGrid(goal) > 0)
+	{
+		std::ostringstream os;
+		os << "goal (" << goal.x << ", " << goal.y << ") blocked";
+		debugLog (os.str());
+		r.state = PATHREQUEST_FAILED;
+	}
+	requests.push_back(r);
+	return r.handle;
+}
 
-		SearchSteps++;
+PathRequestState PathFinding::getRequestState(int handle)
+{
+	PathRequest *r = getRequest(handle);
+	return r ? r->state : PATHREQUEST_NONE;
+}
 
-		if (SearchSteps > MAX_STEPS) break;
+void PathFinding::finishRequest(int handle, RenderObject *ro, int offx, int offy)
+{
+	PathRequest *r = getRequest(handle);
+	if (r && r->state == PATHREQUEST_DONE)
+	{
+		setPath(ro, r->solution, offx, offy);
 	}
-	while( SearchState == AStarSearch::SEARCH_STATE_SEARCHING );
-
-	if( SearchState == AStarSearch::SEARCH_STATE_SUCCEEDED )
+	else
 	{
-		//errorLog ("Search found goal state",0);
+		ro->position.ensureData();
+		ro->position.data->path.clear();
+	}
+	cancelRequest(handle);
+}
 
-			MapSearchNode *node = astarsearch.GetSolutionStart();
-			int steps = 0;
+void PathFinding::cancelRequest(int handle)
+{
+	for (std::list<PathRequest>::iterator i = requests.begin(); i != requests.end(); i++)
+	{
+		if (i->handle == handle)
+		{
+			requests.erase(i);
+			break;
+		}
+	}
+	if (activeRequest == handle)
+		activeRequest = 0;
+}
 
-			//node->PrintNodeInfo();
-			ro->position.data->path.addPathNode(Vector((node->x*TILE_SIZE)+TILE_SIZE/2+offx, (node->y*TILE_SIZE)+TILE_SIZE/2)+offy, 0);
-			for( ;; )
-			{
-				node = astarsearch.GetSolutionNext();
+// Run queued searches, oldest first, until this frame's steps are used.
+// The grid may change between frames; a search simply sees the grid as
+// it is when each node is expanded.
+//
+// Each path found also has to be smoothed by molestPath() when its entity
+// picks it up, which traces between pairs of nodes, so a finished search
+// is charged the square of its length as well.  That keeps a burst of
+// short searches from all finishing, and all being smoothed, at once.
+void PathFinding::update()
+{
+	int steps = REQUEST_STEPS_PER_FRAME;
+	std::list<PathRequest>::iterator i = requests.begin();
+	while (steps > 0)
+	{
+		while (i != requests.end() && i->state != PATHREQUEST_PENDING)
+			i++;
+		if (i == requests.end())
+			break;
 
-				if( !node )
-				{
-					break;
-				}
+		if (activeRequest != i->handle)
+		{
+			beginSearch(i->start, i->goal, i->hate_diagonals);
+			activeRequest = i->handle;
+		}
+		const int before = expanded;
+		const SearchResult result = continueSearch(steps);
+		steps -= std::max(1, expanded - before);
 
-				//node->PrintNodeInfo();
-				ro->position.data->path.addPathNode(Vector((node->x*TILE_SIZE)+TILE_SIZE/2+offx, (node->y*TILE_SIZE)+TILE_SIZE/2)+offy, steps);
-				steps ++;
-			};
-			//ro->position.path.addPathNode(Vector(goal.x*TILE_SIZE, goal.y*TILE_SIZE), steps);
-			/*
-			std::ostringstream os;
-			os << "Solution steps " << steps;
-			msg(os.str());
-			*/
-			
-			// Once you're done with the solution you can free the nodes up
-			astarsearch.FreeSolutionNodes();
+		switch (result)
+		{
+		case SEARCH_SEARCHING:
+			break;
+		case SEARCH_SUCCEEDED:
+			i->state = PATHREQUEST_DONE;
+			i->solution = solution;
+			activeRequest = 0;
+			steps -= int(solution.size() * solution.size());
+			break;
+		case SEARCH_TOO_LONG:
+			debugLog("Path too long");
+			i->state = PATHREQUEST_FAILED;
+			activeRequest = 0;
+			break;
+		default:
+			debugLog("Search terminated. Did not find goal state");
+			i->state = PATHREQUEST_FAILED;
+			activeRequest = 0;
+			break;
+		}
 	}
-	else if( SearchState == AStarSearch::SEARCH_STATE_FAILED )
+}
+
+void PathFinding::benchmark(int numPaths)
+{
+	TileVector tmin(dsq->game->cameraMin), tmax(dsq->game->cameraMax);
+	tmin.x = std::max(tmin.x, 0);
+	tmin.y = std::max(tmin.y, 0);
+	tmax.x = std::min(tmax.x, MAX_GRID-1);
+	tmax.y = std::min(tmax.y, MAX_GRID-1);
+	if (tmax.x <= tmin.x || tmax.y <= tmin.y)
 	{
-		debugLog("Search terminated. Did not find goal state");
-		
-		//astarsearch.FreeSolutionNodes();
-		astarsearch.FreeStartAndGoalNodes();
+		debugLog("Path benchmark: no map loaded");
+		return;
 	}
-	else
+
+	// Fixed seed, so runs on the same map can be compared.
+	std::vector<TileVector> ends;
+	unsigned int seed = 12345;
+	for (int tries = 0; ends.size() < numPaths*2 && tries < numPaths*200; tries++)
 	{
-		// exceeded count
-		debugLog("Path too long");
-		
-		astarsearch.FreeAllNodes();
-		astarsearch.FreeStartAndGoalNodes();
-		//astarsearch.FreeSolutionNodes();		
+		seed = seed*1103515245 + 12345;
+		const int x = tmin.x + (seed>>8) % (tmax.x - tmin.x + 1);
+		seed = seed*1103515245 + 12345;
+		const int y = tmin.y + (seed>>8) % (tmax.y - tmin.y + 1);
+		if (dsq->game->getGrid(TileVector(x, y)) == 0)
+			ends.push_back(TileVector(x, y));
 	}
+	const int num = ends.size()/2;
 
-	if (astarsearch.m_AllocateNodeCount != astarsearch.m_FreeNodeCount)
+	const bool oldJumpPoints = jumpPoints;
+	for (int mode = 0; mode < 2; mode++)
 	{
-		debugLog("astar memory leak");
+		jumpPoints = (mode == 1);
+		int found = 0, failed = 0, tooLong = 0;
+		int totalExpanded = 0, totalNodes = 0;
+		const uint32 startTime = core->getTicks();
+		for (int i = 0; i < num; i++)
+		{
+			switch (search(ends[i*2], ends[i*2+1], false))
+			{
+			case SEARCH_SUCCEEDED:	found++;	break;
+			case SEARCH_TOO_LONG:	tooLong++;	break;
+			default:				failed++;	break;
+			}
+			totalExpanded += expanded;
+			totalNodes += nodes.size();
+		}
+		const uint32 ms = core->getTicks() - startTime;
+
+		std::ostringstream os;
+		os << "Path benchmark [" << dsq->game->sceneName << "] " << (jumpPoints ? "jump points" : "A*") << ": "
+		   << num << " paths in " << ms << "ms - found: " << found << " failed: " << failed << " too long: " << tooLong
+		   << " expanded: " << totalExpanded << " nodes: " << totalNodes;
+		debugLog(os.str());
+		dsq->screenMessage(os.str());
 	}
-	//return path_vector;
+	jumpPoints = oldJumpPoints;
 }
-
-
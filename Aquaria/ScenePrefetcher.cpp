@@ -0,0 +1,145 @@
+/*
+Copyright (C) 2007, 2010 - Bit-Blot
+
+This file is part of Aquaria.
+
+Aquaria is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+
+See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+*/
+#include "ScenePrefetcher.h"
+#include "DSQ.h"
+#include "Game.h"
+
+// Start warming the given scenes, replacing any earlier request.  The
+// scene files themselves go first, since they lead to everything else.
+void ScenePrefetcher::prefetchScenes(const std::vector<std::string> &scenes)
+{
+	cancel();
+
+	modPath = dsq->mod.isActive() ? dsq->mod.getPath() : "";
+	modTexturePath = core->secondaryTexturePath;
+	textureDir = core->getBaseTextureDirectory();
+
+	std::vector<std::string> files;
+	int i;
+	for (i = 0; i < scenes.size(); i++)
+		files.push_back(getSceneFilename(scenes[i]));
+	for (i = 0; i < scenes.size(); i++)
+	{
+		const std::string premap = "scripts/maps/premap_" + scenes[i] + ".lua";
+		const std::string map = "scripts/maps/map_" + scenes[i] + ".lua";
+		if (!modPath.empty())
+		{
+			files.push_back(modPath + premap);
+			files.push_back(modPath + map);
+		}
+		files.push_back(premap);
+		files.push_back(map);
+	}
+	prefetch(files);
+}
+
+void ScenePrefetcher::processFile(const std::string &file)
+{
+	const size_t len = file.size();
+	if (len > 4 && file.compare(len-4, 4, ".xml") == 0)
+		readScene(file);
+	else if (len > 4 && file.compare(len-4, 4, ".txt") == 0)
+		readTileset(file);
+	else
+		FilePrefetcher::processFile(file);
+}
+
+void ScenePrefetcher::readScene(const std::string &file)
+{
+	unsigned long size;
+	char *data = readFile(core->adjustFilenameCase(file), &size);
+	if (!data)
+		return;
+
+	TiXmlDocument doc;
+	doc.Parse(data);
+	delete[] data;
+	if (isCancelled())
+		return;
+
+	TiXmlElement *level = doc.FirstChildElement("Level");
+	if (!level)
+		return;
+
+	std::string pack;
+	if (level->Attribute("tileset"))
+		pack = level->Attribute("tileset");
+	else if (level->Attribute("elementTemplatePack"))
+		pack = level->Attribute("elementTemplatePack");
+	if (!pack.empty())
+	{
+		stringToLower(pack);
+		enqueue((modPath.empty() ? "data/" : modPath) + "tilesets/" + pack + ".txt");
+	}
+
+	if (level->Attribute("bg"))
+		enqueueTexture(level->Attribute("bg"));
+	if (level->Attribute("bg2"))
+		enqueueTexture(level->Attribute("bg2"));
+}
+
+void ScenePrefetcher::readTileset(const std::string &file)
+{
+	std::ifstream in(core->adjustFilenameCase(file).c_str());
+	std::string line;
+	while (!isCancelled() && std::getline(in, line))
+	{
+		int idx=-1;
+		std::string gfx;
+		std::istringstream is(line);
+		is >> idx >> gfx;
+		if (!gfx.empty())
+			enqueueTexture(gfx);
+	}
+}
+
+// Queue the image file Core::addTexture() would load for this name.
+void ScenePrefetcher::enqueueTexture(const std::string &tex)
+{
+	if (tex.empty())
+		return;
+	std::string name = tex;
+	stringToLower(name);
+
+	const bool hasExtension = name.find('.') != std::string::npos;
+	std::vector<std::string> candidates;
+	if (!modTexturePath.empty() && name[0] != '.' && name[0] != '/')
+		candidates.push_back(modTexturePath + name);
+	candidates.push_back(textureDir + name);
+
+	for (int i = 0; i < candidates.size(); i++)
+	{
+		const char *exts[] = {"", ".png", ".jp2"};
+		for (int j = hasExtension ? 0 : 1; j < sizeof(exts)/sizeof(*exts); j++)
+		{
+			const std::string path = core->adjustFilenameCase(candidates[i] + exts[j]);
+			if (exists(path, false))
+			{
+				// Texture::load() reads the .dtx copy instead if it's usable.
+				std::string cacheFile;
+				if (path.size() > 4 && path.compare(path.size()-4, 4, ".png") == 0)
+					cacheFile = Texture::getCacheFile(path);
+				enqueue(cacheFile.empty() ? path : cacheFile);
+				return;
+			}
+		}
+	}
+}
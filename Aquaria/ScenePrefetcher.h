@@ -0,0 +1,48 @@
+/*
+Copyright (C) 2007, 2010 - Bit-Blot
+
+This file is part of Aquaria.
+
+Aquaria is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+
+See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+*/
+#pragma once
+
+#include "../BBGE/FilePrefetcher.h"
+
+// Warms the files for the scenes reachable from the current one, so that
+// leaving through a warp area or warp node doesn't have to wait on the
+// disk.  Scene XML files are parsed on the prefetch thread to find the
+// tileset and background textures they use.
+class ScenePrefetcher : public FilePrefetcher
+{
+public:
+	~ScenePrefetcher() { shutdown(); }
+
+	void prefetchScenes(const std::vector<std::string> &scenes);
+
+protected:
+	void processFile(const std::string &file);
+
+private:
+	void readScene(const std::string &file);
+	void readTileset(const std::string &file);
+	void enqueueTexture(const std::string &tex);
+
+	// Copied from the game when prefetchScenes() is called (while the
+	// prefetch thread is idle), since the thread can't safely look at the
+	// game's own copies.
+	std::string modPath, modTexturePath, textureDir;
+};
@@ -275,16 +275,21 @@ void SchoolFish::applyAvoidance(Vector &accumulator)
 	int obsSumX = 0, obsSumY = 0;  // Not a Vector (avoid using floats)
 	int obsCount = 0;
 	const TileVector t0(position);
-	TileVector t;
-	for (t.x = t0.x-range; t.x <= t0.x+range; t.x += step)
+	// Out in open water there is nothing within range to avoid, and the
+	// wall distance field tells us so without scanning the whole box.
+	if (dsq->game->getWallDistance(t0) <= range)
 	{
-		for (t.y = t0.y-range; t.y <= t0.y+range; t.y += step)
+		TileVector t;
+		for (t.x = t0.x-range; t.x <= t0.x+range; t.x += step)
 		{
-			if (dsq->game->isObstructed(t))
+			for (t.y = t0.y-range; t.y <= t0.y+range; t.y += step)
 			{
-				obsSumX += t0.x - t.x;
-				obsSumY += t0.y - t.y;
-				obsCount++;
+				if (dsq->game->isObstructed(t))
+				{
+					obsSumX += t0.x - t.x;
+					obsSumY += t0.y - t.y;
+					obsCount++;
+				}
 			}
 		}
 	}
@@ -1320,33 +1320,25 @@ luaFunc(entity_setSegmentTexture)
 	luaReturnNum(0);
 }
 
+// Living entities of one type, whether or not they are present.
+struct LivingEntityFilter : public EntityFilter
+{
+	LivingEntityFilter(Entity *ignore, EntityType type) : EntityFilter(ignore, type) {}
+	bool accept(Entity *e) const
+	{
+		return e != ignore && e->health > 0 && !e->isEntityDead() && e->getEntityType() == type;
+	}
+};
+
 luaFunc(entity_findNearestEntityOfType)
 {
 	Entity *e = entity(L);
 	Entity *nearest = 0;
 	if (e)
 	{
-		int et = (EntityType)lua_tointeger(L, 2);
+		EntityType et = (EntityType)lua_tointeger(L, 2);
 		int maxRange = lua_tointeger(L, 3);
-		float smallestDist = HUGE_VALF;
-		Entity *closest = 0;
-		FOR_ENTITIES(i)
-		{
-			Entity *ee = *i;
-			if (ee != e)
-			{
-				float dist = (ee->position - e->position).getSquaredLength2D();
-				if (ee->health > 0 && !ee->isEntityDead() && ee->getEntityType() == et && dist < smallestDist)
-				{
-					smallestDist = dist;
-					closest = ee;
-				}
-			}
-		}
-		if (maxRange == 0 || smallestDist <= sqr(maxRange))
-		{
-			nearest = closest;
-		}
+		nearest = dsq->entityGrid.getNearestEntity(e->position, maxRange ? maxRange : HUGE_VALF, LivingEntityFilter(e, et));
 	}
 	luaReturnPtr(nearest);
 }
@@ -4361,6 +4353,7 @@ luaFunc(entity_setPosition)
 	if (e)
 	{
 		t = e->position.interpolateTo(Vector(lua_tonumber(L, 2), lua_tonumber(L, 3)), lua_tonumber(L, 4), lua_tonumber(L, 5), lua_tonumber(L, 6), lua_tonumber(L, 7));
+		dsq->entityGrid.update(e);
 	}
 	luaReturnNum(t);
 }
@@ -4485,7 +4478,13 @@ luaFunc(entity_playSfx)
 	Entity *e= entity(L);
 	if (e)
 	{
-		std::string sfx = lua_tostring(L, 2);
+		if (lua_type(L, 2) == LUA_TNUMBER)
+		{
+			dsq->playPositionalSfx(lua_tointeger(L, 2), e->position);
+			luaReturnNum(0);
+		}
+
+		std::string sfx = getString(L, 2);
 
 
 		/*
@@ -4989,7 +4988,11 @@ luaFunc(playSfx)
 		vol = 1;
 
 	PlaySfx sfx;
-	sfx.name = getString(L, 1);
+	// Accept either a name or a handle from getSfxHandle().
+	if (lua_type(L, 1) == LUA_TNUMBER)
+		sfx.handle = lua_tointeger(L, 1);
+	else
+		sfx.name = getString(L, 1);
 	sfx.vol = vol;
 	sfx.freq = freq;
 	sfx.loops = loops;
@@ -5002,6 +5005,11 @@ luaFunc(playSfx)
 	luaReturnPtr(handle);
 }
 
+luaFunc(getSfxHandle)
+{
+	luaReturnNum(core->sound->getSfxHandle(getString(L, 1)));
+}
+
 luaFunc(fadeSfx)
 {
 	void *header = lua_touserdata(L, 1);
@@ -5543,9 +5551,11 @@ luaFunc(entity_pullEntities)
 		int range = lua_tonumber(L, 4);
 		float len = lua_tonumber(L, 5);
 		float dt = lua_tonumber(L, 6);
-		FOR_ENTITIES(i)
+		EntityContainer nearby;
+		dsq->entityGrid.getEntitiesInRange(pos, range, nearby);
+		for (int i = 0; i < nearby.size(); i++)
 		{
-			Entity *ent = *i;
+			Entity *ent = nearby[i];
 			if (ent != e && (e->getEntityType() == ET_ENEMY || e->getEntityType() == ET_AVATAR) && e->isUnderWater())
 			{
 				Vector diff = ent->position - pos;
@@ -6009,6 +6019,23 @@ luaFunc(node_getNumEntitiesIn)
 	luaReturnNum(c);
 }
 
+// Present entities on the normal layers, optionally with (or without,
+// if nameCheck is false) the given name.
+struct NamedEntityFilter : public EntityFilter
+{
+	NamedEntityFilter(Entity *ignore, const char *name, bool nameCheck) : EntityFilter(ignore), name(name), nameCheck(nameCheck) {}
+	bool accept(Entity *e) const
+	{
+		if (!EntityFilter::accept(e) || !e->isNormalLayer())
+			return false;
+		return !name || ((nocasecmp(e->name, name)==0) == nameCheck);
+	}
+	const char *getRequiredName() const { return nameCheck ? name : 0; }
+
+	const char *name;
+	bool nameCheck;
+};
+
 luaFunc(node_getNearestEntity)
 {
 	//Entity *me = entity(L);
@@ -6023,23 +6050,7 @@ luaFunc(node_getNearestEntity)
 		if (lua_isstring(L, 2))
 			name = lua_tostring(L, 2);
 
-		float smallestDist = HUGE_VALF;
-		FOR_ENTITIES(i)
-		{
-			Entity *e = *i;
-			if (e->isPresent() && e->isNormalLayer())
-			{
-				if (name.empty() || (nocasecmp(e->name, name)==0))
-				{
-					float dist = (pos - e->position).getSquaredLength2D();
-					if (dist < smallestDist)
-					{
-						smallestDist = dist;
-						closest = e;
-					}
-				}
-			}
-		}
+		closest = dsq->entityGrid.getNearestEntity(pos, HUGE_VALF, NamedEntityFilter(0, name.empty() ? 0 : name.c_str(), true));
 	}
 	luaReturnPtr(closest);
 }
@@ -6121,30 +6132,13 @@ luaFunc(entity_getNearestEntity)
 	int range = lua_tointeger(L, 3);
 	int type = lua_tointeger(L, 4);
 	int damageTarget = lua_tointeger(L, 5);
+	NamedEntityFilter filter(me, name, nameCheck);
+	// 0 means any type here, but 0 is ET_AVATAR to the filter.
+	filter.type = type ? (EntityType)type : ET_NOTYPE;
+	filter.damageTarget = damageTarget ? (DamageType)damageTarget : DT_NONE;
 	Entity *closest = 0;
-	float smallestDist = range ? sqr(range) : HUGE_VALF;
-	FOR_ENTITIES(i)
-	{
-		Entity *e = *i;
-		if (e != me && e->isPresent() && e->isNormalLayer())
-		{
-			if (!name || ((nocasecmp(e->name, name)==0) == nameCheck))
-			{
-				if (type == 0 || e->getEntityType() == type)
-				{
-					if (damageTarget == 0 || e->isDamageTarget((DamageType)damageTarget))
-					{
-						float dist = (me->position - e->position).getSquaredLength2D();
-						if (dist < smallestDist)
-						{
-							smallestDist = dist;
-							closest = e;
-						}
-					}
-				}
-			}
-		}
-	}
+	if (me)
+		closest = dsq->entityGrid.getNearestEntity(me->position, range ? range : HUGE_VALF, filter);
 	luaReturnPtr(closest);
 }
 
@@ -7625,6 +7619,7 @@ static const struct {
 	luaRegister(playMusicOnce),
 
 	luaRegister(playSfx),
+	luaRegister(getSfxHandle),
 	luaRegister(fadeSfx),
 
 	luaRegister(emote),
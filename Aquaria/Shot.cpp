@@ -25,7 +25,10 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 
 #include "../BBGE/MathFunctions.h"
 
+#include <algorithm>
+
 Shot::Shots Shot::shots;
+ShotGrid Shot::grid;
 Shot::ShotBank Shot::shotBank;
 
 std::string Shot::shotBankPath = "";
@@ -34,6 +37,7 @@ void (*Shot::loadProgressCallback)() = NULL;
 
 ShotData::ShotData()
 {
+	hitSfxHandle = bounceSfxHandle = fireSfxHandle = 0;
 	avatarKickBack= 0;
 	avatarKickBackTime = 0;
 	effectTime = 0;
@@ -244,6 +248,13 @@ void ShotData::bankLoad(const std::string &file, const std::string &path)
 
 	}
 	inf.close();
+
+	if (!hitSfx.empty())
+		hitSfxHandle = dsq->sound->getSfxHandle(hitSfx);
+	if (!bounceSfx.empty())
+		bounceSfxHandle = dsq->sound->getSfxHandle(bounceSfx);
+	if (!fireSfx.empty())
+		fireSfxHandle = dsq->sound->getSfxHandle(fireSfx);
 }
 
 void Shot::fire(bool playSfx)
@@ -257,9 +268,9 @@ void Shot::fire(bool playSfx)
 
 		if (!fired)
 		{
-			if (!shotData->fireSfx.empty() && playSfx)
+			if (shotData->fireSfxHandle && playSfx)
 			{
-				dsq->playPositionalSfx(shotData->fireSfx, position);
+				dsq->playPositionalSfx(shotData->fireSfxHandle, position);
 			}
 			fired = true;
 		}
@@ -335,6 +346,7 @@ Shot::Shot() : Quad(), Segmented(0,0)
 	target = 0;
 	dead = false;
 	shots.push_back(this);
+	grid.add(this);
 }
 
 void loadShotCallback(const std::string &filename, intptr_t param)
@@ -486,6 +498,7 @@ void Shot::onEndOfLife()
 {
 	destroySegments(0.2);
 	shots.remove(this);
+	grid.remove(this);
 	if (emitter)
 	{
 		emitter->killParticleEffect();
@@ -500,8 +513,8 @@ void Shot::doHitEffects()
 	{
 		if (!shotData->hitPrt.empty())
 			dsq->spawnParticleEffect(shotData->hitPrt, position);
-		if (!shotData->hitSfx.empty())
-			dsq->playPositionalSfx(shotData->hitSfx, position);
+		if (shotData->hitSfxHandle)
+			dsq->playPositionalSfx(shotData->hitSfxHandle, position);
 	}
 }
 
@@ -535,6 +548,135 @@ void Shot::onHitWall()
 	}
 }
 
+// Width of a shot grid cell in world units.
+const float SHOTGRID_CELL_SIZE = 256;
+
+// Least amount of padding added to every query for shots that moved since
+// the last rebuild.
+const float SHOTGRID_MIN_SLACK = 64;
+
+ShotGrid::ShotGrid()
+{
+	size = int(ceilf(MAX_GRID * TILE_SIZE / SHOTGRID_CELL_SIZE));
+	cells.resize(size * size, 0);
+	nextIndex = 0;
+	slack = SHOTGRID_MIN_SLACK;
+	maxRadius = 0;
+}
+
+bool ShotGrid::indexLess(const Shot *a, const Shot *b)
+{
+	return a->gridIndex < b->gridIndex;
+}
+
+int ShotGrid::cellCoord(float v) const
+{
+	if (!(v > 0))
+		return 0;
+	const float c = v / SHOTGRID_CELL_SIZE;
+	if (c >= size)
+		return size-1;
+	return int(c);
+}
+
+// Rebucket every shot.  Called once a frame, after the shots have moved.
+void ShotGrid::rebuild()
+{
+	clear();
+	float maxMove = 0;
+	int index = 0;
+	for (Shot::Shots::iterator i = Shot::shots.begin(); i != Shot::shots.end(); i++)
+	{
+		Shot *s = *i;
+		if (s->gridCell >= 0)
+		{
+			// Ignore shots that were placed rather than moved.
+			const float move = (s->position - s->gridPos).getLength2D();
+			if (move < SHOTGRID_CELL_SIZE && move > maxMove)
+				maxMove = move;
+		}
+		const int cell = cellCoord(s->position.y) * size + cellCoord(s->position.x);
+		if (!cells[cell])
+			usedCells.push_back(cell);
+		s->gridCell = cell;
+		s->gridIndex = index++;
+		s->gridPrev = 0;
+		s->gridNext = cells[cell];
+		if (s->gridNext)
+			s->gridNext->gridPrev = s;
+		cells[cell] = s;
+		s->gridPos = s->position;
+		if (s->collideRadius > maxRadius)
+			maxRadius = s->collideRadius;
+	}
+	nextIndex = index;
+	slack = std::max(SHOTGRID_MIN_SLACK, maxMove * 2);
+}
+
+void ShotGrid::clear()
+{
+	for (int i = 0; i < usedCells.size(); i++)
+		cells[usedCells[i]] = 0;
+	usedCells.clear();
+	late.clear();
+	maxRadius = 0;
+}
+
+void ShotGrid::add(Shot *s)
+{
+	s->gridNext = s->gridPrev = 0;
+	s->gridCell = -1;
+	s->gridIndex = nextIndex++;
+	late.push_back(s);
+}
+
+void ShotGrid::remove(Shot *s)
+{
+	if (s->gridIndex < 0)
+		return;
+	if (s->gridCell < 0)
+	{
+		std::vector<Shot*>::iterator i = std::find(late.begin(), late.end(), s);
+		if (i != late.end())
+			late.erase(i);
+	}
+	else
+	{
+		if (s->gridPrev)
+			s->gridPrev->gridNext = s->gridNext;
+		else
+			cells[s->gridCell] = s->gridNext;
+		if (s->gridNext)
+			s->gridNext->gridPrev = s->gridPrev;
+	}
+	s->gridNext = s->gridPrev = 0;
+	s->gridCell = -1;
+	s->gridIndex = -1;
+}
+
+void ShotGrid::getShotsNear(const Vector &pos, float radius, std::vector<Shot*> &out) const
+{
+	out.clear();
+	const float pad = radius + maxRadius + slack;
+	const int x0 = cellCoord(pos.x - pad), x1 = cellCoord(pos.x + pad);
+	const int y0 = cellCoord(pos.y - pad), y1 = cellCoord(pos.y + pad);
+	for (int y = y0; y <= y1; y++)
+	{
+		for (int x = x0; x <= x1; x++)
+		{
+			for (Shot *s = cells[y*size+x]; s; s = s->gridNext)
+			{
+				if ((s->position - pos).isLength2DIn(radius + s->collideRadius + slack))
+					out.push_back(s);
+			}
+		}
+	}
+	std::sort(out.begin(), out.end(), indexLess);
+	// Fired since the last rebuild, so already in order and after the
+	// rest.
+	out.insert(out.end(), late.begin(), late.end());
+}
+
 void Shot::killAllShots()
 {
 	std::queue<Shot*>shotDeleteQueue;
@@ -553,6 +695,7 @@ void Shot::killAllShots()
 		shotDeleteQueue.pop();
 	}
 	shots.clear();
+	grid.clear();
 }
 
 void Shot::reflectFromEntity(Entity *e)
@@ -872,9 +1015,9 @@ void Shot::onUpdate(float dt)
 				{
 				case BOUNCE_REAL:
 				{
-					if (!shotData->bounceSfx.empty())
+					if (shotData->bounceSfxHandle)
 					{
-						dsq->playPositionalSfx(shotData->bounceSfx, position);
+						dsq->playPositionalSfx(shotData->bounceSfxHandle, position);
 					}
 					float len = velocity.getLength2D();
 					Vector I = velocity/len;
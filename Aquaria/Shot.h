@@ -29,6 +29,7 @@ struct ShotData
 	ShotData();
 	std::string texture;
 	std::string hitSfx, bounceSfx, fireSfx;
+	int hitSfxHandle, bounceSfxHandle, fireSfxHandle;
 	std::string hitPrt, trailPrt, firePrt, bouncePrt;
 	std::string spawnEntity;
 	BounceType bounceType;
@@ -69,6 +70,39 @@ struct ShotData
 	
 };
 
+class Shot;
+
+// Buckets the live shots by position once a frame so that an entity only
+// tests the shots near it.  Shots fired since the last rebuild are kept
+// on a separate list that every query includes.  Queries are padded by
+// the largest shot collideRadius and by how far shots moved over the last
+// frame, and return shots in Shot::shots order.
+class ShotGrid
+{
+public:
+	ShotGrid();
+
+	void rebuild();
+	void clear();
+	void add(Shot *s);
+	void remove(Shot *s);
+
+	// Shots that may touch a circle of the given radius around pos.
+	void getShotsNear(const Vector &pos, float radius, std::vector<Shot*> &out) const;
+
+private:
+	static bool indexLess(const Shot *a, const Shot *b);
+	int cellCoord(float v) const;
+
+	std::vector<Shot*> cells;
+	std::vector<int> usedCells;
+	std::vector<Shot*> late;
+	int size;
+	int nextIndex;
+	float slack;
+	float maxRadius;
+};
+
 class Shot : public Quad, public Segmented
 {
 public:
@@ -79,6 +113,7 @@ public:
 	void setParticleEffect(const std::string &particleEffect);
 	typedef std::list<Shot*> Shots;
 	static Shots shots;
+	static ShotGrid grid;
 	static std::string shotBankPath;
 	static void targetDied(Entity *t);
 	static void killAllShots();
@@ -117,6 +152,7 @@ public:
 	void updatePosition();
 	bool isHitEnts();
 	bool isObstructed();
+	bool isRemoved() const { return gridIndex < 0; }
 
 	float extraDamage;
 protected:
@@ -136,6 +172,14 @@ protected:
 
 	bool dead;
 	void onUpdate(float dt);
+
+private:
+	// Bookkeeping for Shot::grid
+	friend class ShotGrid;
+	Shot *gridNext, *gridPrev;
+	int gridCell;		// -1 for shots on the late list
+	int gridIndex;		// order in Shot::shots; -1 once removed
+	Vector gridPos;
 };
 
 class Beam : public Quad
@@ -22,21 +22,37 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 
 StringBank::StringBank()
 {
+	loadedGeneration = -1;
 }
 
 void StringBank::load(const std::string &file)
 {
     //debugLog("StringBank::load("+file+")");
-	stringMap.clear();
 
-	std::ifstream in(file.c_str());
+	// This gets called on every continuity reset; only reparse if the
+	// text cache has been flushed since.
+	if (file == loadedFile && loadedGeneration == dsq->textCache.getGeneration())
+		return;
+	loadedFile = file;
+	loadedGeneration = dsq->textCache.getGeneration();
+
+	stringMap.clear();
 
-	std::string line;
-	int idx;
+	const TextCache::File &text = dsq->textCache.get(file);
 
-	while (in >> idx)
+	for (int n = 0; n < text.lines.size(); n++)
 	{
-		std::getline(in, line);
+		std::string line = text.lines[n];
+		if (line.find_first_not_of(" \t\r") == std::string::npos)
+			continue;
+
+		// Same rules as reading "index rest-of-line" pairs from a stream:
+		// stop at the first line that doesn't start with a number.
+		std::istringstream is(line);
+		int idx;
+		if (!(is >> idx))
+			break;
+		std::getline(is, line);
 
 		//std::ostringstream os;
 		//os << idx << ": StringBank Read Line: " << line;
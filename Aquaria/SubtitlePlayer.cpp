@@ -42,29 +42,28 @@ void SubtitlePlayer::go(const std::string &subs)
 	subLines.clear();
 
 	std::string f;
-	bool checkAfter = true;
+	const TextCache::File *text = 0;
 	if (dsq->mod.isActive())
 	{
 		f = dsq->mod.getPath() + "audio/" + subs + ".txt";
 		stringToLower(f);
-		if (exists(f))
-			checkAfter = false;
+		text = &dsq->textCache.get(f);
 	}
 
-	if (checkAfter)
+	if (!text || !text->found)
 	{
 		f = "scripts/vox/" + subs + ".txt";
 		stringToLower(f);
-		if (!exists(f))
+		text = &dsq->textCache.get(f);
+		if (!text->found)
 		{
 			debugLog("Could not find subs file [" + subs + "]");
 		}
 	}
 
-	std::ifstream in(f.c_str());
-	std::string line;
-	while (std::getline(in, line))
+	for (int i = 0; i < text->lines.size(); i++)
 	{
+		const std::string &line = text->lines[i];
 		SubLine sline;
 		const char *s = line.c_str();
 		int minutes = (int)strtol(s, const_cast<char **>(&s), 10);
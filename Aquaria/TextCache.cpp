@@ -0,0 +1,84 @@
+/*
+Copyright (C) 2007, 2010 - Bit-Blot
+
+This file is part of Aquaria.
+
+Aquaria is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+
+See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+*/
+#include "DSQ.h"
+
+TextCache::TextCache()
+{
+	generation = 0;
+}
+
+const TextCache::File &TextCache::get(const std::string &path)
+{
+	FileMap::iterator i = files.find(path);
+	if (i != files.end())
+		return i->second;
+
+	File &file = files[path];
+	std::ifstream in(core->adjustFilenameCase(path).c_str());
+	if (!in)
+		return file;
+	file.found = true;
+
+	std::string line;
+	while (std::getline(in, line))
+	{
+		file.lines.push_back(line);
+
+		size_t start = line.find_first_not_of(" \t");
+		if (start != std::string::npos && line[start] == '[')
+		{
+			size_t end = line.find(']', start);
+			if (end != std::string::npos)
+			{
+				std::string name = line.substr(start+1, end-start-1);
+				if (file.sections.find(name) == file.sections.end())
+					file.sections[name] = file.lines.size();
+			}
+		}
+	}
+	return file;
+}
+
+// Returns the index of the line following the header of the given
+// section, or -1 if the file has no such section.
+int TextCache::findSection(const std::string &path, const std::string &section)
+{
+	const File &file = get(path);
+	std::map<std::string, int>::const_iterator i = file.sections.find(section);
+	if (i != file.sections.end())
+		return i->second;
+
+	// Fall back to the old loose match for headers that aren't in the
+	// exact "[name]" form.
+	for (int n = 0; n < file.lines.size(); n++)
+	{
+		const std::string &s = file.lines[n];
+		if (s.find("[") != std::string::npos && s.find(section) != std::string::npos)
+			return n+1;
+	}
+	return -1;
+}
+
+void TextCache::clear()
+{
+	files.clear();
+	generation++;
+}
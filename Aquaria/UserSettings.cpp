@@ -80,6 +80,12 @@ void UserSettings::save()
 				xml_device.SetAttribute("name", audio.deviceName);
 			}
 			xml_audio.InsertEndChild(xml_device);
+
+			TiXmlElement xml_sampleCache("SampleCache");
+			{
+				xml_sampleCache.SetAttribute("kb", audio.sampleCacheKB);
+			}
+			xml_audio.InsertEndChild(xml_sampleCache);
 		}
 		doc.InsertEndChild(xml_audio);
 
@@ -118,6 +124,10 @@ void UserSettings::save()
 			TiXmlElement xml_numParticles("NumParticles");
 			xml_numParticles.SetAttribute("v", video.numParticles);
 			xml_video.InsertEndChild(xml_numParticles);
+
+			TiXmlElement xml_textureBudget("TextureBudget");
+			xml_textureBudget.SetAttribute("mb", video.textureBudget);
+			xml_video.InsertEndChild(xml_textureBudget);
 			
 			TiXmlElement xml_screenMode("ScreenMode");
 			{
@@ -495,6 +505,12 @@ void UserSettings::load(bool doApply, const std::string &overrideFile)
 		{
 			audio.deviceName = xml_device->Attribute("name");
 		}
+
+		TiXmlElement *xml_sampleCache = xml_audio->FirstChildElement("SampleCache");
+		if (xml_sampleCache)
+		{
+			xml_sampleCache->Attribute("kb", &audio.sampleCacheKB);
+		}
 	}
 	TiXmlElement *xml_video = doc.FirstChildElement("Video");
 	if (xml_video)
@@ -522,6 +538,8 @@ void UserSettings::load(bool doApply, const std::string &overrideFile)
 		
 		readInt(xml_video, "NumParticles", "v", &video.numParticles);
 
+		readInt(xml_video, "TextureBudget", "mb", &video.textureBudget);
+
 		TiXmlElement *xml_screenMode = xml_video->FirstChildElement("ScreenMode");
 		if (xml_screenMode)
 		{
@@ -616,6 +634,7 @@ void UserSettings::apply()
 	core->sound->setMusicVolume(audio.musvol);
 	core->sound->setSfxVolume(audio.sfxvol);
 	core->sound->setVoiceVolume(audio.voxvol);
+	core->sound->setSampleCacheBudget((unsigned long)audio.sampleCacheKB * 1024);
 
 	core->flipMouseButtons = control.flipInputButtons;
 
@@ -631,6 +650,11 @@ void UserSettings::apply()
 
 	core->debugLogActive = system.debugLogOn;
 
+#ifndef BBGE_BUILD_PSP
+	if (video.textureBudget >= 0)
+		core->setTextureBudget((unsigned long)video.textureBudget*1024*1024);
+#endif
+
 	if (dsq->game)
 	{
 		dsq->game->bindInput();
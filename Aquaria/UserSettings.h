@@ -83,12 +83,13 @@ public:
 
 	struct Audio
 	{
-		Audio() { micOn = 0; octave=0; musvol=voxvol=sfxvol=1.0; subtitles=false; }
+		Audio() { micOn = 0; octave=0; musvol=voxvol=sfxvol=1.0; subtitles=false; sampleCacheKB=16384; }
 		int micOn;
 		int octave;
 		float voxvol, sfxvol, musvol;
 		int subtitles;
 		std::string deviceName;
+		int sampleCacheKB;
 	} audio;
 
 	struct Video
@@ -110,6 +111,7 @@ public:
 			vsync = 1;
 			darkbuffersize = 256;
 			displaylists = 0;
+			textureBudget = 256;
 		}
 		int shader;
 		int blur;
@@ -120,6 +122,7 @@ public:
 		int parallaxOn0, parallaxOn1, parallaxOn2;
 		int numParticles;
 		int displaylists;
+		int textureBudget;	// megabytes
 	} video;
 
 	struct Control
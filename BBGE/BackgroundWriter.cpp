@@ -0,0 +1,237 @@
+/*
+Copyright (C) 2007, 2010 - Bit-Blot
+
+This file is part of Aquaria.
+
+Aquaria is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+
+See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+*/
+#include "BackgroundWriter.h"
+#include "Core.h"
+
+#include <zlib.h>
+
+#ifdef BBGE_BUILD_SDL
+#include "SDL.h"
+#endif
+
+BackgroundWriter::BackgroundWriter()
+{
+#ifdef BBGE_BUILD_SDL
+	lock = 0;
+	cond = 0;
+	thread = 0;
+	quit = false;
+	working = false;
+#endif
+}
+
+BackgroundWriter::~BackgroundWriter()
+{
+	shutdown();
+}
+
+void BackgroundWriter::write(const std::string &file, const std::string &data, int level, int tag)
+{
+	Job job;
+	job.file = core->adjustFilenameCase(file);
+	job.data = data;
+	job.level = level;
+	job.tag = tag;
+
+#ifdef BBGE_BUILD_SDL
+	if (!thread)
+	{
+		lock = SDL_CreateMutex();
+		cond = SDL_CreateCond();
+		quit = false;
+		thread = SDL_CreateThread(writerThread, this);
+		if (!thread)
+		{
+			debugLog("Failed to create file writer thread");
+			SDL_DestroyCond(cond);
+			SDL_DestroyMutex(lock);
+			cond = 0;
+			lock = 0;
+		}
+	}
+	if (thread)
+	{
+		SDL_mutexP(lock);
+		jobs.push_back(job);
+		SDL_CondBroadcast(cond);
+		SDL_mutexV(lock);
+		return;
+	}
+#endif
+
+	Result result;
+	result.file = job.file;
+	result.tag = job.tag;
+	result.ok = doJob(job);
+	results.push_back(result);
+}
+
+bool BackgroundWriter::isBusy()
+{
+	bool busy;
+#ifdef BBGE_BUILD_SDL
+	if (thread)
+		SDL_mutexP(lock);
+	busy = !jobs.empty() || working || !results.empty();
+	if (thread)
+		SDL_mutexV(lock);
+#else
+	busy = !results.empty();
+#endif
+	return busy;
+}
+
+bool BackgroundWriter::getResult(Result &result)
+{
+	bool found = false;
+#ifdef BBGE_BUILD_SDL
+	if (thread)
+		SDL_mutexP(lock);
+#endif
+	if (!results.empty())
+	{
+		result = results.front();
+		results.pop_front();
+		found = true;
+	}
+#ifdef BBGE_BUILD_SDL
+	if (thread)
+		SDL_mutexV(lock);
+#endif
+	return found;
+}
+
+void BackgroundWriter::flush()
+{
+#ifdef BBGE_BUILD_SDL
+	if (!thread)
+		return;
+	SDL_mutexP(lock);
+	while (!jobs.empty() || working)
+		SDL_CondWait(cond, lock);
+	SDL_mutexV(lock);
+#endif
+}
+
+void BackgroundWriter::shutdown()
+{
+#ifdef BBGE_BUILD_SDL
+	if (!thread)
+		return;
+	// Let queued saves finish; losing one on exit would be worse than
+	// a short wait.
+	flush();
+	SDL_mutexP(lock);
+	quit = true;
+	SDL_CondBroadcast(cond);
+	SDL_mutexV(lock);
+	SDL_WaitThread(thread, NULL);
+	thread = 0;
+	SDL_DestroyCond(cond);
+	SDL_DestroyMutex(lock);
+	cond = 0;
+	lock = 0;
+#endif
+}
+
+// Compress (if requested) and write one file.  Runs on the writer thread,
+// so it must not touch anything but the job.
+bool BackgroundWriter::doJob(const Job &job)
+{
+	const char *data = job.data.data();
+	unsigned long size = job.data.size();
+	Bytef *packed = 0;
+	if (job.level >= 0)
+	{
+		uLongf packedSize = compressBound(size);
+		packed = new Bytef[packedSize];
+		if (compress2(packed, &packedSize, (const Bytef*)data, size, job.level) != Z_OK)
+		{
+			delete[] packed;
+			return false;
+		}
+		data = (const char*)packed;
+		size = packedSize;
+	}
+
+	const std::string tempFile = job.file + ".tmp";
+	bool ok = false;
+	FILE *f = fopen(tempFile.c_str(), "wb");
+	if (f)
+	{
+		ok = fwrite(data, 1, size, f) == size;
+		if (fclose(f) != 0)
+			ok = false;
+	}
+	delete[] packed;
+
+	if (ok)
+	{
+#ifdef BBGE_BUILD_WINDOWS
+		// rename() won't replace an existing file here.
+		remove(job.file.c_str());
+#endif
+		ok = rename(tempFile.c_str(), job.file.c_str()) == 0;
+	}
+	if (!ok)
+		remove(tempFile.c_str());
+	return ok;
+}
+
+#ifdef BBGE_BUILD_SDL
+
+int BackgroundWriter::writerThread(void *param)
+{
+	((BackgroundWriter*)param)->run();
+	return 0;
+}
+
+void BackgroundWriter::run()
+{
+	SDL_mutexP(lock);
+	while (true)
+	{
+		if (jobs.empty())
+		{
+			if (quit)
+				break;
+			SDL_CondWait(cond, lock);
+			continue;
+		}
+		Job job = jobs.front();
+		jobs.pop_front();
+		working = true;
+		SDL_mutexV(lock);
+
+		Result result;
+		result.file = job.file;
+		result.tag = job.tag;
+		result.ok = doJob(job);
+
+		SDL_mutexP(lock);
+		results.push_back(result);
+		working = false;
+		SDL_CondBroadcast(cond);
+	}
+	SDL_mutexV(lock);
+}
+
+#endif  // BBGE_BUILD_SDL
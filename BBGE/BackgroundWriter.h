@@ -0,0 +1,89 @@
+/*
+Copyright (C) 2007, 2010 - Bit-Blot
+
+This file is part of Aquaria.
+
+Aquaria is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+
+See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+*/
+#pragma once
+
+#include "Base.h"
+
+#include <deque>
+
+#ifdef BBGE_BUILD_SDL
+struct SDL_mutex;
+struct SDL_cond;
+struct SDL_Thread;
+#endif
+
+// Writes files on a background thread.  Each file is optionally
+// compressed (in the same format as packFile()), written under a
+// temporary name and then renamed over the old file, so a crash or a
+// full disk never leaves a half-written file behind.  Results are
+// collected on the main thread with getResult().
+//
+// On builds without thread support, write() does all the work
+// immediately.
+class BackgroundWriter
+{
+public:
+	struct Result
+	{
+		std::string file;
+		int tag;
+		bool ok;
+	};
+
+	BackgroundWriter();
+	~BackgroundWriter();
+
+	// Queue the data to be written to the given file.  If level is zero
+	// or more, the data is compressed with zlib at that level.  The tag
+	// is passed back in the result.
+	void write(const std::string &file, const std::string &data, int level=-1, int tag=0);
+
+	// True while any write is queued, running, or waiting to be reported.
+	bool isBusy();
+	// Fetch the result of the next finished write; false if none.
+	bool getResult(Result &result);
+	// Wait until every queued write has finished.
+	void flush();
+	void shutdown();
+
+private:
+	struct Job
+	{
+		std::string file, data;
+		int level, tag;
+	};
+
+	static bool doJob(const Job &job);
+
+#ifdef BBGE_BUILD_SDL
+	static int writerThread(void *param);
+	void run();
+
+	SDL_mutex *lock;
+	SDL_cond *cond;
+	SDL_Thread *thread;
+	bool quit;
+	bool working;
+#endif
+
+	std::deque<Job> jobs;
+	std::deque<Result> results;
+};
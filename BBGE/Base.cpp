@@ -30,6 +30,10 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 	#include <dirent.h>
 #endif
 
+#ifndef BBGE_BUILD_PSP
+	#include <sys/stat.h>
+#endif
+
 #if defined(BBGE_BUILD_MACOSX)
 	#include <Carbon/Carbon.h>
 #endif
@@ -507,6 +511,36 @@ char *readFile(std::string path, unsigned long *size_ret)
 	return buffer;
 }
 
+// Return the modification time of the given file (in seconds since the
+// epoch), or 0 if the file does not exist or the time cannot be
+// determined.  Callers use this to check whether a cached, preprocessed
+// copy of a data file is still up to date.
+unsigned long getFileModTime(const std::string &path)
+{
+#ifdef BBGE_BUILD_PSP
+	return 0;  // Data files never change on the PSP.
+#else
+	struct stat st;
+	if (stat(core->adjustFilenameCase(path).c_str(), &st) != 0)
+		return 0;
+	return (unsigned long)st.st_mtime;
+#endif
+}
+
+// Return the size of the given file in bytes, or 0 if the file does not
+// exist or the size cannot be determined.
+unsigned long getFileSize(const std::string &path)
+{
+#ifdef BBGE_BUILD_PSP
+	return 0;  // Data files never change on the PSP.
+#else
+	struct stat st;
+	if (stat(core->adjustFilenameCase(path).c_str(), &st) != 0)
+		return 0;
+	return (unsigned long)st.st_size;
+#endif
+}
+
 /*
 void pForEachFile(std::string path, std::string type, void callback(const std::string &filename, int param), int param)
 {
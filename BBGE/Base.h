@@ -219,6 +219,8 @@ void errorLog(const std::string &s);
 void debugLog(const std::string &s);
 void debugLog(const char *s);
 char *readFile(std::string path, unsigned long *size_ret = 0);
+unsigned long getFileModTime(const std::string &path);
+unsigned long getFileSize(const std::string &path);
 void forEachFile(std::string path, std::string type, void callback(const std::string &filename, intptr_t param), intptr_t param);
 std::string stripEndlineForUnix(const std::string &in);
 std::vector<std::string> getFileList(std::string path, std::string type, int param);
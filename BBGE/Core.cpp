@@ -24,6 +24,7 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 #include "Particles.h"
 
 #include <time.h>
+#include <algorithm>
 
 #ifdef BBGE_BUILD_UNIX
 #include <limits.h>
@@ -923,6 +924,14 @@ Core::Core(const std::string &filesystem, int numRenderLayers, const std::string
 	debugLogActive = true;
 
 	debugLogTextures = true;
+
+#ifdef BBGE_BUILD_PSP
+	textureBudget = 0;
+#else
+	textureBudget = 256*1024*1024;
+#endif
+	overTextureBudget = false;
+	frameNumber = 0;
 	
 	grabInputOnReentry = -1;
 
@@ -3129,6 +3138,8 @@ void Core::main(float runTime)
 		}
 
 		// UPDATE
+		InterpolatedVector::newFrame();
+
 		if (verbose) debugLog("post processing fx update");
 		postProcessingFx.update(dt);
 
@@ -4119,6 +4130,7 @@ void Core::showBuffer()
 #ifdef BBGE_BUILD_PSP
 	fakeglEndFrame();
 #endif
+	frameNumber++;
 }
 
 // WARNING: only for use during shutdown
@@ -4126,6 +4138,8 @@ void Core::showBuffer()
 // when destroy is called on them
 void Core::clearResources()
 {
+	flushUnusedTextures();
+
 	std::vector<Resource*> deletedResources;
 	int i;
 	for (i = 0; i < resources.size(); i++)
@@ -4366,6 +4380,8 @@ Texture *Core::doTextureAdd(const std::string &texture, const std::string &loadN
 
 	stringToLowerUserData(internalTextureName);
 	Texture *t = core->findTexture(internalTextureName);
+	if (!t && (t = reviveTexture(internalTextureName)) != 0)
+		addResource(t);
 	if (t)
 	{
 		t->addRef();
@@ -4396,9 +4412,157 @@ Texture *Core::doTextureAdd(const std::string &texture, const std::string &loadN
 		debugLog(os.str());
 	}
 
+	enforceTextureBudget();
+
 	return t;
 }
 
+void Core::setTextureBudget(unsigned long bytes)
+{
+	textureBudget = bytes;
+	if (textureBudget == 0)
+		flushUnusedTextures();
+	else
+		enforceTextureBudget();
+}
+
+unsigned long Core::getTextureMemoryUsage()
+{
+	unsigned long total = 0;
+	for (int i = 0; i < resources.size(); i++)
+		total += ((Texture*)resources[i])->getMemoryUsage();
+	for (std::list<Texture*>::iterator i = unusedTextures.begin(); i != unusedTextures.end(); i++)
+		total += (*i)->getMemoryUsage();
+	return total;
+}
+
+// Take charge of a texture which is no longer referenced.  Returns false
+// if the texture should just be destroyed.
+bool Core::retainTexture(Texture *t)
+{
+	if (textureBudget == 0 || isShuttingDown() || t->name.empty()
+		|| t->getMemoryUsage() == 0 || !findResource(t->name))
+	{
+		return false;
+	}
+	removeResource(t->name, NO_DESTROY);
+	unusedTextures.push_front(t);
+	enforceTextureBudget();
+	return true;
+}
+
+// Take an unused texture back into service, if it's still loaded and
+// its file hasn't changed since it was released.
+Texture *Core::reviveTexture(const std::string &name)
+{
+	for (std::list<Texture*>::iterator i = unusedTextures.begin(); i != unusedTextures.end(); i++)
+	{
+		if ((*i)->name == name)
+		{
+			Texture *t = *i;
+			unusedTextures.erase(i);
+			if (t->isFileChanged())
+			{
+				if (debugLogTextures)
+					debugLog("Dropping stale unused texture: " + t->name);
+				delete t;
+				return 0;
+			}
+			return t;
+		}
+	}
+	return 0;
+}
+
+// Free unused textures, least recently released first, until the total
+// is back within the budget.
+void Core::enforceTextureBudget()
+{
+	if (textureBudget == 0)
+		return;
+	unsigned long total = getTextureMemoryUsage();
+	while (total > textureBudget && !unusedTextures.empty())
+	{
+		Texture *t = unusedTextures.back();
+		unusedTextures.pop_back();
+		total -= t->getMemoryUsage();
+		if (debugLogTextures)
+			debugLog("Evicting unused texture: " + t->name);
+		delete t;
+	}
+
+	if (total > textureBudget && !overTextureBudget)
+	{
+		std::ostringstream os;
+		os << "Textures in use (" << total/1024 << "k) exceed the texture budget ("
+		   << textureBudget/1024 << "k)";
+		debugLog(os.str());
+	}
+	overTextureBudget = (total > textureBudget);
+}
+
+void Core::flushUnusedTextures()
+{
+	while (!unusedTextures.empty())
+	{
+		Texture *t = unusedTextures.back();
+		unusedTextures.pop_back();
+		delete t;
+	}
+}
+
+static bool textureUsageBySize(const Core::TextureUsage &a, const Core::TextureUsage &b)
+{
+	return a.bytes > b.bytes;
+}
+
+// List every loaded texture (in use or not), largest first.
+void Core::getTextureReport(std::vector<TextureUsage> &report)
+{
+	report.clear();
+	TextureUsage usage;
+	for (int i = 0; i < resources.size(); i++)
+	{
+		Texture *t = (Texture*)resources[i];
+		usage.name = t->name;
+		usage.bytes = t->getMemoryUsage();
+		usage.ref = t->getRef();
+		usage.lastUseFrame = t->lastUseFrame;
+		report.push_back(usage);
+	}
+	for (std::list<Texture*>::iterator i = unusedTextures.begin(); i != unusedTextures.end(); i++)
+	{
+		usage.name = (*i)->name;
+		usage.bytes = (*i)->getMemoryUsage();
+		usage.ref = 0;
+		usage.lastUseFrame = (*i)->lastUseFrame;
+		report.push_back(usage);
+	}
+	std::sort(report.begin(), report.end(), textureUsageBySize);
+}
+
+void Core::logTextureReport()
+{
+	std::vector<TextureUsage> report;
+	getTextureReport(report);
+
+	unsigned long total = 0;
+	for (int i = 0; i < report.size(); i++)
+		total += report[i].bytes;
+
+	std::ostringstream os;
+	os << "Texture memory: " << report.size() << " textures, " << total/1024
+	   << "k (budget " << textureBudget/1024 << "k, frame " << frameNumber << ")";
+	debugLog(os.str());
+	for (int i = 0; i < report.size(); i++)
+	{
+		std::ostringstream os;
+		os << "  " << report[i].bytes/1024 << "k ref " << report[i].ref
+		   << " frame " << report[i].lastUseFrame << ": " << report[i].name;
+		debugLog(os.str());
+	}
+}
+
 Texture* Core::addTexture(const std::string &textureName)
 {
 	if (textureName.empty()) return 0;
@@ -4470,6 +4634,8 @@ void Core::switchRenderObjectLayer(RenderObject *o, int toLayer)
 
 void Core::unloadResources()
 {
+	flushUnusedTextures();
+
 	for (int i = 0; i < resources.size(); i++)
 	{
 		resources[i]->unload();
@@ -4482,6 +4648,8 @@ void Core::onReloadResources()
 
 void Core::reloadResources()
 {
+	flushUnusedTextures();
+
 	for (int i = 0; i < resources.size(); i++)
 	{
 		resources[i]->reload();
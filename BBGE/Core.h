@@ -1044,6 +1044,27 @@ public:
 	Texture *addTexture(const std::string &texture);
 	void removeTexture(std::string texture);
 
+	// Textures whose last reference is removed stay loaded, most recently
+	// released last to go, until the total size of all loaded textures
+	// exceeds the budget.  A budget of zero frees them immediately.
+	struct TextureUsage
+	{
+		std::string name;
+		unsigned long bytes;
+		int ref;
+		unsigned int lastUseFrame;
+	};
+	void setTextureBudget(unsigned long bytes);
+	unsigned long getTextureBudget() const { return textureBudget; }
+	unsigned long getTextureMemoryUsage();
+	bool retainTexture(Texture *t);
+	void flushUnusedTextures();
+	void getTextureReport(std::vector<TextureUsage> &report);
+	void logTextureReport();
+
+	// Number of frames shown so far.
+	unsigned int getFrameNumber() const { return frameNumber; }
+
 	PostProcessingFX postProcessingFx;
 
 	enum RemoveRenderObjectFlag { DESTROY_RENDER_OBJECT=0, DO_NOT_DESTROY_RENDER_OBJECT };
@@ -1344,6 +1365,13 @@ protected:
 
 	virtual void onReloadResources();
 
+	void enforceTextureBudget();
+	Texture *reviveTexture(const std::string &name);
+	std::list<Texture*> unusedTextures;
+	unsigned long textureBudget;
+	bool overTextureBudget;
+	unsigned int frameNumber;
+
 	Texture* doTextureAdd(const std::string &texture, const std::string &name, std::string internalTextureName);
 	
 	void deleteRenderObjectMemory(RenderObject *r);
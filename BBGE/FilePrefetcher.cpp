@@ -0,0 +1,200 @@
+/*
+Copyright (C) 2007, 2010 - Bit-Blot
+
+This file is part of Aquaria.
+
+Aquaria is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+
+See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+*/
+#include "FilePrefetcher.h"
+
+#ifdef BBGE_BUILD_SDL
+#include "SDL.h"
+#endif
+
+// Files are read in chunks of this size so that a cancel takes effect
+// promptly even in the middle of a large file.
+const int PREFETCH_CHUNK = 64*1024;
+
+// Default limit on the amount of data read per prefetch() call.
+const unsigned long PREFETCH_DEFAULT_BUDGET = 48*1024*1024;
+
+FilePrefetcher::FilePrefetcher()
+{
+#ifdef BBGE_BUILD_SDL
+	lock = 0;
+	cond = 0;
+	idleCond = 0;
+	thread = 0;
+#endif
+	busy = false;
+	budget = PREFETCH_DEFAULT_BUDGET;
+	bytesRead = 0;
+	generation = workGeneration = 0;
+	quit = false;
+}
+
+FilePrefetcher::~FilePrefetcher()
+{
+	shutdown();
+}
+
+// Start reading the given files in the background, dropping anything
+// queued by a previous call.
+void FilePrefetcher::prefetch(const std::vector<std::string> &files)
+{
+#ifdef BBGE_BUILD_SDL
+	if (!thread)
+	{
+		lock = SDL_CreateMutex();
+		cond = SDL_CreateCond();
+		idleCond = SDL_CreateCond();
+		quit = false;
+		thread = SDL_CreateThread(prefetchThread, this);
+		if (!thread)
+		{
+			debugLog("Failed to create file prefetch thread");
+			SDL_DestroyCond(idleCond);
+			SDL_DestroyCond(cond);
+			SDL_DestroyMutex(lock);
+			idleCond = cond = 0;
+			lock = 0;
+			return;
+		}
+	}
+
+	SDL_mutexP(lock);
+	generation++;
+	queue.clear();
+	seen.clear();
+	bytesRead = 0;
+	for (int i = 0; i < files.size(); i++)
+	{
+		if (seen.insert(files[i]).second)
+			queue.push_back(files[i]);
+	}
+	SDL_CondSignal(cond);
+	SDL_mutexV(lock);
+#endif
+}
+
+// Drop all pending files and abandon the one being read, e.g. because
+// the game is about to load files itself.  On return the prefetch thread
+// is idle, so subclasses may safely change any state processFile() uses.
+void FilePrefetcher::cancel()
+{
+#ifdef BBGE_BUILD_SDL
+	if (!thread)
+		return;
+	SDL_mutexP(lock);
+	generation++;
+	queue.clear();
+	seen.clear();
+	while (busy)
+		SDL_CondWait(idleCond, lock);
+	SDL_mutexV(lock);
+#endif
+}
+
+void FilePrefetcher::shutdown()
+{
+#ifdef BBGE_BUILD_SDL
+	if (!thread)
+		return;
+	SDL_mutexP(lock);
+	quit = true;
+	generation++;
+	queue.clear();
+	SDL_CondSignal(cond);
+	SDL_mutexV(lock);
+	SDL_WaitThread(thread, NULL);
+	thread = 0;
+	SDL_DestroyCond(idleCond);
+	SDL_DestroyCond(cond);
+	SDL_DestroyMutex(lock);
+	idleCond = cond = 0;
+	lock = 0;
+#endif
+}
+
+// Add a file to the current request.  Only call this from processFile().
+void FilePrefetcher::enqueue(const std::string &file)
+{
+#ifdef BBGE_BUILD_SDL
+	SDL_mutexP(lock);
+	if (!isCancelled() && seen.insert(file).second)
+		queue.push_back(file);
+	SDL_mutexV(lock);
+#endif
+}
+
+// Read the file through once, returning the number of bytes read.
+unsigned long FilePrefetcher::warmFile(const std::string &file)
+{
+	FILE *f = fopen(file.c_str(), "rb");
+	if (!f)
+		return 0;
+
+	char buffer[PREFETCH_CHUNK];
+	unsigned long total = 0;
+	size_t got;
+	while (!isCancelled() && !quit && total < budget
+		   && (got = fread(buffer, 1, sizeof(buffer), f)) > 0)
+	{
+		total += got;
+	}
+	fclose(f);
+	return total;
+}
+
+void FilePrefetcher::processFile(const std::string &file)
+{
+	bytesRead += warmFile(file);
+}
+
+#ifdef BBGE_BUILD_SDL
+
+int FilePrefetcher::prefetchThread(void *param)
+{
+	((FilePrefetcher*)param)->run();
+	return 0;
+}
+
+void FilePrefetcher::run()
+{
+	SDL_mutexP(lock);
+	while (!quit)
+	{
+		if (queue.empty() || bytesRead >= budget)
+		{
+			SDL_CondWait(cond, lock);
+			continue;
+		}
+		const std::string file = queue.front();
+		queue.pop_front();
+		workGeneration = generation;
+		busy = true;
+		SDL_mutexV(lock);
+
+		processFile(file);
+
+		SDL_mutexP(lock);
+		busy = false;
+		SDL_CondBroadcast(idleCond);
+	}
+	SDL_mutexV(lock);
+}
+
+#endif  // BBGE_BUILD_SDL
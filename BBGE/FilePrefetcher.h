@@ -0,0 +1,87 @@
+/*
+Copyright (C) 2007, 2010 - Bit-Blot
+
+This file is part of Aquaria.
+
+Aquaria is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+
+See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+*/
+#pragma once
+
+#include "Base.h"
+
+#include <deque>
+#include <set>
+
+#ifdef BBGE_BUILD_SDL
+struct SDL_mutex;
+struct SDL_cond;
+struct SDL_Thread;
+#endif
+
+// Reads files on a background thread so that they are in the OS page
+// cache by the time the game asks for them.  Nothing is kept in memory;
+// a later load simply finds the data already cached.  Each call to
+// prefetch() replaces whatever was still pending, and reading stops once
+// the byte budget for the current request is used up.
+//
+// Subclasses can override processFile() to look inside files as they are
+// read and queue the files they refer to with enqueue().  processFile()
+// runs on the prefetch thread, so it must not touch game state, and
+// subclass destructors must call shutdown() themselves.
+//
+// On builds without thread support, prefetch() does nothing.
+class FilePrefetcher
+{
+public:
+	FilePrefetcher();
+	virtual ~FilePrefetcher();
+
+	void prefetch(const std::vector<std::string> &files);
+	void cancel();
+	void shutdown();
+
+	void setBudget(unsigned long bytes) { budget = bytes; }
+
+	// Bytes read for the current (or last) request.
+	unsigned long getBytesRead() const { return bytesRead; }
+
+protected:
+	virtual void processFile(const std::string &file);
+
+	void enqueue(const std::string &file);
+	unsigned long warmFile(const std::string &file);
+	bool isCancelled() const { return generation != workGeneration; }
+
+private:
+#ifdef BBGE_BUILD_SDL
+	static int prefetchThread(void *param);
+	void run();
+
+	SDL_mutex *lock;
+	SDL_cond *cond;
+	SDL_cond *idleCond;
+	SDL_Thread *thread;
+#endif
+
+	std::deque<std::string> queue;
+	std::set<std::string> seen;
+	unsigned long budget;
+	volatile unsigned long bytesRead;
+	volatile int generation;	// bumped by prefetch() and cancel()
+	volatile int workGeneration;	// generation of the file being read
+	bool busy;	// processFile() is running
+	volatile bool quit;
+};
@@ -29,6 +29,7 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 
 #ifdef BBGE_BUILD_UNIX
 #include <signal.h>
+#include <sys/time.h>
 #endif
 
 #include "Core.h"
@@ -41,6 +42,9 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 #include "ogg/ogg.h"
 #include "vorbis/vorbisfile.h"
 
+#include <list>
+#include <vector>
+
 #ifndef _DEBUG
 //#define _DEBUG 1
 #endif
@@ -62,11 +66,28 @@ public:
     // Start playing on the given channel, with optional looping.
     bool start(ALuint source, bool loop);
 
+    // Decode the entire stream into a newly malloc()ed buffer instead of
+    // playing it.  Fails if the decoded data would be larger than
+    // max_size bytes.  Must not be called on a decoder that was started.
+    bool decode_all(long max_size, char **pcm_ret, long *size_ret,
+                    ALenum *format_ret, int *freq_ret);
+
     // Decode audio into any free buffers.  Must be called periodically
     // on systems without threads; may be called without harm on systems
     // with threads (the function does nothing in that case).
     void update();
 
+    // Stop the shared decoding thread.  Call after all decoders have
+    // been stopped; the thread is restarted when next needed.
+    static void shutdownThread();
+
+    // Return true if the stream has ended (so the source stopping is not
+    // an underrun).
+    bool finished() const { return eof; }
+
+    // Fill in decoding statistics.
+    static void get_stats(FMOD_STREAM_STATS *stats);
+
     // Terminate playback.
     void stop();
 
@@ -79,8 +100,23 @@ public:
     static long mem_tell(void *datasource);
 
 private:
+    // Open the Vorbis stream and look up its format.
+    bool open();
+
     // Decoding loop, run in a separate thread (if threads are available).
-    static void decode_loop(OggDecoder *this_);
+    // A single thread services every playing decoder.
+    static int decode_loop(void *unused);
+
+    // Add this decoder to (or remove it from) the set serviced by the
+    // decoding thread, starting the thread if necessary.  add_to_thread()
+    // sets "threaded", and returns false if the thread could not be
+    // started.
+    bool add_to_thread();
+    void remove_from_thread();
+
+    // Unqueue all processed buffers and refill them with new data.
+    // Returns the number of buffers processed.
+    int refill();
 
     // Decode and queue PCM data for one buffer; does nothing if the end
     // of the stream has already been reached or an unrecoverable error
@@ -107,13 +143,26 @@ private:
     int freq;
 
 #ifdef BBGE_BUILD_SDL
-    SDL_Thread *thread;
+    static SDL_Thread *thread;
+    static SDL_mutex *thread_lock;  // Protects active_decoders
+    static SDL_cond *thread_cond;   // Signalled when a decoder is added
+    static std::vector<OggDecoder *> active_decoders;
+    static volatile bool stop_thread;
 #else
     #warning Threads not supported, music may cut out on area changes!
     // ... because the stream runs out of decoded data while the area is
     // still loading, so OpenAL aborts playback.
 #endif
-    volatile bool stop_thread;
+    bool threaded;  // True if serviced by the decoding thread
+
+    // Statistics.  The thread_* counters are only touched by the decoding
+    // thread while holding thread_lock; the others only by the main thread.
+    static double thread_decode_time, main_decode_time;
+    static int thread_underruns, main_underruns;
+    static int active_streams, peak_streams;
+    static long active_bytes, peak_bytes;  // PCM buffers held by streams
+
+    long stream_bytes;  // This stream's share of active_bytes
 
     bool playing;
     bool loop;
@@ -154,6 +203,42 @@ static const ov_callbacks ogg_memory_callbacks = {
     OggDecoder::mem_tell
 };
 
+double OggDecoder::thread_decode_time = 0;
+double OggDecoder::main_decode_time = 0;
+int OggDecoder::thread_underruns = 0;
+int OggDecoder::main_underruns = 0;
+int OggDecoder::active_streams = 0;
+int OggDecoder::peak_streams = 0;
+long OggDecoder::active_bytes = 0;
+long OggDecoder::peak_bytes = 0;
+
+// Return a timestamp in seconds for measuring decoding time.
+static double decode_timer()
+{
+#if defined(BBGE_BUILD_WINDOWS)
+    static LARGE_INTEGER freq;
+    if (!freq.QuadPart)
+        QueryPerformanceFrequency(&freq);
+    LARGE_INTEGER now;
+    QueryPerformanceCounter(&now);
+    return (double)now.QuadPart / (double)freq.QuadPart;
+#elif defined(BBGE_BUILD_UNIX)
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec + tv.tv_usec * 0.000001;
+#else
+    return 0;
+#endif
+}
+
+#ifdef BBGE_BUILD_SDL
+SDL_Thread *OggDecoder::thread = NULL;
+SDL_mutex *OggDecoder::thread_lock = NULL;
+SDL_cond *OggDecoder::thread_cond = NULL;
+std::vector<OggDecoder *> OggDecoder::active_decoders;
+volatile bool OggDecoder::stop_thread = false;
+#endif
+
 
 OggDecoder::OggDecoder(FILE *fp)
 {
@@ -166,14 +251,12 @@ OggDecoder::OggDecoder(FILE *fp)
     this->data = NULL;
     this->data_size = 0;
     this->data_pos = 0;
-#ifdef BBGE_BUILD_SDL
-    this->thread = NULL;
-#endif
-    this->stop_thread = true;
+    this->threaded = false;
     this->playing = false;
     this->loop = false;
     this->eof = false;
     this->samples_done = 0;
+    this->stream_bytes = 0;
 }
 
 OggDecoder::OggDecoder(const void *data, long data_size)
@@ -187,14 +270,12 @@ OggDecoder::OggDecoder(const void *data, long data_size)
     this->data = (const char *)data;
     this->data_size = data_size;
     this->data_pos = 0;
-#ifdef BBGE_BUILD_SDL
-    this->thread = NULL;
-#endif
-    this->stop_thread = true;
+    this->threaded = false;
     this->playing = false;
     this->loop = false;
     this->eof = false;
     this->samples_done = 0;
+    this->stream_bytes = 0;
 }
 
 OggDecoder::~OggDecoder()
@@ -209,11 +290,8 @@ OggDecoder::~OggDecoder()
     }
 }
 
-bool OggDecoder::start(ALuint source, bool loop)
+bool OggDecoder::open()
 {
-    this->source = source;
-    this->loop = loop;
-
     if (fp) {
         if (ov_open_callbacks(fp, &vf, NULL, 0, local_OV_CALLBACKS_NOCLOSE) != 0)
         {
@@ -251,6 +329,16 @@ bool OggDecoder::start(ALuint source, bool loop)
         return false;
     }
     freq = info->rate;
+    return true;
+}
+
+bool OggDecoder::start(ALuint source, bool loop)
+{
+    this->source = source;
+    this->loop = loop;
+
+    if (!open())
+        return false;
 
     /* NOTE: The failure to use alGetError() here and elsewhere is
      * intentional -- since alGetError() writes to a global buffer and
@@ -279,37 +367,91 @@ bool OggDecoder::start(ALuint source, bool loop)
     for (int i = 0; i < NUM_BUFFERS; i++)
         queue(buffers[i]);
 
-#ifdef BBGE_BUILD_SDL
-    stop_thread = false;
-    thread = SDL_CreateThread((int (*)(void *))decode_loop, this);
-    if (!thread)
+    active_streams++;
+    if (active_streams > peak_streams)
+        peak_streams = active_streams;
+
+    // The decode buffer plus every OpenAL buffer we keep queued.
+    const int channels = (format == AL_FORMAT_STEREO16 ? 2 : 1);
+    stream_bytes = sizeof(pcm_buffer) + (long)NUM_BUFFERS * BUFFER_LENGTH * channels * 2;
+    active_bytes += stream_bytes;
+    if (active_bytes > peak_bytes)
+        peak_bytes = active_bytes;
+
+    add_to_thread();
+
+    return true;
+}
+
+bool OggDecoder::decode_all(long max_size, char **pcm_ret, long *size_ret,
+                            ALenum *format_ret, int *freq_ret)
+{
+    if (!open())
+        return false;
+
+    const int channels = (format == AL_FORMAT_STEREO16 ? 2 : 1);
+    const ogg_int64_t samples = ov_pcm_total(&vf, -1);
+    if (samples <= 0 || samples * channels * 2 > max_size)
     {
-        debugLog("Failed to create Ogg Vorbis decode thread: "
-                 + std::string(SDL_GetError()));
+        ov_clear(&vf);
+        return false;
+    }
+
+    const double start_time = decode_timer();
+    const long size = (long)samples * channels * 2;
+    char *pcm = (char *)malloc(size);
+    if (!pcm)
+    {
+        ov_clear(&vf);
+        return false;
+    }
+
+    long pcm_size = 0;
+    while (pcm_size < size)
+    {
+        int bitstream_unused;
+        const int nread = ov_read(
+            &vf, pcm + pcm_size, size - pcm_size,
+            /*bigendianp*/ 0, /*word*/ 2, /*sgned*/ 1, &bitstream_unused
+        );
+        if (nread == 0 || nread == OV_EOF)
+            break;
+        else if (nread == OV_HOLE)
+            debugLog("Warning: decompression error, data dropped");
+        else if (nread < 0)
+        {
+            std::ostringstream os;
+            os << "Decompression error: " << nread;
+            debugLog(os.str());
+            free(pcm);
+            ov_clear(&vf);
+            return false;
+        }
+        else
+            pcm_size += nread;
+    }
+    ov_clear(&vf);
+    main_decode_time += decode_timer() - start_time;
+
+    if (pcm_size == 0)
+    {
+        free(pcm);
+        return false;
     }
-#endif
 
+    *pcm_ret = pcm;
+    *size_ret = pcm_size;
+    *format_ret = format;
+    *freq_ret = freq;
     return true;
 }
 
 void OggDecoder::update()
 {
-    if (!playing)
+    if (!playing || threaded)
         return;
-#ifdef BBGE_BUILD_SDL
-    if (thread)
-        return;
-#endif
 
-    int processed = 0;
-    alGetSourcei(source, AL_BUFFERS_PROCESSED, &processed);
-    for (int i = 0; i < processed; i++)
-    {
-        samples_done += BUFFER_LENGTH;
-        ALuint buffer;
-        alSourceUnqueueBuffers(source, 1, &buffer);
-        queue(buffer);
-    }
+    refill();
 }
 
 void OggDecoder::stop()
@@ -317,14 +459,15 @@ void OggDecoder::stop()
     if (!playing)
         return;
 
-#ifdef BBGE_BUILD_SDL
-    if (thread)
+    if (threaded)
     {
-        stop_thread = true;
-        SDL_WaitThread(thread, NULL);
-        thread = NULL;
+        remove_from_thread();
+        threaded = false;
     }
-#endif
+    playing = false;
+    active_streams--;
+    active_bytes -= stream_bytes;
+    stream_bytes = 0;
 
     ov_clear(&vf);
 
@@ -351,32 +494,207 @@ double OggDecoder::position()
     return (double)samples_played / (double)freq;
 }
 
-void OggDecoder::decode_loop(OggDecoder *this_)
+int OggDecoder::refill()
 {
-    while (!this_->stop_thread)
+    int processed = 0;
+    alGetSourcei(source, AL_BUFFERS_PROCESSED, &processed);
+    for (int i = 0; i < processed; i++)
+    {
+        samples_done += BUFFER_LENGTH;
+        ALuint buffer = 0;
+        alSourceUnqueueBuffers(source, 1, &buffer);
+        if (buffer)
+            queue(buffer);
+    }
+
+    // If we fell behind (e.g. the system was too busy to run us) the
+    // source will have stopped after playing out its last buffer, so
+    // restart it now that it has data again.
+    if (processed > 0 && !eof)
     {
+        ALint state = 0;
+        alGetSourcei(source, AL_SOURCE_STATE, &state);
+        if (state == AL_STOPPED)
+        {
+            alSourcePlay(source);
+            if (threaded)
+                thread_underruns++;
+            else
+                main_underruns++;
+        }
+    }
+
+    return processed;
+}
+
 #ifdef BBGE_BUILD_SDL
-        SDL_Delay(1);
-#endif
 
+bool OggDecoder::add_to_thread()
+{
+    if (!thread)
+    {
+        thread_lock = SDL_CreateMutex();
+        thread_cond = SDL_CreateCond();
+        stop_thread = false;
+        if (thread_lock && thread_cond)
+            thread = SDL_CreateThread(decode_loop, NULL);
+        if (!thread)
+        {
+            debugLog("Failed to create Ogg Vorbis decode thread: "
+                     + std::string(SDL_GetError()));
+            if (thread_cond)
+                SDL_DestroyCond(thread_cond);
+            if (thread_lock)
+                SDL_DestroyMutex(thread_lock);
+            thread_cond = NULL;
+            thread_lock = NULL;
+            return false;
+        }
+    }
+
+    SDL_mutexP(thread_lock);
+    threaded = true;
+    active_decoders.push_back(this);
+    SDL_CondSignal(thread_cond);
+    SDL_mutexV(thread_lock);
+    return true;
+}
+
+void OggDecoder::remove_from_thread()
+{
+    // The thread only touches decoders while holding the lock, so once
+    // we've removed ourselves it will never see this decoder again.
+    SDL_mutexP(thread_lock);
+    for (size_t i = 0; i < active_decoders.size(); i++)
+    {
+        if (active_decoders[i] == this)
+        {
+            active_decoders.erase(active_decoders.begin() + i);
+            break;
+        }
+    }
+    SDL_mutexV(thread_lock);
+}
+
+void OggDecoder::shutdownThread()
+{
+    if (!thread)
+        return;
+
+    SDL_mutexP(thread_lock);
+    stop_thread = true;
+    SDL_CondSignal(thread_cond);
+    SDL_mutexV(thread_lock);
+    SDL_WaitThread(thread, NULL);
+    thread = NULL;
+
+    SDL_DestroyCond(thread_cond);
+    SDL_DestroyMutex(thread_lock);
+    thread_cond = NULL;
+    thread_lock = NULL;
+    active_decoders.clear();
+}
+
+void OggDecoder::get_stats(FMOD_STREAM_STATS *stats)
+{
+    stats->activeStreams = active_streams;
+    stats->peakStreams = peak_streams;
+    stats->streamBytes = active_bytes;
+    stats->peakStreamBytes = peak_bytes;
+    stats->decodeThreads = 0;
+    stats->underruns = main_underruns;
+    stats->decodeSeconds = main_decode_time;
+    if (thread)
+    {
+        SDL_mutexP(thread_lock);
+        stats->decodeThreads = 1;
+        stats->underruns += thread_underruns;
+        stats->decodeSeconds += thread_decode_time;
+        SDL_mutexV(thread_lock);
+    }
+    else
+    {
+        stats->underruns += thread_underruns;
+        stats->decodeSeconds += thread_decode_time;
+    }
+}
+
+int OggDecoder::decode_loop(void *unused)
+{
+    SDL_mutexP(thread_lock);
+    while (!stop_thread)
+    {
+        if (active_decoders.empty())
+        {
+            SDL_CondWait(thread_cond, thread_lock);
+            continue;
+        }
+
+        // Refill whatever OpenAL has finished with, and sleep for a
+        // fraction of the shortest buffer's playing time before checking
+        // again.  With NUM_BUFFERS queued, a stream can go several
+        // hundred milliseconds without attention before it runs dry, so
+        // this is plenty even while the main thread is busy loading.
         int processed = 0;
-        alGetSourcei(this_->source, AL_BUFFERS_PROCESSED, &processed);
-        for (int i = 0; i < processed; i++)
+        Uint32 delay = 50;
+        for (size_t i = 0; i < active_decoders.size(); i++)
+        {
+            OggDecoder *decoder = active_decoders[i];
+            processed += decoder->refill();
+            const Uint32 buffer_ms = (Uint32)BUFFER_LENGTH * 1000 / decoder->freq;
+            if (buffer_ms / 4 < delay)
+                delay = buffer_ms / 4;
+        }
+
+        if (processed)
         {
-            this_->samples_done += BUFFER_LENGTH;
-            ALuint buffer = 0;
-            alSourceUnqueueBuffers(this_->source, 1, &buffer);
-            if (buffer)
-                this_->queue(buffer);
+            // Let the main thread in before the next pass.
+            SDL_mutexV(thread_lock);
+            SDL_mutexP(thread_lock);
+        }
+        else
+        {
+            SDL_CondWaitTimeout(thread_cond, thread_lock, delay ? delay : 1);
         }
     }
+    SDL_mutexV(thread_lock);
+    return 0;
 }
 
+#else  // !BBGE_BUILD_SDL
+
+bool OggDecoder::add_to_thread()
+{
+    return false;
+}
+
+void OggDecoder::remove_from_thread()
+{
+}
+
+void OggDecoder::shutdownThread()
+{
+}
+
+void OggDecoder::get_stats(FMOD_STREAM_STATS *stats)
+{
+    stats->activeStreams = active_streams;
+    stats->peakStreams = peak_streams;
+    stats->streamBytes = active_bytes;
+    stats->peakStreamBytes = peak_bytes;
+    stats->decodeThreads = 0;
+    stats->underruns = main_underruns;
+    stats->decodeSeconds = main_decode_time;
+}
+
+#endif  // BBGE_BUILD_SDL
+
 void OggDecoder::queue(ALuint buffer)
 {
     if (!playing || eof)
         return;
 
+    const double start_time = decode_timer();
     const int channels = (format == AL_FORMAT_STEREO16 ? 2 : 1);
     const int buffer_size = BUFFER_LENGTH * channels * 2;
     int pcm_size = 0;
@@ -425,6 +743,11 @@ void OggDecoder::queue(ALuint buffer)
         alBufferData(buffer, format, pcm_buffer, pcm_size, freq);
         alSourceQueueBuffers(source, 1, &buffer);
     }
+
+    if (threaded)
+        thread_decode_time += decode_timer() - start_time;
+    else
+        main_decode_time += decode_timer() - start_time;
 }
 
 size_t OggDecoder::mem_read(void *ptr, size_t size, size_t nmemb, void *datasource)
@@ -526,19 +849,76 @@ public:
     void reference() { refcount++; }
 
 private:
+    friend class OpenALSampleCache;
+
     FILE * const fp;
     void * const data;  // Only used if fp==NULL
     const long size;    // Only used if fp==NULL
     const bool looping;
     int refcount;
+
+    // Decoded sample cache state; see OpenALSampleCache.
+    ALuint pcm_buffer;     // 0 if not in the cache
+    long pcm_size;
+    int pcm_users;         // Number of channels playing from pcm_buffer
+    bool pcm_uncacheable;  // Too long (or broken) to decode in one go
+    std::list<OpenALSound *>::iterator pcm_lru_pos;
 };
 
+// Cache of fully decoded sound effects.  Short memory-backed sounds are
+// decoded once into an OpenAL buffer which every channel playing the
+// sound shares, instead of running a Vorbis decoder for each play.
+// When the byte budget is exceeded, the least recently played sounds
+// are dropped (except those still playing); anything too long to cache
+// is streamed as before.  Only used from the main thread.
+class OpenALSampleCache
+{
+public:
+    OpenALSampleCache();
+
+    // Return the cached buffer for the sound, decoding it if necessary,
+    // or 0 if the sound should be streamed.  Every successful call must
+    // be matched by a call to release() once the channel is done.
+    ALuint acquire(OpenALSound *sound);
+    void release(OpenALSound *sound);
+
+    // Drop the sound from the cache (called when the sound is destroyed).
+    void remove(OpenALSound *sound);
+
+    // Drop all cached data.  Channels must not be playing cached sounds.
+    void clear();
+
+    void setBudget(unsigned long bytes);
+    void getStats(FMOD_SAMPLECACHE_STATS *stats) const;
+
+private:
+    // Evict unused sounds until "bytes" more will fit in the budget.
+    bool makeRoom(unsigned long bytes);
+    void drop(OpenALSound *sound);
+
+    std::list<OpenALSound *> lru;  // Most recently used first
+    unsigned long budget;
+    unsigned long used, peak;
+    int hits, misses, evictions;
+};
+
+// Sounds whose decoded data would be larger than this are always streamed
+// (about 6 seconds of 44.1kHz stereo).
+static const long SAMPLE_CACHE_MAX_SOUND = 1024*1024;
+static const unsigned long SAMPLE_CACHE_DEFAULT_BUDGET = 16*1024*1024;
+
+static OpenALSampleCache sample_cache;
+
 OpenALSound::OpenALSound(FILE *_fp, const bool _looping)
     : fp(_fp)
     , data(NULL)
     , size(0)
     , looping(_looping)
     , refcount(1)
+    , pcm_buffer(0)
+    , pcm_size(0)
+    , pcm_users(0)
+    , pcm_uncacheable(true)
 {
 }
 
@@ -548,6 +928,10 @@ OpenALSound::OpenALSound(void *_data, long _size, const bool _looping)
     , size(_size)
     , looping(_looping)
     , refcount(1)
+    , pcm_buffer(0)
+    , pcm_size(0)
+    , pcm_users(0)
+    , pcm_uncacheable(false)
 {
 }
 
@@ -557,6 +941,7 @@ FMOD_RESULT OpenALSound::release()
     refcount--;
     if (refcount <= 0)
     {
+	sample_cache.remove(this);
 	if (fp)
 	    fclose(fp);
 	else
@@ -567,6 +952,138 @@ FMOD_RESULT OpenALSound::release()
 }
 
 
+// Decoded sample cache implementation ...
+
+OpenALSampleCache::OpenALSampleCache()
+    : budget(SAMPLE_CACHE_DEFAULT_BUDGET)
+    , used(0)
+    , peak(0)
+    , hits(0)
+    , misses(0)
+    , evictions(0)
+{
+}
+
+ALuint OpenALSampleCache::acquire(OpenALSound *sound)
+{
+    if (sound->pcm_buffer)
+    {
+        hits++;
+        lru.splice(lru.begin(), lru, sound->pcm_lru_pos);
+        sound->pcm_users++;
+        return sound->pcm_buffer;
+    }
+    if (sound->pcm_uncacheable)
+        return 0;
+
+    OggDecoder decoder(sound->getData(), sound->getSize());
+    char *pcm;
+    long pcm_size;
+    ALenum format;
+    int freq;
+    if (!decoder.decode_all(SAMPLE_CACHE_MAX_SOUND, &pcm, &pcm_size, &format, &freq))
+    {
+        sound->pcm_uncacheable = true;
+        return 0;
+    }
+    if ((unsigned long)pcm_size > budget || !makeRoom(pcm_size))
+    {
+        // Try again next time; something may have stopped playing.
+        free(pcm);
+        return 0;
+    }
+
+    // As in OggDecoder::start(), we detect failure by the return
+    // parameter rather than alGetError().
+    ALuint buffer = 0;
+    alGenBuffers(1, &buffer);
+    if (!buffer)
+    {
+        free(pcm);
+        return 0;
+    }
+    alBufferData(buffer, format, pcm, pcm_size, freq);
+    free(pcm);
+
+    misses++;
+    sound->pcm_buffer = buffer;
+    sound->pcm_size = pcm_size;
+    sound->pcm_users = 1;
+    sound->pcm_lru_pos = lru.insert(lru.begin(), sound);
+    used += pcm_size;
+    if (used > peak)
+        peak = used;
+    return buffer;
+}
+
+void OpenALSampleCache::release(OpenALSound *sound)
+{
+    assert(sound->pcm_users > 0);
+    sound->pcm_users--;
+    if (used > budget && sound->pcm_users == 0)
+        makeRoom(0);
+}
+
+void OpenALSampleCache::remove(OpenALSound *sound)
+{
+    if (sound->pcm_buffer)
+    {
+        assert(sound->pcm_users == 0);
+        drop(sound);
+    }
+}
+
+void OpenALSampleCache::clear()
+{
+    while (!lru.empty())
+        drop(lru.back());
+}
+
+void OpenALSampleCache::setBudget(unsigned long bytes)
+{
+    budget = bytes;
+    makeRoom(0);
+}
+
+void OpenALSampleCache::getStats(FMOD_SAMPLECACHE_STATS *stats) const
+{
+    stats->budget = budget;
+    stats->bytesUsed = used;
+    stats->bytesPeak = peak;
+    stats->numSounds = (int) lru.size();
+    stats->hits = hits;
+    stats->misses = misses;
+    stats->evictions = evictions;
+}
+
+bool OpenALSampleCache::makeRoom(unsigned long bytes)
+{
+    std::list<OpenALSound *>::iterator i = lru.end();
+    while (used + bytes > budget && i != lru.begin())
+    {
+        --i;
+        OpenALSound *sound = *i;
+        if (sound->pcm_users == 0)
+        {
+            ++i;  // drop() invalidates the iterator pointing at the sound.
+            drop(sound);
+            evictions++;
+        }
+    }
+    return used + bytes <= budget;
+}
+
+void OpenALSampleCache::drop(OpenALSound *sound)
+{
+    alDeleteBuffers(1, &sound->pcm_buffer);
+    used -= sound->pcm_size;
+    lru.erase(sound->pcm_lru_pos);
+    sound->pcm_buffer = 0;
+    sound->pcm_size = 0;
+    sound->pcm_users = 0;
+}
+
+
 class OpenALChannelGroup;
 
 class OpenALChannel
@@ -601,6 +1118,7 @@ private:
     OpenALChannelGroup *group;
     OpenALSound *sound;
     OggDecoder *decoder;
+    OpenALSound *cached;  // Sound whose cached buffer is attached, if any
     bool inuse;
     bool initial;
 };
@@ -641,6 +1159,7 @@ OpenALChannel::OpenALChannel()
     , group(NULL)
     , sound(NULL)
     , decoder(NULL)
+    , cached(NULL)
     , inuse(false)
     , initial(true)
 {
@@ -668,7 +1187,27 @@ void OpenALChannel::setGroupVolume(const float _volume)
 bool OpenALChannel::start(OpenALSound *sound)
 {
     if (decoder)
+    {
 	delete decoder;
+	decoder = NULL;
+    }
+    if (cached)
+    {
+	alSourcei(sid, AL_LOOPING, AL_FALSE);
+	sample_cache.release(cached);
+	cached = NULL;
+    }
+
+    const ALuint buffer = sample_cache.acquire(sound);
+    if (buffer)
+    {
+	alSourcei(sid, AL_BUFFER, buffer);
+	alSourcei(sid, AL_LOOPING, sound->isLooping() ? AL_TRUE : AL_FALSE);
+	SANITY_CHECK_OPENAL_CALL();
+	cached = sound;
+	return true;
+    }
+
     if (sound->getFile())
 	decoder = new OggDecoder(sound->getFile());
     else
@@ -691,7 +1230,9 @@ void OpenALChannel::update()
         ALint state = 0;
         alGetSourceiv(sid, AL_SOURCE_STATE, &state);
         SANITY_CHECK_OPENAL_CALL();
-        if (state == AL_STOPPED)
+        // A stream that stopped early has run dry; the decoder will
+        // restart it once it has refilled the buffers.
+        if (state == AL_STOPPED && !(decoder && !decoder->finished()))
             stop();
     }
 }
@@ -959,6 +1500,13 @@ FMOD_RESULT OpenALChannel::stop()
     SANITY_CHECK_OPENAL_CALL();
     alSourcei(sid, AL_BUFFER, 0);
     SANITY_CHECK_OPENAL_CALL();
+    if (cached)
+    {
+        alSourcei(sid, AL_LOOPING, AL_FALSE);
+        SANITY_CHECK_OPENAL_CALL();
+        sample_cache.release(cached);
+        cached = NULL;
+    }
     if (sound)
     {
         sound->release();
@@ -984,6 +1532,7 @@ public:
     FMOD_RESULT release();
     FMOD_RESULT getVersion(unsigned int *version);
     FMOD_RESULT setSpeakerMode(const FMOD_SPEAKERMODE speakermode);
+    FMOD_RESULT setOutput(const FMOD_OUTPUTTYPE output);
     FMOD_RESULT setFileSystem(FMOD_FILE_OPENCALLBACK useropen, FMOD_FILE_CLOSECALLBACK userclose, FMOD_FILE_READCALLBACK userread, FMOD_FILE_SEEKCALLBACK userseek, const int blockalign);
     FMOD_RESULT setDSPBufferSize(const unsigned int bufferlength, const int numbuffers);
     FMOD_RESULT createChannelGroup(const char *name, ChannelGroup **channelgroup);
@@ -995,18 +1544,45 @@ public:
     FMOD_RESULT playSound(FMOD_CHANNELINDEX channelid, Sound *sound, bool paused, Channel **channel);
 
     FMOD_RESULT getNumChannels(int *maxchannels_ret);
+    FMOD_RESULT setSampleCacheBudget(unsigned long bytes);
+    FMOD_RESULT getSampleCacheStats(FMOD_SAMPLECACHE_STATS *stats);
+    FMOD_RESULT getStreamStats(FMOD_STREAM_STATS *stats);
 
 private:
     OpenALChannelGroup *master_channel_group;
     int num_channels;
     OpenALChannel *channels;
+
+    // FMOD_OUTPUTTYPE_NOSOUND support: we mix into memory through the
+    // ALC_SOFT_loopback extension, rendering as much audio in each
+    // update() as real time has passed, so streams are consumed (and
+    // can underrun) just as they would be with a sound card.
+    FMOD_OUTPUTTYPE output;
+    typedef void (ALC_APIENTRY *RenderSamplesFunc)(ALCdevice *, ALCvoid *, ALCsizei);
+    RenderSamplesFunc render_samples;
+    double last_render_time;
+    ALCdevice *openLoopbackDevice(ALCint *attributes);
+    void renderLoopback();
 };
 
+// ALC_SOFT_loopback constants (from OpenAL Soft's alext.h, which we don't
+// ship).
+static const ALCenum BBGE_ALC_FORMAT_CHANNELS_SOFT = 0x1990;
+static const ALCenum BBGE_ALC_FORMAT_TYPE_SOFT = 0x1991;
+static const ALCenum BBGE_ALC_STEREO_SOFT = 0x1501;
+static const ALCenum BBGE_ALC_SHORT_SOFT = 0x1402;
+static const int LOOPBACK_FREQUENCY = 44100;
+static const int LOOPBACK_CHUNK = 1024;      // Samples rendered per call
+static const double LOOPBACK_MAX_STEP = 0.25;  // Seconds rendered per update at most
+
 
 OpenALSystem::OpenALSystem()
     : master_channel_group(NULL)
     , num_channels(0)
     , channels(NULL)
+    , output(FMOD_OUTPUTTYPE_AUTODETECT)
+    , render_samples(NULL)
+    , last_render_time(0)
 {
 }
 
@@ -1132,19 +1708,24 @@ FMOD_RESULT OpenALSystem::getVersion(unsigned int *version)
 ALBRIDGE(System,init,(int maxchannels, FMOD_INITFLAGS flags, void *extradriverdata),(maxchannels,flags,extradriverdata))
 FMOD_RESULT OpenALSystem::init(int maxchannels, const FMOD_INITFLAGS flags, const void *extradriverdata)
 {
-    ALCdevice *dev = alcOpenDevice(NULL);
-    if (!dev)
-        return FMOD_ERR_INTERNAL;
-
     // OpenAL doesn't provide a way to request sources that can be either
     // mono or stereo, so we need to request both separately (thus allocating
     // twice the theoretical requirement -- oh well).  --achurch
-    ALCint requested_attributes[5];
+    ALCint requested_attributes[11];
     requested_attributes[0] = ALC_MONO_SOURCES;
     requested_attributes[1] = maxchannels;
     requested_attributes[2] = ALC_STEREO_SOURCES;
     requested_attributes[3] = maxchannels;
     requested_attributes[4] = 0;
+
+    ALCdevice *dev;
+    if (output == FMOD_OUTPUTTYPE_NOSOUND)
+        dev = openLoopbackDevice(&requested_attributes[4]);
+    else
+        dev = alcOpenDevice(NULL);
+    if (!dev)
+        return FMOD_ERR_INTERNAL;
+
     ALCcontext *ctx = alcCreateContext(dev, requested_attributes);
     if (!ctx)
     {
@@ -1243,6 +1824,27 @@ FMOD_RESULT OpenALSystem::getNumChannels(int *maxchannels_ret)
     return FMOD_OK;
 }
 
+ALBRIDGE(System,setSampleCacheBudget,(unsigned long bytes),(bytes))
+FMOD_RESULT OpenALSystem::setSampleCacheBudget(unsigned long bytes)
+{
+    sample_cache.setBudget(bytes);
+    return FMOD_OK;
+}
+
+ALBRIDGE(System,getSampleCacheStats,(FMOD_SAMPLECACHE_STATS *stats),(stats))
+FMOD_RESULT OpenALSystem::getSampleCacheStats(FMOD_SAMPLECACHE_STATS *stats)
+{
+    sample_cache.getStats(stats);
+    return FMOD_OK;
+}
+
+ALBRIDGE(System,getStreamStats,(FMOD_STREAM_STATS *stats),(stats))
+FMOD_RESULT OpenALSystem::getStreamStats(FMOD_STREAM_STATS *stats)
+{
+    OggDecoder::get_stats(stats);
+    return FMOD_OK;
+}
+
 ALBRIDGE(System,playSound,(FMOD_CHANNELINDEX channelid, Sound *sound, bool paused, Channel **channel),(channelid,sound,paused,channel))
 FMOD_RESULT OpenALSystem::playSound(FMOD_CHANNELINDEX channelid, Sound *_sound, bool paused, Channel **channel)
 {
@@ -1291,6 +1893,8 @@ FMOD_RESULT OpenALSystem::release()
     {
         for (int i = 0; i < num_channels; i++)
         {
+            if (channels[i].isInUse())
+                channels[i].stop();
             const ALuint sid = channels[i].getSourceName();
             channels[i].setSourceName(0);
             channels[i].setSound(NULL);
@@ -1298,12 +1902,14 @@ FMOD_RESULT OpenALSystem::release()
             alSourcei(sid, AL_BUFFER, 0);
             alDeleteSources(1, &sid);
         }
+        sample_cache.clear();
         ALCdevice *dev = alcGetContextsDevice(ctx);
         alcMakeContextCurrent(NULL);
         alcSuspendContext(ctx);
         alcDestroyContext(ctx);
         alcCloseDevice(dev);
     }
+    OggDecoder::shutdownThread();
     delete this;
     return FMOD_OK;
 }
@@ -1322,6 +1928,82 @@ FMOD_RESULT OpenALSystem::setFileSystem(FMOD_FILE_OPENCALLBACK useropen, FMOD_FI
     return FMOD_OK;
 }
 
+ALBRIDGE(System,setOutput,(FMOD_OUTPUTTYPE output),(output))
+FMOD_RESULT OpenALSystem::setOutput(const FMOD_OUTPUTTYPE _output)
+{
+    output = _output;  // Takes effect in init().
+    return FMOD_OK;
+}
+
+// Open a loopback device, appending the attributes it needs for context
+// creation (terminated by 0) to "attributes", which must have room for 7
+// values.
+ALCdevice *OpenALSystem::openLoopbackDevice(ALCint *attributes)
+{
+    typedef ALCdevice *(ALC_APIENTRY *LoopbackOpenDeviceFunc)(const ALCchar *);
+    typedef ALCboolean (ALC_APIENTRY *IsRenderFormatSupportedFunc)(ALCdevice *, ALCsizei, ALCenum, ALCenum);
+
+    if (!alcIsExtensionPresent(NULL, "ALC_SOFT_loopback"))
+    {
+        debugLog("No ALC_SOFT_loopback support, can't run without a sound device");
+        return NULL;
+    }
+    LoopbackOpenDeviceFunc open_device = (LoopbackOpenDeviceFunc)
+        alcGetProcAddress(NULL, "alcLoopbackOpenDeviceSOFT");
+    IsRenderFormatSupportedFunc format_supported = (IsRenderFormatSupportedFunc)
+        alcGetProcAddress(NULL, "alcIsRenderFormatSupportedSOFT");
+    render_samples = (RenderSamplesFunc)
+        alcGetProcAddress(NULL, "alcRenderSamplesSOFT");
+    if (!open_device || !format_supported || !render_samples)
+    {
+        debugLog("Failed to look up ALC_SOFT_loopback functions");
+        render_samples = NULL;
+        return NULL;
+    }
+
+    ALCdevice *dev = (*open_device)(NULL);
+    if (!dev || !(*format_supported)(dev, LOOPBACK_FREQUENCY, BBGE_ALC_STEREO_SOFT, BBGE_ALC_SHORT_SOFT))
+    {
+        debugLog("Failed to open loopback device");
+        if (dev)
+            alcCloseDevice(dev);
+        render_samples = NULL;
+        return NULL;
+    }
+
+    attributes[0] = BBGE_ALC_FORMAT_CHANNELS_SOFT;
+    attributes[1] = BBGE_ALC_STEREO_SOFT;
+    attributes[2] = BBGE_ALC_FORMAT_TYPE_SOFT;
+    attributes[3] = BBGE_ALC_SHORT_SOFT;
+    attributes[4] = ALC_FREQUENCY;
+    attributes[5] = LOOPBACK_FREQUENCY;
+    attributes[6] = 0;
+    last_render_time = decode_timer();
+    return dev;
+}
+
+void OpenALSystem::renderLoopback()
+{
+    static short buffer[LOOPBACK_CHUNK * 2];
+
+    const double now = decode_timer();
+    double elapsed = now - last_render_time;
+    if (elapsed > LOOPBACK_MAX_STEP)
+        elapsed = LOOPBACK_MAX_STEP;
+    int samples = (int)(elapsed * LOOPBACK_FREQUENCY);
+    last_render_time += (double)samples / LOOPBACK_FREQUENCY;
+    if (last_render_time < now - LOOPBACK_MAX_STEP)
+        last_render_time = now - LOOPBACK_MAX_STEP;
+
+    ALCdevice *dev = alcGetContextsDevice(alcGetCurrentContext());
+    while (samples > 0)
+    {
+        const int count = samples < LOOPBACK_CHUNK ? samples : LOOPBACK_CHUNK;
+        (*render_samples)(dev, buffer, count);
+        samples -= count;
+    }
+}
+
 ALBRIDGE(System,setSpeakerMode,(FMOD_SPEAKERMODE speakermode),(speakermode))
 FMOD_RESULT OpenALSystem::setSpeakerMode(const FMOD_SPEAKERMODE speakermode)
 {
@@ -1332,6 +2014,8 @@ ALBRIDGE(System,update,(),())
 FMOD_RESULT OpenALSystem::update()
 {
     alcProcessContext(alcGetCurrentContext());
+    if (render_samples)
+        renderLoopback();
     for (int i = 0; i < num_channels; i++)
         channels[i].update();
 #if _DEBUG
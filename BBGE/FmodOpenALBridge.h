@@ -49,6 +49,12 @@ typedef enum
     FMOD_SPEAKERMODE_STEREO,
 } FMOD_SPEAKERMODE;
 
+typedef enum
+{
+    FMOD_OUTPUTTYPE_AUTODETECT,
+    FMOD_OUTPUTTYPE_NOSOUND,  // Mix into memory and discard (needs ALC_SOFT_loopback)
+} FMOD_OUTPUTTYPE;
+
 typedef enum
 {
     FMOD_TIMEUNIT_MS,
@@ -103,6 +109,30 @@ typedef enum
     FMOD_DSP_REVERB_MODE,
 } FMOD_DSP_REVERB_PARAMS;  // we don't use this, but we should!
 
+// BBGE-specific: statistics for the decoded sample cache.
+typedef struct
+{
+    unsigned long budget;     // Maximum bytes of decoded data
+    unsigned long bytesUsed;
+    unsigned long bytesPeak;
+    int numSounds;            // Sounds currently cached
+    int hits;                 // Plays served from the cache
+    int misses;               // Sounds decoded into the cache
+    int evictions;
+} FMOD_SAMPLECACHE_STATS;
+
+// BBGE-specific: statistics for streamed playback.
+typedef struct
+{
+    int decodeThreads;      // Decoding threads currently running
+    int activeStreams;
+    int peakStreams;
+    long streamBytes;       // Decode and OpenAL buffers held by streams
+    long peakStreamBytes;
+    int underruns;          // Times a stream ran dry and had to be restarted
+    double decodeSeconds;   // Wall-clock time spent decoding, all threads
+} FMOD_STREAM_STATS;
+
 
 namespace FMOD
 {
@@ -161,12 +191,16 @@ namespace FMOD
         FMOD_RESULT init(int maxchannels, FMOD_INITFLAGS flags, void *extradriverdata);
         FMOD_RESULT playSound(FMOD_CHANNELINDEX channelid, Sound *sound, bool paused, Channel **channel);
         FMOD_RESULT setDSPBufferSize(unsigned int bufferlength, int numbuffers);
+        FMOD_RESULT setOutput(FMOD_OUTPUTTYPE output);
         FMOD_RESULT setFileSystem(FMOD_FILE_OPENCALLBACK useropen, FMOD_FILE_CLOSECALLBACK userclose, FMOD_FILE_READCALLBACK userread, FMOD_FILE_SEEKCALLBACK userseek, int blockalign);
         FMOD_RESULT setSpeakerMode(FMOD_SPEAKERMODE speakermode);
         FMOD_RESULT update();
 
 	// BBGE-specific...
 	FMOD_RESULT getNumChannels(int *maxchannels_ret);
+	FMOD_RESULT setSampleCacheBudget(unsigned long bytes);
+	FMOD_RESULT getSampleCacheStats(FMOD_SAMPLECACHE_STATS *stats);
+	FMOD_RESULT getStreamStats(FMOD_STREAM_STATS *stats);
     };
 
     typedef System FMOD_SYSTEM;
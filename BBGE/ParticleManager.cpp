@@ -20,6 +20,8 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 */
 #include "Particles.h"
 
+#include <algorithm>
+
 ParticleManager *particleManager = 0;
 
 typedef std::map<std::string, ParticleEffect*> ParticleBank;
@@ -409,43 +411,430 @@ Particle *ParticleManager::getFreeParticle(Emitter *emitter)
 	return p;
 }
 
-void loadParticleCallback(const std::string &filename, intptr_t param)
+/*************************************************************************/
+
+// Compiled particle banks.  Parsing every effect's text file at startup
+// is slow, so after a bank directory has been parsed once, the resulting
+// emitter data is written out in binary form to the user data folder.
+// The compiled file records a signature built from the names and
+// modification times of all source files in the bank; if any source file
+// is added, removed, or changed, the signature no longer matches and the
+// bank is rebuilt from the text sources.
+
+static const char COMPILED_BANK_MAGIC[4] = {'P','B','K','1'};
+static const int COMPILED_BANK_VERSION = 1;
+
+typedef std::vector<std::string> BankFileList;
+
+static void collectBankFileCallback(const std::string &filename, intptr_t param)
 {
-	ParticleManager *pm;
-	pm = (ParticleManager*)param;
+	((BankFileList*)param)->push_back(filename);
+}
 
-	if (pm->loadProgressCallback)
-		pm->loadProgressCallback();
+static std::string getCompiledBankFilename(const std::string &path)
+{
+	std::ostringstream os;
+	if (!core->getUserDataFolder().empty())
+		os << core->getUserDataFolder() << "/";
+	os << "particles-" << std::hex << hash(path) << ".pbk";
+	return os.str();
+}
 
-	ParticleEffect *e = new ParticleEffect();
+static unsigned getBankSignature(const BankFileList &files)
+{
+	std::ostringstream os;
+	for (int i = 0; i < files.size(); i++)
+		os << files[i] << ':' << getFileModTime(files[i]) << ';';
+	return hash(os.str());
+}
 
-	std::string ident;
+static std::string getBankIdent(const std::string &filename)
+{
 	int first = filename.find_last_of('/')+1;
-	ident = filename.substr(first, filename.find_last_of('.')-first);
+	std::string ident = filename.substr(first, filename.find_last_of('.')-first);
 	stringToLower(ident);
+	return ident;
+}
 
-	e->bankLoad(ident, ParticleManager::particleBankPath);
+template <typename T>
+static void bankWrite(std::ostringstream &os, const T &v)
+{
+	os.write((const char*)&v, sizeof(v));
+}
 
-	particleBank[ident] = e;
+static void bankWriteString(std::ostringstream &os, const std::string &s)
+{
+	bankWrite(os, (int)s.size());
+	os.write(s.data(), s.size());
 }
 
-void ParticleManager::loadParticleBank(const std::string &bank1, const std::string &bank2, void progressCallback())
+static void bankWriteVector(std::ostringstream &os, const InterpolatedVector &v)
 {
-	loadProgressCallback = progressCallback;
+	bankWrite(os, v.x);
+	bankWrite(os, v.y);
+	bankWrite(os, v.z);
+	const int numNodes = v.data ? v.data->path.getNumPathNodes() : 0;
+	bankWrite(os, numNodes);
+	if (numNodes > 0)
+	{
+		bankWrite(os, v.data->pathTime);
+		for (int i = 0; i < numNodes; i++)
+		{
+			const VectorPathNode *node = v.data->path.getPathNode(i);
+			bankWrite(os, node->value.x);
+			bankWrite(os, node->value.y);
+			bankWrite(os, node->value.z);
+			bankWrite(os, node->percent);
+		}
+	}
+}
 
-	clearParticleBank();
+static void bankWriteSpawnData(std::ostringstream &os, const SpawnParticleData &d)
+{
+	bankWrite(os, d.randomScale1);
+	bankWrite(os, d.randomScale2);
+	bankWrite(os, d.randomAlphaMod1);
+	bankWrite(os, d.randomAlphaMod2);
+	bankWrite(os, d.pauseLevel);
+	bankWrite(os, d.flipH);
+	bankWrite(os, d.flipV);
+	bankWrite(os, (int)d.spawnArea);
+	bankWrite(os, d.avatarVelocity);
+	bankWriteVector(os, d.velocityMagnitude);
+	bankWrite(os, d.randomParticleAngleRange);
+	bankWrite(os, d.randomVelocityRange);
+	bankWrite(os, d.randomVelocityMagnitude);
+	bankWrite(os, d.randomRotationRange);
+	bankWriteVector(os, d.initialVelocity);
+	bankWriteVector(os, d.number);
+	bankWriteVector(os, d.gravity);
+	bankWrite(os, d.randomSpawnRadius);
+	bankWrite(os, d.randomSpawnMod.x);
+	bankWrite(os, d.randomSpawnMod.y);
+	bankWrite(os, d.randomSpawnRadiusRange);
+	bankWrite(os, d.justOne);
+	bankWrite(os, d.alphaModTimesVel);
+	bankWrite(os, d.copyParentRotation);
+	bankWrite(os, d.copyParentFlip);
+	bankWrite(os, d.useSpawnRate);
+	bankWrite(os, d.calculateVelocityToCenter);
+	bankWrite(os, d.fadeAlphaWithLife);
+	bankWrite(os, d.addAsChild);
+	bankWrite(os, d.width);
+	bankWrite(os, d.height);
+	bankWriteVector(os, d.scale);
+	bankWriteVector(os, d.rotation);
+	bankWriteVector(os, d.color);
+	bankWriteVector(os, d.alpha);
+	bankWriteVector(os, d.spawnOffset);
+	bankWrite(os, d.life);
+	bankWriteVector(os, d.spawnRate);
+	bankWriteString(os, d.texture);
+	bankWrite(os, (int)d.blendType);
+	bankWrite(os, d.spawnTimeOffset);
+	bankWrite(os, d.spawnLocal);
+	bankWrite(os, d.groupRender);
+	bankWrite(os, d.influenced);
+	bankWriteString(os, d.deathPrt);
+	bankWrite(os, d.suckIndex);
+	bankWrite(os, d.suckStr);
+}
 
-	particleBankPath = bank1;
-	forEachFile(bank1, ".txt", loadParticleCallback, (intptr_t)this);
+// Sequential reader over a compiled bank buffer.  Any attempt to read
+// past the end of the buffer clears the "ok" flag and returns zeroes.
+struct CompiledBankReader
+{
+	CompiledBankReader(const char *buffer, unsigned long size)
+		: pos(buffer), end(buffer + size), ok(true) {}
 
-	if (!bank2.empty())
+	template <typename T>
+	void read(T &v)
+	{
+		if (!ok || end - pos < (long)sizeof(v))
+		{
+			ok = false;
+			memset(&v, 0, sizeof(v));
+			return;
+		}
+		memcpy(&v, pos, sizeof(v));
+		pos += sizeof(v);
+	}
+
+	void readString(std::string &s)
+	{
+		int len;
+		read(len);
+		if (!ok || len < 0 || end - pos < len)
+		{
+			ok = false;
+			s.clear();
+			return;
+		}
+		s.assign(pos, len);
+		pos += len;
+	}
+
+	void readVector(InterpolatedVector &v)
+	{
+		float x, y, z;
+		int numNodes;
+		read(x);
+		read(y);
+		read(z);
+		read(numNodes);
+		if (numNodes > 0 && ok)
+		{
+			float pathTime;
+			read(pathTime);
+			v.ensureData();
+			v.data->path.clear();
+			for (int i = 0; i < numNodes && ok; i++)
+			{
+				float nx, ny, nz, percent;
+				read(nx);
+				read(ny);
+				read(nz);
+				read(percent);
+				v.data->path.addPathNode(Vector(nx, ny, nz), percent);
+			}
+			v.startPath(pathTime);
+		}
+		v.x = x;
+		v.y = y;
+		v.z = z;
+	}
+
+	template <typename E>
+	void readEnum(E &v)
+	{
+		int i;
+		read(i);
+		v = (E)i;
+	}
+
+	void readSpawnData(SpawnParticleData &d)
+	{
+		read(d.randomScale1);
+		read(d.randomScale2);
+		read(d.randomAlphaMod1);
+		read(d.randomAlphaMod2);
+		read(d.pauseLevel);
+		read(d.flipH);
+		read(d.flipV);
+		readEnum(d.spawnArea);
+		read(d.avatarVelocity);
+		readVector(d.velocityMagnitude);
+		read(d.randomParticleAngleRange);
+		read(d.randomVelocityRange);
+		read(d.randomVelocityMagnitude);
+		read(d.randomRotationRange);
+		readVector(d.initialVelocity);
+		readVector(d.number);
+		readVector(d.gravity);
+		read(d.randomSpawnRadius);
+		read(d.randomSpawnMod.x);
+		read(d.randomSpawnMod.y);
+		read(d.randomSpawnRadiusRange);
+		read(d.justOne);
+		read(d.alphaModTimesVel);
+		read(d.copyParentRotation);
+		read(d.copyParentFlip);
+		read(d.useSpawnRate);
+		read(d.calculateVelocityToCenter);
+		read(d.fadeAlphaWithLife);
+		read(d.addAsChild);
+		read(d.width);
+		read(d.height);
+		readVector(d.scale);
+		readVector(d.rotation);
+		readVector(d.color);
+		readVector(d.alpha);
+		readVector(d.spawnOffset);
+		read(d.life);
+		readVector(d.spawnRate);
+		readString(d.texture);
+		readEnum(d.blendType);
+		read(d.spawnTimeOffset);
+		read(d.spawnLocal);
+		read(d.groupRender);
+		read(d.influenced);
+		readString(d.deathPrt);
+		read(d.suckIndex);
+		read(d.suckStr);
+	}
+
+	const char *pos, *end;
+	bool ok;
+};
+
+void ParticleEffect::writeCompiled(std::ostringstream &os)
+{
+	bankWriteString(os, name);
+	bankWrite(os, effectLife);
+	bankWrite(os, scale.x);
+	bankWrite(os, updateCull);
+	bankWrite(os, (int)emitters.size());
+	for (Emitters::iterator i = emitters.begin(); i != emitters.end(); i++)
+		bankWriteSpawnData(os, (*i)->data);
+}
+
+bool ParticleEffect::readCompiled(CompiledBankReader &in)
+{
+	clearEmitters();
+	in.readString(name);
+	in.read(effectLife);
+	in.read(scale.x);
+	scale.y = scale.x;
+	in.read(updateCull);
+	int numEmitters;
+	in.read(numEmitters);
+	for (int i = 0; i < numEmitters && in.ok; i++)
+		in.readSpawnData(addNewEmitter()->data);
+	return in.ok;
+}
+
+static bool loadCompiledBank(const std::string &path, unsigned signature, int numFiles)
+{
+	const std::string filename = getCompiledBankFilename(path);
+	unsigned long size;
+	char *buffer = readFile(filename, &size);
+	if (!buffer)
+		return false;
+
+	CompiledBankReader in(buffer, size);
+	char magic[4];
+	int version, count;
+	unsigned fileSignature;
+	in.read(magic);
+	in.read(version);
+	in.read(fileSignature);
+	in.read(count);
+	if (!in.ok || memcmp(magic, COMPILED_BANK_MAGIC, 4) != 0
+		|| version != COMPILED_BANK_VERSION
+		|| fileSignature != signature || count != numFiles)
+	{
+		debugLog("Compiled particle bank " + filename + " is out of date");
+		delete[] buffer;
+		return false;
+	}
+
+	std::vector<ParticleEffect*> effects;
+	for (int i = 0; i < count && in.ok; i++)
+	{
+		ParticleEffect *e = new ParticleEffect();
+		effects.push_back(e);
+		if (!e->readCompiled(in))
+			break;
+	}
+	delete[] buffer;
+
+	if (!in.ok)
+	{
+		debugLog("Compiled particle bank " + filename + " is corrupt");
+		for (int i = 0; i < effects.size(); i++)
+		{
+			effects[i]->destroy();
+			delete effects[i];
+		}
+		return false;
+	}
+
+	for (int i = 0; i < effects.size(); i++)
 	{
-		particleBankPath = bank2;
-		forEachFile(bank2, ".txt", loadParticleCallback, (intptr_t)this);
+		ParticleEffect *&slot = particleBank[effects[i]->name];
+		if (slot)
+		{
+			slot->destroy();
+			delete slot;
+		}
+		slot = effects[i];
 	}
 
+	debugLog("Loaded compiled particle bank " + filename);
+	return true;
+}
+
+static void saveCompiledBank(const std::string &path, unsigned signature, const std::vector<ParticleEffect*> &effects)
+{
+#ifndef BBGE_BUILD_PSP  // We don't allow arbitrary file writes on the PSP.
+	std::ostringstream os;
+	os.write(COMPILED_BANK_MAGIC, 4);
+	bankWrite(os, COMPILED_BANK_VERSION);
+	bankWrite(os, signature);
+	bankWrite(os, (int)effects.size());
+	for (int i = 0; i < effects.size(); i++)
+		effects[i]->writeCompiled(os);
+
+	const std::string filename = getCompiledBankFilename(path);
+	const std::string data = os.str();
+	FILE *f = fopen(filename.c_str(), "wb");
+	if (!f)
+	{
+		debugLog("Can't write compiled particle bank " + filename);
+		return;
+	}
+	const bool ok = fwrite(data.data(), 1, data.size(), f) == data.size();
+	fclose(f);
+	if (!ok)
+	{
+		debugLog("Failed to write compiled particle bank " + filename);
+		remove(filename.c_str());
+	}
+#endif
+}
+
+void ParticleManager::loadBankDirectory(const std::string &path)
+{
+	BankFileList files;
+	forEachFile(path, ".txt", collectBankFileCallback, (intptr_t)&files);
+	std::sort(files.begin(), files.end());
+	const unsigned signature = getBankSignature(files);
+
+	if (loadCompiledBank(path, signature, files.size()))
+	{
+		if (loadProgressCallback)
+		{
+			for (int i = 0; i < files.size(); i++)
+				loadProgressCallback();
+		}
+		return;
+	}
+
+	std::vector<ParticleEffect*> effects;
+	particleBankPath = path;
+	for (int i = 0; i < files.size(); i++)
+	{
+		if (loadProgressCallback)
+			loadProgressCallback();
+
+		ParticleEffect *e = new ParticleEffect();
+		e->bankLoad(getBankIdent(files[i]), particleBankPath);
+
+		ParticleEffect *&slot = particleBank[e->name];
+		if (slot)
+		{
+			slot->destroy();
+			delete slot;
+		}
+		slot = e;
+		effects.push_back(e);
+	}
 	particleBankPath = "";
 
+	saveCompiledBank(path, signature, effects);
+}
+
+void ParticleManager::loadParticleBank(const std::string &bank1, const std::string &bank2, void progressCallback())
+{
+	loadProgressCallback = progressCallback;
+
+	clearParticleBank();
+
+	loadBankDirectory(bank1);
+
+	if (!bank2.empty())
+		loadBankDirectory(bank2);
+
 	loadProgressCallback = NULL;
 }
 
@@ -26,6 +26,7 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 
 class Emitter;
 class ParticleEffect;
+struct CompiledBankReader;
 
 struct SpawnParticleData
 {
@@ -163,6 +164,8 @@ public:
 	Emitter *addNewEmitter();
 	void clearEmitters();
 	void transfer(ParticleEffect *pe);
+	void writeCompiled(std::ostringstream &os);
+	bool readCompiled(CompiledBankReader &in);
 
 	void setDie(bool v);
 
@@ -231,7 +234,7 @@ public:
 
 protected:
 
-	
+	void loadBankDirectory(const std::string &path);
 
 	std::vector<Vector> suckPositions;
 	int numActive;
@@ -21,6 +21,7 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 #include "Precacher.h"
 #include "Quad.h"
 #include "Core.h"
+#include "../ExternalLibs/glpng.h"
 
 Precacher::Precacher()
 {
@@ -43,6 +44,7 @@ void Precacher::clean()
 		delete r;
 	}
 	renderObjects.clear();
+	held.clear();
 	cleaned = true;
 }
 
@@ -70,6 +72,23 @@ void Precacher::loadTextureRange(const std::string &file, const std::string &typ
 	}
 }
 
+// Internal texture name, as used by Core::doTextureAdd() and findTexture().
+static std::string getInternalName(std::string name)
+{
+	if (name.size() > 4 && name[name.size()-4] == '.')
+		name = name.substr(0, name.size()-4);
+	stringToLowerUserData(name);
+	return name;
+}
+
+// Texture name relative to the base texture directory.
+static std::string getRelativeName(const std::string &tex)
+{
+	if (tex.find(core->getBaseTextureDirectory()) != std::string::npos)
+		return tex.substr(core->getBaseTextureDirectory().size(), tex.size());
+	return tex;
+}
+
 void precacherCallback(const std::string &file, intptr_t param)
 {
 	Precacher *p = (Precacher*)param;
@@ -107,22 +126,123 @@ void Precacher::precacheTex(const std::string &tex)
 	{
 		if (loadProgressCallback)
 			loadProgressCallback();
-		std::string t = tex;
-		if (tex.find(core->getBaseTextureDirectory()) != std::string::npos)
+		const std::string t = getRelativeName(tex);
+		if (held.insert(getInternalName(t)).second)
+			holdTexture(t);
+	}
+}
+
+static void collectManifestCallback(const std::string &file, intptr_t param)
+{
+	((std::vector<std::string>*)param)->push_back(getRelativeName(file));
+}
+
+// Expand one manifest line into texture names (resolving wildcards).
+void Precacher::addManifestEntry(const std::string &tex, std::vector<std::string> &names)
+{
+	if (tex.empty()) return;
+	if (tex.find('*')!=std::string::npos)
+	{
+		int loc = tex.find('*');
+		std::string path  = tex.substr(0, loc);
+		std::string type = tex.substr(loc+1, tex.size());
+		path = core->getBaseTextureDirectory() + path;
+		forEachFile(path, type, collectManifestCallback, (intptr_t)&names);
+	}
+	else
+	{
+		names.push_back(getRelativeName(tex));
+	}
+}
+
+// Keep a reference to the given texture (loading it if necessary) until
+// clean() is called.
+void Precacher::holdTexture(const std::string &name)
+{
+	Quad *q = new Quad;
+	q->setTexture(name);
+	q->alpha = 0;
+	renderObjects.push_back(q);
+	cleaned = false;
+}
+
+#ifdef BBGE_BUILD_SDL
+
+// PNG decoding for precacheList() is done on a small pool of worker
+// threads; the main thread waits for each texture in manifest order and
+// uploads it as soon as its pixels are ready.  Workers stay at most
+// PRECACHE_AHEAD textures ahead of the uploads, so a slow upload doesn't
+// leave the whole list decoded in memory.
+
+const int PRECACHE_THREADS = 4;
+const int PRECACHE_AHEAD = 8;
+
+struct PrecacheJob
+{
+	std::string file;
+	pngDecoded decoded;
+	unsigned long bytes;
+	int decodeMS;
+	bool ok, done;
+};
+
+struct PrecacheQueue
+{
+	std::vector<PrecacheJob> *jobs;
+	int next;
+	int uploaded;	// Jobs the main thread has finished with
+	int ahead;		// How far past that the workers may start jobs
+	int trans;
+	SDL_mutex *lock;
+	SDL_cond *cond;
+};
+
+static int precacheWorker(void *param)
+{
+	PrecacheQueue *queue = (PrecacheQueue*)param;
+	while (true)
+	{
+		SDL_mutexP(queue->lock);
+		while (queue->next < queue->jobs->size() && queue->next >= queue->uploaded + queue->ahead)
+			SDL_CondWait(queue->cond, queue->lock);
+		const int index = queue->next++;
+		SDL_mutexV(queue->lock);
+		if (index >= queue->jobs->size())
+			break;
+
+		PrecacheJob &job = (*queue->jobs)[index];
+		const Uint32 start = SDL_GetTicks();
+		FILE *f = fopen(job.file.c_str(), "rb");
+		if (f)
 		{
-			t = tex.substr(core->getBaseTextureDirectory().size(), tex.size());
+			if (fseek(f, 0, SEEK_END) == 0)
+				job.bytes = ftell(f);
+			fseek(f, 0, SEEK_SET);
+			job.ok = pngDecodeF(f, queue->trans, &job.decoded) != 0;
+			fclose(f);
 		}
-		Quad *q = new Quad;
-		q->setTexture(t);
-		q->alpha = 0;
-		renderObjects.push_back(q);
-		cleaned = false;
+		job.decodeMS = SDL_GetTicks() - start;
+
+		SDL_mutexP(queue->lock);
+		job.done = true;
+		SDL_CondBroadcast(queue->cond);
+		SDL_mutexV(queue->lock);
 	}
+	return 0;
 }
 
+#endif  // BBGE_BUILD_SDL
+
+// Load every texture named in the given manifest.  The whole list is
+// resolved first, so duplicate entries and textures which are already
+// loaded are only referenced, not reloaded, and PNG decoding can run in
+// parallel with texture uploads.
 void Precacher::precacheList(const std::string &list, void progressCallback())
 {
 	loadProgressCallback = progressCallback;
+	const uint32 startTicks = core->getTicks();
+
+	std::vector<std::string> names;
 	std::ifstream in(list.c_str());
 	std::string t;
 	while (std::getline(in, t))
@@ -135,10 +255,164 @@ void Precacher::precacheList(const std::string &list, void progressCallback())
 			debugLog("precache["+t+"]");
 #endif
             stringToLower(t);
-			precacheTex(t);
+			addManifestEntry(t, names);
 		}
 	}
 	in.close();
+
+	// Drop duplicates and note which textures still need to be read.
+	std::vector<AssetStats> assets;
+	std::vector<int> jobIndex;
+#ifdef BBGE_BUILD_SDL
+	std::vector<PrecacheJob> jobs;
+#endif
+	for (int i = 0; i < names.size(); i++)
+	{
+		const std::string internalName = getInternalName(names[i]);
+		if (!held.insert(internalName).second)
+			continue;
+
+		AssetStats stats;
+		stats.name = names[i];
+		stats.bytes = 0;
+		stats.decodeMS = stats.uploadMS = 0;
+		stats.resident = core->findTexture(internalName) != 0;
+		assets.push_back(stats);
+		jobIndex.push_back(-1);
+
+#ifdef BBGE_BUILD_SDL
+		if (stats.resident)
+			continue;
+		std::string loadName = core->getTextureLoadName(names[i]);
+		stringToLowerUserData(loadName);
+		const std::string file = Texture::findImageFile(core->adjustFilenameCase(loadName));
+		// Textures with an up-to-date .dtx file need no decoding.
+		if (file.size() > 4 && nocasecmp(file.substr(file.size()-4), ".png") == 0
+			&& Texture::getCacheFile(file).empty())
+		{
+			PrecacheJob job;
+			job.file = file;
+			job.decoded.Data = 0;
+			job.bytes = 0;
+			job.decodeMS = 0;
+			job.ok = job.done = false;
+			jobIndex.back() = jobs.size();
+			jobs.push_back(job);
+		}
+#endif
+	}
+
+#ifdef BBGE_BUILD_SDL
+	PrecacheQueue queue;
+	std::vector<SDL_Thread*> threads;
+	queue.jobs = &jobs;
+	queue.next = 0;
+	queue.uploaded = 0;
+	queue.ahead = PRECACHE_AHEAD;
+	queue.trans = (Texture::format == GL_LUMINANCE_ALPHA) ? PNG_LUMINANCEALPHA : PNG_ALPHA;
+	queue.lock = 0;
+	queue.cond = 0;
+	if (!jobs.empty())
+	{
+		pngPrepareDecode();
+		queue.lock = SDL_CreateMutex();
+		queue.cond = SDL_CreateCond();
+		const int numThreads = MIN(PRECACHE_THREADS, int(jobs.size()));
+		for (int i = 0; i < numThreads; i++)
+		{
+			SDL_Thread *thread = SDL_CreateThread(precacheWorker, &queue);
+			if (thread)
+				threads.push_back(thread);
+		}
+		if (threads.empty())
+		{
+			// No threads available, so decode everything right here.
+			queue.ahead = jobs.size();
+			precacheWorker(&queue);
+		}
+	}
+#endif
+
+	for (int i = 0; i < assets.size(); i++)
+	{
+		if (loadProgressCallback)
+			loadProgressCallback();
+
+#ifdef BBGE_BUILD_SDL
+		if (jobIndex[i] >= 0)
+		{
+			PrecacheJob &job = jobs[jobIndex[i]];
+			SDL_mutexP(queue.lock);
+			while (!job.done)
+				SDL_CondWait(queue.cond, queue.lock);
+			SDL_mutexV(queue.lock);
+			assets[i].bytes = job.bytes;
+			assets[i].decodeMS = job.decodeMS;
+			if (job.ok)
+				Texture::addPredecodedPNG(job.file, job.decoded);
+		}
+#endif
+
+		const uint32 start = core->getTicks();
+		holdTexture(assets[i].name);
+		assets[i].uploadMS = core->getTicks() - start;
+
+#ifdef BBGE_BUILD_SDL
+		if (jobIndex[i] >= 0)
+		{
+			// Let the workers start another job.
+			SDL_mutexP(queue.lock);
+			queue.uploaded++;
+			SDL_CondBroadcast(queue.cond);
+			SDL_mutexV(queue.lock);
+		}
+#endif
+	}
+
+#ifdef BBGE_BUILD_SDL
+	for (int i = 0; i < threads.size(); i++)
+		SDL_WaitThread(threads[i], NULL);
+	if (queue.lock)
+		SDL_DestroyMutex(queue.lock);
+	if (queue.cond)
+		SDL_DestroyCond(queue.cond);
+	// Anything the texture loader didn't pick up (e.g. because a mod
+	// texture overrode the file) is no longer needed.
+	Texture::clearPredecodedPNGs();
+#endif
+
+	report.insert(report.end(), assets.begin(), assets.end());
+
+	std::ostringstream os;
+	os << "Precached " << assets.size() << " textures from " << list
+	   << " in " << (core->getTicks() - startTicks) << "ms";
+	debugLog(os.str());
+
 	loadProgressCallback = NULL;
 }
 
+void Precacher::logReport()
+{
+	unsigned long totalBytes = 0;
+	int totalDecode = 0, totalUpload = 0;
+	for (int i = 0; i < report.size(); i++)
+	{
+		const AssetStats &stats = report[i];
+		std::ostringstream os;
+		os << "precache: " << stats.name;
+		if (stats.resident)
+			os << " (resident)";
+		else
+			os << " bytes=" << stats.bytes << " decode=" << stats.decodeMS
+			   << "ms upload=" << stats.uploadMS << "ms";
+		debugLog(os.str());
+		totalBytes += stats.bytes;
+		totalDecode += stats.decodeMS;
+		totalUpload += stats.uploadMS;
+	}
+	std::ostringstream os;
+	os << "precache: total " << report.size() << " textures, bytes="
+	   << totalBytes << " decode=" << totalDecode << "ms upload="
+	   << totalUpload << "ms";
+	debugLog(os.str());
+}
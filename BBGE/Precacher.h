@@ -22,6 +22,8 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 
 #include "Quad.h"
 
+#include <set>
+
 class Precacher
 {
 public:
@@ -32,8 +34,25 @@ public:
 	void clean();
 	void loadTextureRange(const std::string &file, const std::string &type, int start, int end);
 
+	// Load statistics for one texture loaded by precacheList().
+	struct AssetStats
+	{
+		std::string name;
+		unsigned long bytes;
+		int decodeMS, uploadMS;
+		bool resident;	// already loaded, so nothing was read
+	};
+	const std::vector<AssetStats> &getReport() const { return report; }
+	void logReport();
+
 	std::vector<RenderObject*> renderObjects;
 private:
+	void addManifestEntry(const std::string &tex, std::vector<std::string> &names);
+	void holdTexture(const std::string &name);
+
 	bool cleaned;
 	void (*loadProgressCallback)();
+
+	std::set<std::string> held;
+	std::vector<AssetStats> report;
 };
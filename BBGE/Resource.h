@@ -44,7 +44,7 @@ public:
 	{
 		ref--;
 		if (ref == 0)
-			destroy();
+			onUnreferenced();
 		/*
 		else if (ref < 0)
 			throw std::exception("ref count out of bounds < 0");
@@ -55,6 +55,10 @@ public:
 	virtual void reload() {}
 	virtual void unload() {}
 protected:
+	// Called when the last reference is removed.  By default the
+	// resource is destroyed right away.
+	virtual void onUnreferenced() { destroy(); }
+
 	int ref;
 };
 
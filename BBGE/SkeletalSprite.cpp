@@ -1709,7 +1709,9 @@ void AnimationLayer::updateBones()
 	{
 		if (!key2->sound.empty())
 		{
-			core->sound->playSfx(key2->sound);
+			if (!key2->soundHandle)
+				key2->soundHandle = core->sound->getSfxHandle(key2->sound);
+			core->sound->playSfx(key2->soundHandle);
 		}
 		if (!key2->commands.empty())
 		{
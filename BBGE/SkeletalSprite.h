@@ -114,10 +114,12 @@ public:
 	{
 		lerpType = 0;
 		t = 0;
+		soundHandle = 0;
 	}
 	int lerpType;
 	float t;
 	std::string sound;
+	int soundHandle;  // resolved from sound on first play
 	std::vector<BoneKeyframe> keyframes;
 	BoneKeyframe *getBoneKeyframe(int idx);
 	std::string cmd;
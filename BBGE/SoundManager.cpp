@@ -79,6 +79,12 @@ namespace SoundCore
 	FMOD::ChannelGroup *group_sfx = 0;
 	FMOD::ChannelGroup *group_mus = 0;
 
+	// Music opened ahead of time by prefetchMusic(), on a paused channel.
+	FMOD::Sound *prefetchStream = 0;
+	FMOD::Channel *prefetchChannel = 0;
+	std::string prefetchFile;
+	FMOD_MODE prefetchMode = 0;
+
 	FMOD::Sound *modSound = 0;
 	FMOD::Channel *modChannel = 0;
 
@@ -271,10 +277,44 @@ void SoundManager::resume()
 }
 
 Buffer SoundManager::getBuffer(const std::string &name)
+{
+	return getBuffer(findSfxHandle(name));
+}
+
+Buffer SoundManager::getBuffer(int handle)
+{
+	if (handle <= 0 || handle >= sfxBuffers.size())
+		return Buffer();
+	return sfxBuffers[handle];
+}
+
+int SoundManager::getSfxHandle(const std::string &name)
 {
 	std::string n = name;
 	stringToLower(n);
-	return soundMap[n];
+	SfxHandles::iterator i = sfxHandles.find(n);
+	if (i != sfxHandles.end())
+		return i->second;
+
+	const int handle = sfxBuffers.size();
+	sfxBuffers.push_back(Buffer());
+	sfxHandles[n] = handle;
+	return handle;
+}
+
+int SoundManager::findSfxHandle(const std::string &name)
+{
+	std::string n = name;
+	stringToLower(n);
+	SfxHandles::iterator i = sfxHandles.find(n);
+	if (i != sfxHandles.end())
+		return i->second;
+	return 0;
+}
+
+void SoundManager::setSfxBuffer(const std::string &name, Buffer buffer)
+{
+	sfxBuffers[getSfxHandle(name)] = buffer;
 }
 
 void SoundManager::getStats(int *curAlloc, int *maxAlloc)
@@ -282,10 +322,71 @@ void SoundManager::getStats(int *curAlloc, int *maxAlloc)
 	FMOD::Memory_GetStats(curAlloc, maxAlloc);
 }
 
+void SoundManager::getStats(SoundCacheStats *stats)
+{
+	*stats = SoundCacheStats();
+#ifdef BBGE_BUILD_FMOD_OPENAL_BRIDGE
+	if (!enabled) return;
+	FMOD_SAMPLECACHE_STATS s;
+	SoundCore::system->getSampleCacheStats(&s);
+	stats->budget = s.budget;
+	stats->bytesUsed = s.bytesUsed;
+	stats->bytesPeak = s.bytesPeak;
+	stats->numSounds = s.numSounds;
+	stats->hits = s.hits;
+	stats->misses = s.misses;
+	stats->evictions = s.evictions;
+#endif
+}
+
+void SoundManager::getStats(SoundStreamStats *stats)
+{
+	*stats = SoundStreamStats();
+#ifdef BBGE_BUILD_FMOD_OPENAL_BRIDGE
+	if (!enabled) return;
+	FMOD_STREAM_STATS s;
+	SoundCore::system->getStreamStats(&s);
+	stats->decodeThreads = s.decodeThreads;
+	stats->activeStreams = s.activeStreams;
+	stats->peakStreams = s.peakStreams;
+	stats->bytesUsed = s.streamBytes;
+	stats->bytesPeak = s.peakStreamBytes;
+	stats->underruns = s.underruns;
+	stats->decodeSeconds = s.decodeSeconds;
+#endif
+}
+
+void SoundManager::logStats()
+{
+	SoundCacheStats cache;
+	SoundStreamStats streams;
+	getStats(&cache);
+	getStats(&streams);
+	std::ostringstream os;
+	os << "Audio stats: decode " << streams.decodeSeconds << "s, "
+	   << streams.decodeThreads << " decode thread(s), "
+	   << streams.peakStreams << " peak streams (" << streams.bytesPeak/1024 << "k buffers), "
+	   << streams.underruns << " underruns; sample cache "
+	   << cache.bytesPeak/1024 << "k peak of " << cache.budget/1024 << "k, "
+	   << cache.hits << " hits, " << cache.misses << " misses, "
+	   << cache.evictions << " evictions";
+	debugLog(os.str());
+}
+
+void SoundManager::setSampleCacheBudget(unsigned long bytes)
+{
+#ifdef BBGE_BUILD_FMOD_OPENAL_BRIDGE
+	if (!enabled) return;
+	SoundCore::system->setSampleCacheBudget(bytes);
+#endif
+}
+
 SoundManager::SoundManager(const std::string &defaultDevice)
 {
 	overrideVoiceFader = -1;
 
+	sfxBuffers.push_back(Buffer());  // handle 0 is never valid
+
 	sound = this;
 
 	enabled = false;
@@ -339,6 +440,17 @@ SoundManager::SoundManager(const std::string &defaultDevice)
         if (checkError()) goto get_out;
     }
 
+#ifndef BBGE_BUILD_FMOD_PSP_BRIDGE
+	// "nosound" runs the full audio pipeline without a sound card, for
+	// measuring audio cost on machines without one.
+	if (defaultDevice == "nosound")
+	{
+		debugLog("set output: nosound");
+		result = SoundCore::system->setOutput(FMOD_OUTPUTTYPE_NOSOUND);
+		if (checkError()) goto get_out;
+	}
+#endif
+
 	debugLog("init");
     result = SoundCore::system->init(channels, FMOD_INIT_NORMAL, 0);    /* Replace with whatever channel count and flags you use! */
     if (result == FMOD_ERR_OUTPUT_CREATEBUFFER)         /* Ok, the speaker mode selected isn't supported by this soundcard.  Switch it back to stereo... */
@@ -550,6 +662,9 @@ SoundManager::~SoundManager()
 	// release
 	if (!enabled) return;
 
+	logStats();
+	clearPrefetchedMusic();
+
 	for (SoundMap::iterator i = soundMap.begin(); i != soundMap.end(); i++)
 	{
 		std::string snd = (*i).first;
@@ -563,6 +678,7 @@ SoundManager::~SoundManager()
 #endif
 	}
 	soundMap.clear();
+	sfxBuffers.assign(sfxBuffers.size(), Buffer());
 
 #ifdef BBGE_BUILD_FMODEX
 	SoundCore::system->release();
@@ -1123,7 +1239,7 @@ void *SoundManager::playSfx(const PlaySfx &play)
 	
 
 	if (play.handle)
-		sound = (FMOD::Sound*)play.handle;
+		sound = (FMOD::Sound*)getBuffer(play.handle);
 	else if (!play.name.empty())
 		sound = (FMOD::Sound*)getBuffer(play.name);
 #ifdef BBGE_DISABLE_SOUND_CACHE
@@ -1267,6 +1383,33 @@ bool SoundManager::playMod(const std::string &name)
 	return true;
 }
 
+#ifdef BBGE_BUILD_FMODEX
+static FMOD_MODE getMusicMode(SoundLoopType slt)
+{
+	// FMOD_DEFAULT uses the defaults.  These are the same as FMOD_LOOP_OFF | FMOD_2D | FMOD_HARDWARE.
+
+	FMOD_MODE mode=0;
+
+	///FMOD_DEFAULT;////mode = FMOD_2D | FMOD_SOFTWARE;
+
+	mode = FMOD_2D | FMOD_SOFTWARE | FMOD_CREATESTREAM;
+
+
+	switch(slt)
+	{
+	case SLT_OFF:
+	case SLT_NONE:
+		mode |= FMOD_LOOP_OFF;
+	break;
+	default:
+		mode |= FMOD_LOOP_NORMAL;
+	break;
+	}
+
+	return mode;
+}
+#endif
+
 bool SoundManager::playMusic(const std::string &name, SoundLoopType slt, SoundFadeType sft, float trans, SoundConditionType sct)
 {
 	debugLog("playMusic: " + name);
@@ -1285,30 +1428,7 @@ bool SoundManager::playMusic(const std::string &name, SoundLoopType slt, SoundFa
 		}
 	}
 
-	std::string fn = "";
-	if (!name.empty() && name[0] == '.')
-	{
-		fn = name;
-		stringToLower(fn);
-	}
-	else
-	{
-		if (!audioPath2.empty())
-		{
-			fn = audioPath2 + name + fileType;
-			stringToLower(fn);
-			if (!exists(fn))
-			{
-				fn = musicPath + name + fileType;
-				stringToLower(fn);
-			}
-		}
-		else
-		{
-			fn = musicPath + name + fileType;
-			stringToLower(fn);
-		}
-	}
+	const std::string fn = getMusicFile(name);
 
 	lastMusic = name;
 	stringToLower(lastMusic);
@@ -1335,39 +1455,37 @@ bool SoundManager::playMusic(const std::string &name, SoundLoopType slt, SoundFa
 		musicChannel = 0;
 	}
 
-	// FMOD_DEFAULT uses the defaults.  These are the same as FMOD_LOOP_OFF | FMOD_2D | FMOD_HARDWARE.
-
-	FMOD_MODE mode=0;
-
-	///FMOD_DEFAULT;////mode = FMOD_2D | FMOD_SOFTWARE;
-
-	mode = FMOD_2D | FMOD_SOFTWARE | FMOD_CREATESTREAM;
+	const FMOD_MODE mode = getMusicMode(slt);
 
+	stopMusicOnFadeOut = false;
+	musVol.stop();
 
-	switch(slt)
+	if (prefetchChannel && prefetchFile == fn && prefetchMode == mode)
 	{
-	case SLT_OFF:
-	case SLT_NONE:
-		mode |= FMOD_LOOP_OFF;
-	break;
-	default:
-		mode |= FMOD_LOOP_NORMAL;
-	break;
+		// Already open with its first buffers decoded; just start it.
+		debugLog("using prefetched music");
+		musicStream = prefetchStream;
+		musicChannel = prefetchChannel;
+		prefetchStream = 0;
+		prefetchChannel = 0;
+		prefetchFile = "";
 	}
+	else
+	{
+		clearPrefetchedMusic();
 
-	stopMusicOnFadeOut = false;
-	musVol.stop();
+		result = SoundCore::system->createStream(fn.c_str(), mode, 0, &musicStream);
+		if (checkError()) musicStream = 0;
 
-	result = SoundCore::system->createStream(fn.c_str(), mode, 0, &musicStream);
-	if (checkError()) musicStream = 0;
+		if (musicStream)
+		{
+			result = SoundCore::system->playSound(FMOD_CHANNEL_FREE, musicStream, true, &musicChannel);
+			checkError();
+		}
+	}
 
 	if (musicStream)
 	{
-		
-
-		result = SoundCore::system->playSound(FMOD_CHANNEL_FREE, musicStream, true, &musicChannel);
-		checkError();
-
 		result = musicChannel->setChannelGroup(group_mus);
 		checkError();
 
@@ -1401,6 +1519,94 @@ bool SoundManager::playMusic(const std::string &name, SoundLoopType slt, SoundFa
 }
 
 
+std::string SoundManager::getMusicFile(const std::string &name)
+{
+	std::string fn = "";
+	if (!name.empty() && name[0] == '.')
+	{
+		fn = name;
+		stringToLower(fn);
+	}
+	else
+	{
+		if (!audioPath2.empty())
+		{
+			fn = audioPath2 + name + fileType;
+			stringToLower(fn);
+			if (!exists(fn))
+			{
+				fn = musicPath + name + fileType;
+				stringToLower(fn);
+			}
+		}
+		else
+		{
+			fn = musicPath + name + fileType;
+			stringToLower(fn);
+		}
+	}
+	return fn;
+}
+
+// Open a music track and start it paused, so the decoder fills its first
+// buffers now instead of when playMusic() is called.  Only the most
+// recently prefetched track is kept; it is dropped if playMusic() plays
+// something else.
+void SoundManager::prefetchMusic(const std::string &name, SoundLoopType slt)
+{
+	if (!enabled || name.empty() || isPlayingMusic(name)) return;
+
+#ifdef BBGE_BUILD_FMODEX
+	const std::string fn = getMusicFile(name);
+	const FMOD_MODE mode = getMusicMode(slt);
+	if (prefetchChannel && prefetchFile == fn && prefetchMode == mode)
+		return;
+
+	clearPrefetchedMusic();
+
+	debugLog("prefetchMusic: " + name);
+	result = SoundCore::system->createStream(fn.c_str(), mode, 0, &prefetchStream);
+	if (checkError())
+	{
+		prefetchStream = 0;
+		return;
+	}
+
+	result = SoundCore::system->playSound(FMOD_CHANNEL_FREE, prefetchStream, true, &prefetchChannel);
+	if (checkError() || !prefetchChannel)
+	{
+		prefetchChannel = 0;
+		prefetchStream->release();
+		prefetchStream = 0;
+		return;
+	}
+	// Not added to group_mus until it plays, so that resuming the group
+	// doesn't start it early.
+	prefetchChannel->setPriority(0);
+	prefetchChannel->setVolume(0);
+
+	prefetchFile = fn;
+	prefetchMode = mode;
+#endif
+}
+
+void SoundManager::clearPrefetchedMusic()
+{
+#ifdef BBGE_BUILD_FMODEX
+	if (prefetchChannel)
+	{
+		prefetchChannel->stop();
+		prefetchChannel = 0;
+	}
+	if (prefetchStream)
+	{
+		prefetchStream->release();
+		prefetchStream = 0;
+	}
+	prefetchFile = "";
+#endif
+}
+
 void SoundManager::stopMusic()
 {
 
@@ -1590,6 +1796,7 @@ Buffer SoundManager::loadSoundIntoBank(const std::string &filename, const std::s
 #endif
 
 	SoundCore::soundMap[name] = sound;
+	setSfxBuffer(name, sound);
 
 
 	if (slt == SFXLOAD_LOCAL)
@@ -1654,6 +1861,7 @@ void SoundManager::clearLocalSounds()
 		delete info;
 #endif
 		soundMap[snd] = 0;
+		setSfxBuffer(snd, 0);
 	}
 	localSounds.clear();
 #endif
@@ -22,7 +22,9 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 
 #include <string>
 #include <list>
+#include <map>
 #include <queue>
+#include <vector>
 #include "Vector.h"
 
 // if using SDL_MIXER
@@ -100,12 +102,32 @@ enum SoundLoadType
 	SFXLOAD_LOCAL		= 1
 };
 
+struct SoundCacheStats
+{
+	SoundCacheStats() : budget(0), bytesUsed(0), bytesPeak(0), numSounds(0), hits(0), misses(0), evictions(0) {}
+
+	unsigned long budget, bytesUsed, bytesPeak;
+	int numSounds;
+	int hits, misses, evictions;
+};
+
+struct SoundStreamStats
+{
+	SoundStreamStats() : decodeThreads(0), activeStreams(0), peakStreams(0), bytesUsed(0), bytesPeak(0), underruns(0), decodeSeconds(0) {}
+
+	int decodeThreads;
+	int activeStreams, peakStreams;
+	unsigned long bytesUsed, bytesPeak;  // stream buffers, not the sample cache
+	int underruns;
+	double decodeSeconds;
+};
+
 struct PlaySfx
 {
 	PlaySfx() : priority(0.5), handle(0), pan(0), vol(1), fade(SFT_NONE), time(0), freq(1), loops(0), channel(BBGE_AUDIO_NOCHANNEL) {}
 
 	std::string name;
-	int handle;
+	int handle;  // from SoundManager::getSfxHandle(); used instead of name if set
 	float pan;
 	float vol;
 	float time;
@@ -137,6 +159,15 @@ public:
 	SoundCore::Buffer loadLocalSound(const std::string &sound);
 	SoundCore::Buffer loadSoundIntoBank(const std::string &filename, const std::string &path, const std::string &format, SoundLoadType = SFXLOAD_CACHE);
 	SoundCore::Buffer getBuffer(const std::string &name);
+	SoundCore::Buffer getBuffer(int handle);
+
+	// Sound effect names can be resolved once to integer handles (never
+	// 0) and played by handle, skipping the name lookup on every play.
+	// A handle stays valid for the life of the SoundManager and follows
+	// the sound as it is loaded and unloaded.
+	int getSfxHandle(const std::string &name);
+	// Like getSfxHandle(), but returns 0 rather than creating a handle.
+	int findSfxHandle(const std::string &name);
 
 	void *playSfx(const PlaySfx &play);
 	void *playSfx(const std::string &name, float vol=1, float pan=0, float freq=1);
@@ -144,6 +175,11 @@ public:
 
 	bool playMod(const std::string &name);
 	bool playMusic(const std::string &name, SoundLoopType=SLT_NORMAL, SoundFadeType sft=SFT_NONE, float trans=0, SoundConditionType sct=SCT_NORMAL);
+	// Open a track ahead of a later playMusic() call with the same name
+	// and loop type, so that it (and any crossfade) starts from buffers
+	// that are already decoded.
+	void prefetchMusic(const std::string &name, SoundLoopType=SLT_NORMAL);
+	void clearPrefetchedMusic();
 	bool playVoice(const std::string &name, SoundVoiceType=SVT_QUEUE, float vmod=-1);
 
 	float getMusicFader();
@@ -231,6 +267,12 @@ public:
 	std::string audioPath2;
 
 	void getStats(int *curAlloc, int *maxAlloc);
+	// Decoded sample cache (OpenAL bridge only; all zero elsewhere).
+	void getStats(SoundCacheStats *stats);
+	void getStats(SoundStreamStats *stats);
+	void setSampleCacheBudget(unsigned long bytes);
+	// Write the cache and stream statistics to the debug log.
+	void logStats();
 
 	std::string reverbKeyword;
 private:
@@ -247,6 +289,13 @@ private:
 	std::queue<std::string> voxQueue;
 
 	void (*loadProgressCallback)();
+
+	std::string getMusicFile(const std::string &name);
+
+	typedef std::map<std::string, int> SfxHandles;
+	SfxHandles sfxHandles;
+	std::vector<SoundCore::Buffer> sfxBuffers;  // indexed by handle
+	void setSfxBuffer(const std::string &name, SoundCore::Buffer buffer);
 };
 
 extern SoundManager *sound;
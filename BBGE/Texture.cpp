@@ -21,6 +21,7 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 #include "Texture.h"
 #include "Core.h"
 #include "../ExternalLibs/glpng.h"
+#include "TextureCache.h"
 
 #include <assert.h>
 
@@ -55,6 +56,28 @@ bool Texture::useMipMaps = true;
 
 TexErr Texture::textureError = TEXERR_OK;
 
+#ifdef BBGE_BUILD_OPENGL
+typedef std::map<std::string, pngDecoded> PredecodedPNGs;
+static PredecodedPNGs predecodedPNGs;
+#endif
+
+#if defined(BBGE_BUILD_OPENGL) && !defined(BBGE_BUILD_PSP)
+void Texture::addPredecodedPNG(const std::string &file, const pngDecoded &decoded)
+{
+	PredecodedPNGs::iterator i = predecodedPNGs.find(file);
+	if (i != predecodedPNGs.end())
+		pngFreeDecoded(&i->second);
+	predecodedPNGs[file] = decoded;
+}
+
+void Texture::clearPredecodedPNGs()
+{
+	for (PredecodedPNGs::iterator i = predecodedPNGs.begin(); i != predecodedPNGs.end(); i++)
+		pngFreeDecoded(&i->second);
+	predecodedPNGs.clear();
+}
+#endif
+
 Texture::Texture() : Resource()
 {
 	components = 0;
@@ -76,6 +99,10 @@ Texture::Texture() : Resource()
 	ow = oh = -1;
 
 	leftOffset = rightOffset = topOffset = bottomOffset = 0;
+
+	bytes = 0;
+	lastUseFrame = 0;
+	fileTime = fileSize = 0;
 }
 
 Texture::~Texture()
@@ -196,6 +223,40 @@ void Texture::destroy()
 //	Resource::destroy();
 }
 
+// Unused textures are handed to Core, which keeps them loaded while
+// there is room in the texture budget in case they are wanted again.
+void Texture::onUnreferenced()
+{
+	if (!core->retainTexture(this))
+		destroy();
+}
+
+bool Texture::isFileChanged()
+{
+	const std::string file = findImageFile(loadName);
+	return getFileModTime(file) != fileTime || getFileSize(file) != fileSize;
+}
+
+void Texture::updateMemoryUsage()
+{
+	bytes = 0;
+#ifdef BBGE_BUILD_OPENGL
+	if (!textures[0])
+		return;
+#endif
+	// Texture data is padded out to power-of-two sizes.
+	unsigned long w = 1, h = 1;
+	while (w < (unsigned long)width)
+		w <<= 1;
+	while (h < (unsigned long)height)
+		h <<= 1;
+	bytes = w * h * (components ? components : 4);
+#ifdef BBGE_BUILD_OPENGL
+	if (filter != GL_NEAREST)
+		bytes += bytes/3;  // mipmaps
+#endif
+}
+
 int Texture::getPixelWidth()
 {
 #ifdef BBGE_BUILD_OPENGL
@@ -313,24 +374,12 @@ void Texture::reload()
 	debugLog("DONE");
 }
 
-void Texture::load(std::string file)
+// Work out which file Texture::load() will read for the given (already
+// case-adjusted) load name.  If the name has no extension, ".png" and
+// ".jp2" are tried in turn.  Returns an empty string if no such file
+// exists.
+std::string Texture::findImageFile(const std::string &file)
 {
-	Texture::textureError = TEXERR_OK;
-
-	if (file.size()<4)
-	{
-		errorLog("Texture Name is Empty or Too Short");
-		Texture::textureError = TEXERR_FILENOTFOUND;
-		return;
-	}
-
-	stringToLowerUserData(file);
-	file = core->adjustFilenameCase(file);
-
-	loadName = file;
-
-	bool check = true;
-
 	size_t pos = file.find_last_of('.');
 	if ((pos != std::string::npos) && (pos >= 0))
 	{
@@ -350,32 +399,46 @@ void Texture::load(std::string file)
 
 	if (!exists(file, false) && (pos == std::string::npos || pos == 0))
 	{
-		std::string originalFile = file;
-		file = originalFile + ".png";
+		std::string found = file + ".png";
 		//errorLog ("Trying png");
-		if (!exists(file, false))
+		if (!exists(found, false))
 		{
 		//	errorLog ("trying jpg");
-			file = originalFile + ".jp2";
-			if (!exists(file, false))
+			found = file + ".jp2";
+			if (!exists(found, false))
 			{
-				file = originalFile;
+				return "";
 			}
 		}
-		else
-		{
-		//	errorLog ("png exists!");
-		}
+		return found;
 	}
-	else
+
+	return file;
+}
+
+void Texture::load(std::string file)
+{
+	Texture::textureError = TEXERR_OK;
+
+	if (file.size()<4)
 	{
-		check = false;
+		errorLog("Texture Name is Empty or Too Short");
+		Texture::textureError = TEXERR_FILENOTFOUND;
+		return;
 	}
 
+	stringToLowerUserData(file);
+	file = core->adjustFilenameCase(file);
+
+	loadName = file;
 
+	const std::string imageFile = findImageFile(file);
+	fileTime = getFileModTime(imageFile);
+	fileSize = getFileSize(imageFile);
 
-	if ((check && exists(file.c_str(), false)) || !check)
+	if (!imageFile.empty())
 	{
+		file = imageFile;
 		/*
 		std::ostringstream os;
 		os << "Loading texture [" << file << "]";
@@ -387,7 +450,8 @@ void Texture::load(std::string file)
 		{
 
 #ifdef BBGE_BUILD_OPENGL
-			loadPNG(file);
+			if (!loadDTX(file))
+				loadPNG(file);
 #endif
 
 #ifdef BBGE_BUILD_DIRECTX
@@ -449,10 +513,13 @@ void Texture::load(std::string file)
 		width = 64;
 		height = 64;
 	}
+
+	updateMemoryUsage();
 }
 
 void Texture::apply(bool repeatOverride)
 {
+	lastUseFrame = core->getFrameNumber();
 #ifdef BBGE_BUILD_OPENGL
 	glBindTexture(GL_TEXTURE_2D, textures[0]);
 	if (repeat || repeatOverride)
@@ -490,6 +557,117 @@ void Texture::setID(int id)
 
 #endif
 
+// Return the name of the preprocessed (*.dtx) copy of the given PNG file
+// if one exists and is at least as new as the PNG, else an empty string.
+std::string Texture::getCacheFile(const std::string &pngFile)
+{
+#if defined(BBGE_BUILD_OPENGL) && !defined(BBGE_BUILD_PSP)
+	if (pngFile.size() < 4)
+		return "";
+	const std::string cacheFile = pngFile.substr(0, pngFile.size()-4) + ".dtx";
+	const unsigned long cacheTime = getFileModTime(cacheFile);
+	if (cacheTime != 0 && cacheTime >= getFileModTime(pngFile))
+		return cacheFile;
+#endif
+	return "";
+}
+
+// Load the preprocessed copy of the given PNG file, if there is a usable
+// one.  Returns false (leaving the texture untouched) if the PNG itself
+// should be loaded instead.
+bool Texture::loadDTX(const std::string &pngFile)
+{
+#if defined(BBGE_BUILD_OPENGL) && !defined(BBGE_BUILD_PSP)
+	if (format != 0)
+		return false;  // Only plain RGB(A) data is cached.
+
+	const std::string file = getCacheFile(pngFile);
+	if (file.empty())
+		return false;
+
+	unsigned long size;
+	char *buffer = readFile(file, &size);
+	if (!buffer)
+		return false;
+
+	DTXFileHeader header;
+	if (size < sizeof(header))
+	{
+		delete[] buffer;
+		return false;
+	}
+	memcpy(&header, buffer, sizeof(header));
+
+	GLint maxTextureSize = 0;
+	glGetIntegerv(GL_MAX_TEXTURE_SIZE, &maxTextureSize);
+
+	bool ok = memcmp(header.magic, DTX_FILE_MAGIC, sizeof(header.magic)) == 0
+		&& header.version == DTX_FILE_VERSION
+		&& (header.components == 3 || header.components == 4)
+		&& header.data_width > 0 && header.data_height > 0
+		&& header.data_width <= (unsigned int)maxTextureSize && header.data_height <= (unsigned int)maxTextureSize
+		&& (filter == GL_NEAREST || header.mipmaps > 0)
+		&& fabsf(header.gamma - (float)pngGetScreenGamma()) < 0.001f;
+
+	// Make sure the file actually holds all the levels it claims to.
+	unsigned long dataSize = 0;
+	if (ok)
+	{
+		unsigned int w = header.data_width, h = header.data_height;
+		for (int level = 0; level <= header.mipmaps; level++)
+		{
+			dataSize += w * h * header.components;
+			if (w > 1) w /= 2;
+			if (h > 1) h /= 2;
+		}
+		ok = header.pixels_offset <= size && size - header.pixels_offset >= dataSize;
+	}
+
+	if (!ok)
+	{
+		debugLog("Ignoring unusable texture cache file " + file);
+		delete[] buffer;
+		return false;
+	}
+
+	const GLenum glformat = (header.components == 4) ? GL_RGBA : GL_RGB;
+	glGenTextures(1, &textures[0]);
+	glBindTexture(GL_TEXTURE_2D, textures[0]);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, filter);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, (filter == GL_NEAREST) ? filter : GL_LINEAR_MIPMAP_LINEAR);
+
+	GLint unpack;
+	glGetIntegerv(GL_UNPACK_ALIGNMENT, &unpack);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	const unsigned char *pixels = (const unsigned char *)buffer + header.pixels_offset;
+	unsigned int w = header.data_width, h = header.data_height;
+	const int levels = (filter == GL_NEAREST) ? 1 : header.mipmaps + 1;
+	for (int level = 0; level < levels; level++)
+	{
+		glTexImage2D(GL_TEXTURE_2D, level, header.components, w, h, 0, glformat, GL_UNSIGNED_BYTE, pixels);
+		pixels += w * h * header.components;
+		if (w > 1) w /= 2;
+		if (h > 1) h /= 2;
+	}
+	glPixelStorei(GL_UNPACK_ALIGNMENT, unpack);
+
+	delete[] buffer;
+
+	width = header.width;
+	height = header.height;
+	components = header.components;
+	leftOffset   = (float)header.empty_l / (float)header.width;
+	rightOffset  = (float)header.empty_r / (float)header.width;
+	topOffset    = (float)header.empty_t / (float)header.height;
+	bottomOffset = (float)header.empty_b / (float)header.height;
+	return true;
+#else
+	return false;
+#endif
+}
+
 void Texture::loadPNG(const std::string &file)
 {
 	if (file.empty()) return;
@@ -544,7 +722,22 @@ void Texture::loadPNG(const std::string &file)
 			pngType = PNG_LUMINANCEALPHA;
 	}
 
-	if (filter == GL_NEAREST)
+	// Use pixel data decoded in advance by the precacher if we have it.
+	PredecodedPNGs::iterator predecoded = predecodedPNGs.find(file);
+	if (predecoded != predecodedPNGs.end())
+	{
+		if (filter == GL_NEAREST)
+		{
+			textures[0] = pngBindDecoded(&predecoded->second, PNG_NOMIPMAPS, pngType, &info, GL_CLAMP_TO_EDGE, filter, filter);
+		}
+		else
+		{
+			textures[0] = pngBindDecoded(&predecoded->second, PNG_BUILDMIPMAPS, pngType, &info, GL_CLAMP_TO_EDGE, GL_LINEAR_MIPMAP_LINEAR, filter);
+		}
+		pngFreeDecoded(&predecoded->second);
+		predecodedPNGs.erase(predecoded);
+	}
+	else if (filter == GL_NEAREST)
 	{
 		textures[0] = pngBind(file.c_str(), PNG_NOMIPMAPS, pngType, &info, GL_CLAMP_TO_EDGE, filter, filter);
 	}
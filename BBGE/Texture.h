@@ -22,6 +22,7 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 #define __texture__
 
 #include "Resource.h"
+#include "../ExternalLibs/glpng.h"
 
 struct ImageTGA
 {
@@ -42,7 +43,8 @@ class Texture : public Resource
 {
 public:
 	Texture();
-	~Texture();
+	// Virtual so that Core can delete unused textures directly.
+	virtual ~Texture();
 
 	void load(std::string file);
 	void apply(bool repeatOverride=false);
@@ -87,13 +89,38 @@ public:
 
 	static TexErr textureError;
 
+	static std::string findImageFile(const std::string &file);
+	static std::string getCacheFile(const std::string &pngFile);
+#if defined(BBGE_BUILD_OPENGL) && !defined(BBGE_BUILD_PSP)
+	// PNG data decoded ahead of time (for example on a precacher worker
+	// thread), which loadPNG() will upload instead of reading the file.
+	// Ownership of the pixel data passes to Texture.
+	static void addPredecodedPNG(const std::string &file, const pngDecoded &decoded);
+	static void clearPredecodedPNGs();
+#endif
+
 	void write(int tx, int ty, int w, int h, const unsigned char *pixels);
 	void read(int tx, int ty, int w, int h, unsigned char *pixels);
+
+	// Approximate video memory used by the texture, in bytes.
+	unsigned long getMemoryUsage() const { return bytes; }
+	// Core::getFrameNumber() when the texture was last applied.
+	unsigned int lastUseFrame;
+
+	// True if the image file's modification time or size differs from
+	// when the texture was loaded, e.g. a rewritten save slot screenshot.
+	bool isFileChanged();
 protected:
+	void onUnreferenced();
+	void updateMemoryUsage();
+	unsigned long bytes;
+	unsigned long fileTime, fileSize;
+
 	std::string loadName;
 	int layer;
 	// internal load functions
 	void loadPNG(const std::string &file);
+	bool loadDTX(const std::string &pngFile);
 	void loadTGA(const std::string &file);
 	
 	void loadBMP(const std::string &file);
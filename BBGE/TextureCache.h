@@ -0,0 +1,53 @@
+/*
+Copyright (C) 2007, 2010 - Bit-Blot
+
+This file is part of Aquaria.
+
+Aquaria is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+
+See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+*/
+#ifndef __texture_cache__
+#define __texture_cache__
+
+// File format for preprocessed desktop textures (*.dtx), written by the
+// pngtodtx tool next to the source PNG.  The pixel data is exactly what
+// glpng would produce when loading the PNG with PNG_ALPHA: gamma
+// corrected, resized to power-of-two dimensions, with the full chain of
+// box-filtered mipmaps down to 1x1 stored after the primary image in
+// decreasing size order.  Integers are stored in native byte order; the
+// magic and version fields will not match on a machine of the other
+// byte order, so such files are simply ignored.
+
+#define DTX_FILE_MAGIC    "DTX\012"
+#define DTX_FILE_VERSION  1
+
+typedef struct DTXFileHeader_ {
+	char magic[4];                  // File identifier (DTX_FILE_MAGIC)
+	unsigned short version;         // DTX_FILE_VERSION
+	unsigned char components;       // 3 = RGB, 4 = RGBA
+	unsigned char mipmaps;          // Number of mipmap levels, not
+	                                //    including the primary image
+	unsigned int width, height;     // Size of the source image
+	unsigned int data_width;        // Size of the primary image data
+	unsigned int data_height;       //    (always powers of two)
+	unsigned short empty_l;         // Number of transparent columns/rows
+	unsigned short empty_r;         //    on each edge of the source
+	unsigned short empty_t;         //    image, less a 1-pixel margin
+	unsigned short empty_b;
+	float gamma;                    // Screen gamma applied to the pixels
+	unsigned int pixels_offset;     // Offset of pixel data from file start
+} DTXFileHeader;
+
+#endif
@@ -428,6 +428,30 @@ Vector VectorPath::getValue(float percent)
 
 /*************************************************************************/
 
+unsigned int InterpolatedVector::frame = 1;
+int InterpolatedVector::numUpdated = 0;
+int InterpolatedVector::numUpdatedLastFrame = 0;
+
+int InterpolatedVector::getNumActive()
+{
+	return numUpdatedLastFrame;
+}
+
+void InterpolatedVector::newFrame()
+{
+	numUpdatedLastFrame = numUpdated;
+	numUpdated = 0;
+	if (++frame == 0)
+		frame = 1;
+}
+
+// Recompute data->active.  Call after changing any of the flags update()
+// looks at.
+void InterpolatedVector::updateActive()
+{
+	data->active = data->interpolating || data->followingPath || data->pendingInterpolation;
+}
+
 float InterpolatedVector::interpolateTo(Vector vec, float timePeriod, int loopType, bool pingPong, bool ease, InterpolateToFlag flag)
 {
 	if (timePeriod == 0)
@@ -472,6 +496,7 @@ float InterpolatedVector::interpolateTo(Vector vec, float timePeriod, int loopTy
 	}
 	else
 		data->pendingInterpolation = true;
+	updateActive();
 
 	return data->timePeriod;
 }
@@ -485,7 +510,10 @@ void InterpolatedVector::setInterpolationTrigger(InterpolatedVector *trigger, bo
 void InterpolatedVector::stop()
 {
 	if (data)
+	{
 		data->interpolating = false;
+		updateActive();
+	}
 }
 
 void InterpolatedVector::startPath(float time, float ease)
@@ -496,6 +524,7 @@ void InterpolatedVector::startPath(float time, float ease)
 	data->pathTimer = 0;
 	data->pathTime = time;
 	data->followingPath = true;
+	updateActive();
 	data->loopType = 0;
 	data->pingPong = false;
 	data->speedPath = false;
@@ -522,6 +551,7 @@ void InterpolatedVector::startSpeedPath(float speed)
 	data->pathTimer = 0;
 	data->pathSpeed = speed;
 	data->followingPath = true;
+	updateActive();
 	data->loopType = 0;	
 	data->pingPong = false;
 	data->speedPath = true;
@@ -531,13 +561,17 @@ void InterpolatedVector::startSpeedPath(float speed)
 void InterpolatedVector::stopPath()
 {
 	if (data)
+	{
 		data->followingPath = false;
+		updateActive();
+	}
 }
 
 void InterpolatedVector::resumePath()
 {
 	InterpolatedVectorData *data = ensureData();
 	data->followingPath = true;
+	updateActive();
 }
 
 void InterpolatedVector::updatePath(float dt)
@@ -700,6 +734,7 @@ void InterpolatedVector::doInterpolate(float dt)
 		}
 		else
 		{
+			updateActive();
 			data->endOfInterpolationEvent.call();
 			data->endOfInterpolationEvent.set(0);
 		}
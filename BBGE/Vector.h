@@ -464,6 +464,8 @@ struct InterpolatedVectorData
 		speedPath = false;
 		ease = false;
 		followingPath = false;
+		active = false;
+		updatedFrame = 0;
 	}
 
 	InterpolatedVector *trigger;
@@ -493,6 +495,9 @@ struct InterpolatedVectorData
 	bool speedPath;
 	bool ease;
 	bool followingPath;
+
+	bool active;  // Interpolating, following a path or waiting on a trigger
+	unsigned int updatedFrame;  // Last frame update() advanced this vector
 };
 
 
@@ -512,7 +517,10 @@ public:
 		y = vec.y;
 		z = vec.z;
 		if (vec.data)
+		{
 			data = new InterpolatedVectorData(*vec.data);
+			data->updatedFrame = 0;
+		}
 		else
 			data = NULL;
 	}
@@ -521,11 +529,28 @@ public:
 		x = vec.x;
 		y = vec.y;
 		z = vec.z;
-		delete data;
 		if (vec.data)
-			data = new InterpolatedVectorData(*vec.data);
+		{
+			// Reuse our existing block if we have one, so copying
+			// interpolation state (e.g. from particle bank templates)
+			// doesn't have to go through the allocator.
+			if (data)
+			{
+				const unsigned int updatedFrame = data->updatedFrame;
+				*data = *vec.data;
+				data->updatedFrame = updatedFrame;
+			}
+			else
+			{
+				data = new InterpolatedVectorData(*vec.data);
+				data->updatedFrame = 0;
+			}
+		}
 		else
+		{
+			delete data;
 			data = NULL;
+		}
 		return *this;
 	}
 
@@ -534,7 +559,7 @@ public:
 	float interpolateTo (Vector vec, float timePeriod, int loopType = 0, bool pingPong = false, bool ease = false, InterpolateToFlag flag = NONE);
 	void inline update(float dt)
 	{
-		if (!data)
+		if (!data || !data->active)
 			return;
 
 		if (data->pendingInterpolation && data->trigger)
@@ -547,6 +572,11 @@ public:
 			else
 				return;
 		}
+		if (data->updatedFrame != frame)
+		{
+			data->updatedFrame = frame;
+			numUpdated++;
+		}
 		if (isFollowingPath())
 		{
 			updatePath(dt);
@@ -597,6 +627,20 @@ public:
 			data = new InterpolatedVectorData;
 		return data;
 	}
+
+	// Number of vectors that update() advanced during the last frame.
+	// Vectors that were started but are never updated, such as the
+	// particle bank templates, don't count.
+	static int getNumActive();
+	// Call once at the start of each frame.
+	static void newFrame();
+
+private:
+	static unsigned int frame;
+	static int numUpdated, numUpdatedLastFrame;
+
+	// Idle vectors (the vast majority) cost one test per update.
+	void updateActive();
 };
 
 Vector getRotatedVector(const Vector &vec, float rot);
@@ -92,6 +92,19 @@ typedef struct {
 	unsigned char *Palette;
 } pngRawInfo;
 
+/* Image decoded by pngDecode(), ready to be handed to pngBindDecoded().
+ * Decoding does not touch OpenGL, so it may be done on a worker thread
+ * once pngPrepareDecode() has been called from the OpenGL thread. */
+typedef struct {
+	unsigned int Width;       /* Size of the source image */
+	unsigned int Height;
+	unsigned int Depth;
+	unsigned int DataWidth;   /* Size of Data (power of two) */
+	unsigned int DataHeight;
+	int Color;                /* PNG colour type of Data */
+	unsigned char *Data;
+} pngDecoded;
+
 extern int APIENTRY pngLoadRaw(const char *filename, pngRawInfo *rawinfo);
 extern int APIENTRY pngLoadRawF(FILE *file, pngRawInfo *rawinfo);
 
@@ -101,9 +114,16 @@ extern int APIENTRY pngLoadF(FILE *file, int mipmap, int trans, pngInfo *info);
 extern unsigned int APIENTRY pngBind(const char *filename, int mipmap, int trans, pngInfo *info, int wrapst, int minfilter, int magfilter);
 extern unsigned int APIENTRY pngBindF(FILE *file, int mipmap, int trans, pngInfo *info, int wrapst, int minfilter, int magfilter);
 
+extern void APIENTRY pngPrepareDecode(void);
+extern int APIENTRY pngDecode(const char *filename, int trans, pngDecoded *decoded);
+extern int APIENTRY pngDecodeF(FILE *file, int trans, pngDecoded *decoded);
+extern unsigned int APIENTRY pngBindDecoded(const pngDecoded *decoded, int mipmap, int trans, pngInfo *info, int wrapst, int minfilter, int magfilter);
+extern void APIENTRY pngFreeDecoded(pngDecoded *decoded);
+
 extern void APIENTRY pngSetStencil(unsigned char red, unsigned char green, unsigned char blue);
 extern void APIENTRY pngSetAlphaCallback(unsigned char (*callback)(unsigned char red, unsigned char green, unsigned char blue));
 extern void APIENTRY pngSetViewingGamma(double viewingGamma);
+extern double APIENTRY pngGetScreenGamma(void);
 extern void APIENTRY pngSetStandardOrientation(int standardorientation);
 
 #ifdef __cplusplus
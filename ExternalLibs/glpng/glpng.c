@@ -691,6 +691,193 @@ unsigned int APIENTRY pngBindF(FILE *file, int mipmap, int trans, pngInfo *info,
 	return 0;
 }
 
+/* Split loading: pngDecode() does everything pngLoad() does short of
+ * talking to OpenGL, and pngBindDecoded() uploads the result.  Only the
+ * PNG_SOLID, PNG_ALPHA and PNG_LUMINANCEALPHA transparency modes are
+ * supported, and paletted textures are always expanded. */
+
+void APIENTRY pngPrepareDecode(void) {
+	if (MaxTextureSize == 0)
+		glGetIntegerv(GL_MAX_TEXTURE_SIZE, &MaxTextureSize);
+	checkForGammaEnv();
+}
+
+int APIENTRY pngDecode(const char *filename, int trans, pngDecoded *decoded) {
+	int result;
+	FILE *fp = fopen(filename, "rb");
+	if (fp == NULL) return 0;
+
+	result = pngDecodeF(fp, trans, decoded);
+
+	if (fclose(fp) != 0) {
+		if (result) pngFreeDecoded(decoded);
+		return 0;
+	}
+
+	return result;
+}
+
+int APIENTRY pngDecodeF(FILE *fp, int trans, pngDecoded *decoded) {
+	unsigned char header[8];
+	png_structp png;
+	png_infop   info;
+	png_infop   endinfo;
+	png_bytep   data, data2;
+	png_bytep  *row_p;
+	double	fileGamma;
+
+	png_uint_32 width, height, rw, rh;
+	int depth, color;
+
+	png_uint_32 i;
+
+	if (decoded == NULL) return 0;
+	decoded->Data = NULL;
+
+	if (trans != PNG_SOLID && trans != PNG_ALPHA && trans != PNG_LUMINANCEALPHA) return 0;
+	if (MaxTextureSize == 0) return 0;  /* pngPrepareDecode() not called */
+
+	if (fread(header, 1, 8, fp) != 8) return 0;
+	if (!png_check_sig(header, 8)) return 0;
+
+	png = png_create_read_struct(PNG_LIBPNG_VER_STRING, NULL, NULL, NULL);
+	info = png_create_info_struct(png);
+	endinfo = png_create_info_struct(png);
+
+	if (setjmp(png->jmpbuf))
+	{
+		png_destroy_read_struct(&png, &info, &endinfo);
+		return 0;
+	}
+
+	png_init_io(png, fp);
+	png_set_sig_bytes(png, 8);
+	png_read_info(png, info);
+	png_get_IHDR(png, info, &width, &height, &depth, &color, NULL, NULL, NULL);
+
+	decoded->Width  = width;
+	decoded->Height = height;
+	decoded->Depth  = depth;
+
+	if (color == PNG_COLOR_TYPE_GRAY || color == PNG_COLOR_TYPE_GRAY_ALPHA)
+		png_set_gray_to_rgb(png);
+
+	if (color&PNG_COLOR_MASK_ALPHA && trans != PNG_ALPHA) {
+		png_set_strip_alpha(png);
+		color &= ~PNG_COLOR_MASK_ALPHA;
+	}
+
+	if (color == PNG_COLOR_TYPE_PALETTE)
+		png_set_expand(png);
+
+	/*--GAMMA--*/
+	if (png_get_gAMA(png, info, &fileGamma))
+		png_set_gamma(png, screenGamma, fileGamma);
+	else
+		png_set_gamma(png, screenGamma, 1.0/2.2);
+
+	png_read_update_info(png, info);
+
+	data = (png_bytep) malloc(png_get_rowbytes(png, info)*height);
+	row_p = (png_bytep *) malloc(sizeof(png_bytep)*height);
+
+	for (i = 0; i < height; i++) {
+		if (StandardOrientation)
+			row_p[height - 1 - i] = &data[png_get_rowbytes(png, info)*i];
+		else
+			row_p[i] = &data[png_get_rowbytes(png, info)*i];
+	}
+
+	png_read_image(png, row_p);
+	free(row_p);
+
+	rw = SafeSize(width), rh = SafeSize(height);
+
+	if (rw != width || rh != height) {
+		const int channels = png_get_rowbytes(png, info)/width;
+
+		data2 = (png_bytep) malloc(rw*rh*channels);
+		Resize(channels, data, width, height, data2, rw, rh);
+
+		width = rw, height = rh;
+		free(data);
+		data = data2;
+	}
+
+	png_read_end(png, endinfo);
+	png_destroy_read_struct(&png, &info, &endinfo);
+
+	decoded->DataWidth  = width;
+	decoded->DataHeight = height;
+	decoded->Color      = color;
+	decoded->Data       = data;
+
+	return 1;
+}
+
+unsigned int APIENTRY pngBindDecoded(const pngDecoded *decoded, int mipmap, int trans, pngInfo *pinfo, int wrapst, int minfilter, int magfilter) {
+	GLint pack, unpack;
+	GLenum glformat;
+	GLint glcomponent;
+	unsigned int id;
+
+	if (decoded == NULL || decoded->Data == NULL) return 0;
+
+	switch (decoded->Color) {
+		case PNG_COLOR_TYPE_GRAY:
+		case PNG_COLOR_TYPE_RGB:
+		case PNG_COLOR_TYPE_PALETTE:
+			glformat = GL_RGB;
+			glcomponent = 3;
+			break;
+
+		case PNG_COLOR_TYPE_GRAY_ALPHA:
+		case PNG_COLOR_TYPE_RGB_ALPHA:
+			glformat = GL_RGBA;
+			glcomponent = 4;
+			break;
+
+		default:
+			return 0;
+	}
+
+	if (trans == PNG_LUMINANCEALPHA)
+		glformat = GL_LUMINANCE_ALPHA;
+
+	id = SetParams(wrapst, magfilter, minfilter);
+	if (id == 0) return 0;
+
+	if (pinfo != NULL) {
+		pinfo->Width  = decoded->Width;
+		pinfo->Height = decoded->Height;
+		pinfo->Depth  = decoded->Depth;
+		pinfo->Alpha  = (glcomponent == 4) ? 8 : 0;
+	}
+
+	glGetIntegerv(GL_PACK_ALIGNMENT, &pack);
+	glGetIntegerv(GL_UNPACK_ALIGNMENT, &unpack);
+	glPixelStorei(GL_PACK_ALIGNMENT, 1);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
+	if (mipmap == PNG_BUILDMIPMAPS)
+		Build2DMipmaps(glcomponent, decoded->DataWidth, decoded->DataHeight, glformat, decoded->Data, 1);
+	else if (mipmap == PNG_SIMPLEMIPMAPS)
+		Build2DMipmaps(glcomponent, decoded->DataWidth, decoded->DataHeight, glformat, decoded->Data, 0);
+	else
+		glTexImage2D(GL_TEXTURE_2D, mipmap, glcomponent, decoded->DataWidth, decoded->DataHeight, 0, glformat, GL_UNSIGNED_BYTE, decoded->Data);
+
+	glPixelStorei(GL_PACK_ALIGNMENT, pack);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, unpack);
+
+	return id;
+}
+
+void APIENTRY pngFreeDecoded(pngDecoded *decoded) {
+	if (decoded == NULL) return;
+	free(decoded->Data);
+	decoded->Data = NULL;
+}
+
 void APIENTRY pngSetStencil(unsigned char red, unsigned char green, unsigned char blue) {
 	StencilRed = red, StencilGreen = green, StencilBlue = blue;
 }
@@ -713,6 +900,11 @@ void APIENTRY pngSetViewingGamma(double viewingGamma) {
 	}
 }
 
+double APIENTRY pngGetScreenGamma(void) {
+	checkForGammaEnv();
+	return screenGamma;
+}
+
 void APIENTRY pngSetStandardOrientation(int standardorientation) {
 	StandardOrientation = standardorientation;
 }
@@ -274,6 +274,52 @@ static int package_pkg_decompress(PackageModuleInfo *module,
     return result >= 0 && result <= outsize;
 }
 
+/*-----------------------------------------------------------------------*/
+
+/**
+ * package_pkg_decompress_state_size:  部分解凍に使う状態バッファのサイズを
+ * 返す。
+ *
+ * 【引　数】module: パッケージモジュール情報ポインタ
+ * 【戻り値】状態バッファの必要サイズ（バイト）
+ */
+static uint32_t package_pkg_decompress_state_size(PackageModuleInfo *module)
+{
+    return tinflate_state_size();
+}
+
+/*-----------------------------------------------------------------------*/
+
+/**
+ * package_pkg_decompress_partial:  圧縮データの一部分を解凍する。
+ *
+ * 【引　数】 module: パッケージモジュール情報ポインタ
+ * 　　　　　  state: 状態バッファ（最初の呼び出し前に0クリアしておく）
+ * 　　　　　     in: 入力（圧縮データ）バッファ
+ * 　　　　　 insize: 入力データ長（バイト）
+ * 　　　　　    out: 出力（元データ）バッファ
+ * 　　　　　outsize: 出力バッファサイズ（バイト）
+ * 【戻り値】0＝解凍完了、正数＝続きの入力データが必要、負数＝エラー
+ */
+static int package_pkg_decompress_partial(PackageModuleInfo *module,
+                                          void *state,
+                                          const void *in, uint32_t insize,
+                                          void *out, uint32_t outsize)
+{
+    PRECOND_SOFT(state != NULL, return -1);
+    PRECOND_SOFT(in != NULL, return -1);
+    PRECOND_SOFT(out != NULL, return -1);
+
+    unsigned long size;
+    const int result = tinflate_partial(in, insize, out, outsize, &size,
+                                        NULL, state, tinflate_state_size());
+    if (result == 0 && size != outsize) {
+        DMSG("Size mismatch: got %lu, expected %u", size, outsize);
+        return -1;
+    }
+    return result;
+}
+
 /*************************************************************************/
 /********************** パッケージモジュールデータ ***********************/
 /*************************************************************************/
@@ -293,15 +339,17 @@ static int package_aquaria_has_path(PackageModuleInfo *module, const char *path)
 /*-----------------------------------------------------------------------*/
 
 PackageModuleInfo package_info_aquaria = {
-    .prefix           = "",  // 全てのファイルに適用
-    .init             = package_pkg_init,
-    .cleanup          = package_pkg_cleanup,
-    .list_files_start = package_pkg_list_files_start,
-    .list_files_next  = package_pkg_list_files_next,
-    .has_path         = package_aquaria_has_path,
-    .file_info        = package_pkg_file_info,
-    .decompress       = package_pkg_decompress,
-    .module_data      = &aquaria_pkg,
+    .prefix                = "",  // 全てのファイルに適用
+    .init                  = package_pkg_init,
+    .cleanup               = package_pkg_cleanup,
+    .list_files_start      = package_pkg_list_files_start,
+    .list_files_next       = package_pkg_list_files_next,
+    .has_path              = package_aquaria_has_path,
+    .file_info             = package_pkg_file_info,
+    .decompress            = package_pkg_decompress,
+    .decompress_state_size = package_pkg_decompress_state_size,
+    .decompress_partial    = package_pkg_decompress_partial,
+    .module_data           = &aquaria_pkg,
 };
 
 /*************************************************************************/
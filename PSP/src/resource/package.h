@@ -11,10 +11,13 @@
  * るとき、パス名に対応したモジュールを検索し、そのモジュールの操作関数によ
  * ってデータをロードする。
  *
- * 圧縮データの場合、データがすべてロードされた後、別関数で圧縮を解除する。
- * CPUの処理能力が十分にある場合、読み込み中から部分的に解除していくことも
- * できるが、特にPSPの場合はフレームレートに影響する可能性を無視できないの
- * でこの方式は採らない。
+ * 圧縮データの場合、モジュールが部分解凍関数（decompress_state_size・
+ * decompress_partial）を実装していれば、データを一定サイズのチャンク単位で
+ * 読み込み、読み込みが完了したチャンクから順次解凍していく。次のチャンクの
+ * 読み込みは解凍前に開始するので、読み込みと解凍が並行して行われる。また、
+ * 非同期のresource_sync()では1回の呼び出しにつき1チャンクしか解凍しない
+ * ため、1フレームあたりの処理時間が抑えられる。部分解凍関数がない場合は、
+ * データがすべてロードされた後、decompress関数で一括して圧縮を解除する。
  */
 
 #ifndef RESOURCE_PACKAGE_H
@@ -109,6 +112,33 @@ typedef int (*PackageDecompressFunc)(PackageModuleInfo *module,
                                      const void *in, uint32_t insize,
                                      void *out, uint32_t outsize);
 
+/**
+ * PackageDecompressStateSizeFunc:  部分解凍に使う状態バッファのサイズを
+ * 返す。
+ *
+ * 【引　数】module: パッケージモジュール情報ポインタ
+ * 【戻り値】状態バッファの必要サイズ（バイト、0＝部分解凍不可）
+ */
+typedef uint32_t (*PackageDecompressStateSizeFunc)(PackageModuleInfo *module);
+
+/**
+ * PackageDecompressPartialFunc:  圧縮データの一部分を解凍する。同じデータに
+ * 対して、圧縮データを先頭から順番に分割して渡し、解凍完了またはエラーまで
+ * 繰り返し呼び出す。出力バッファは毎回同じものを渡す。
+ *
+ * 【引　数】 module: パッケージモジュール情報ポインタ
+ * 　　　　　  state: 状態バッファ（最初の呼び出し前に0クリアしておく）
+ * 　　　　　     in: 入力（圧縮データ）バッファ
+ * 　　　　　 insize: 入力データ長（バイト）
+ * 　　　　　    out: 出力（元データ）バッファ
+ * 　　　　　outsize: 出力バッファサイズ（バイト）
+ * 【戻り値】0＝解凍完了、正数＝続きの入力データが必要、負数＝エラー
+ */
+typedef int (*PackageDecompressPartialFunc)(PackageModuleInfo *module,
+                                            void *state,
+                                            const void *in, uint32_t insize,
+                                            void *out, uint32_t outsize);
+
 /*************************************************************************/
 /******************** パッケージモジュール情報構造体 *********************/
 /*************************************************************************/
@@ -130,6 +160,9 @@ struct PackageModuleInfo_ {
     PackageHasPathFunc has_path; // NULL可（NULLの場合、戻り値が0以外とみなす）
     PackageFileInfoFunc file_info;
     PackageDecompressFunc decompress;
+    /* 部分解凍関数（NULL可。NULLの場合、decompressで一括解凍する） */
+    PackageDecompressStateSizeFunc decompress_state_size;
+    PackageDecompressPartialFunc decompress_partial;
 
     /* モジュール用データポインタ（任意。内部データなどに使える） */
     void *module_data;
@@ -27,6 +27,12 @@
  * 新たにできたエントリーを利用する。この際、管理データが長時間メモリに残る
  * と想定されるため、MEM_ALLOC_TEMPとMEM_ALLOC_TOPフラグを指定し、通常メモリ
  * プールの断片化をなるべく避ける。
+ *
+ * パッケージ内の圧縮データは、パッケージモジュールが部分解凍に対応していれ
+ * ば、STREAM_CHUNK_SIZEバイトずつ2つのバッファに交互に読み込み、読み込みが
+ * 完了したチャンクから解凍していく（update_load()を参照）。解凍前に次の
+ * チャンクの読み込みを開始するので、読み込みと解凍が並行して行われ、圧縮
+ * データ全体を格納するバッファも不要になる。
  */
 
 #include "../common.h"
@@ -79,6 +85,9 @@ static PackageModuleInfo * const packages[] = {
 /* 現在ファイルリスト取得中のパッケージ（NULL＝なし） */
 static PackageModuleInfo *filelist_package;
 
+/* 圧縮データをストリーミング解凍する際の読み込み単位（バイト） */
+#define STREAM_CHUNK_SIZE  32768
+
 /*-----------------------------------------------------------------------*/
 
 /* リソースの種類 */
@@ -98,6 +107,8 @@ typedef struct LoadInfo_ {
     /* ロード関連フラグ */
     uint8_t need_close;   // 1＝ロード後、ファイルをクローズする
     uint8_t need_finish;  // 1＝読み込み完了、最終処理待ち
+    uint8_t load_failed;  // 1＝読み込みまたは圧縮解除に失敗した
+    uint8_t stream_chunk; // 読み込み中のチャンクバッファ（0または1）
     /* メモリアライメント */
     uint16_t mem_align;
     /* メモリ確保フラグ */
@@ -112,6 +123,14 @@ typedef struct LoadInfo_ {
     uint32_t compressed_size, data_size;
     /* 読み込み要求識別子 */
     int32_t read_request;
+    /* ストリーミング解凍用バッファ（NULL＝ストリーミングなし）。先頭に
+     * 解凍状態（stream_state_sizeバイト）、その後にstream_chunk_sizeバイト
+     * の読み込みバッファが2つ（圧縮データが1チャンク以下の場合は1つ）続く */
+    void *stream_buffer;
+    uint32_t stream_state_size, stream_chunk_size;
+    /* パッケージファイル内の圧縮データ開始位置、読み込み要求済みのデータ量、
+     * 読み込み中のチャンクのサイズ（いずれもバイト） */
+    uint32_t stream_start, stream_read, stream_len;
     /* 関連パッケージの情報構造体 */
     PackageModuleInfo *pkginfo;
     /* 読み込みファイルポインタ（パッケージまたは通常ファイル） */
@@ -209,6 +228,8 @@ static int load_from_package(ResourceInfo *resinfo, const char *path
                              __DEBUG_PARAMS);
 static int load_from_file(ResourceInfo *resinfo, const char *path
                           __DEBUG_PARAMS);
+static int start_chunk_read(LoadInfo *load_info);
+static int update_load(ResourceInfo *resinfo, int wait);
 static void finish_load(ResourceInfo *resinfo __DEBUG_PARAMS);
 
 /*************************************************************************/
@@ -696,11 +717,7 @@ int resource_sync(ResourceManager *resmgr, int mark __DEBUG_PARAMS)
             if (load_info && !load_info->need_finish
              && private->resources[index].mark - mark < 0 // 注：単純比較はダメ
             ) {
-                if (!sys_file_poll_async(load_info->read_request)) {
-                    sys_file_wait_async(load_info->read_request);
-                    load_info->read_request = 0;
-                    load_info->need_finish = 1;
-                } else {
+                if (!update_load(&private->resources[index], 0)) {
                     return 0;
                 }
             }
@@ -748,9 +765,7 @@ extern void resource_wait(ResourceManager *resmgr, int mark __DEBUG_PARAMS)
             if (load_info && !load_info->need_finish
              && private->resources[index].mark - mark < 0 // 注：単純比較はダメ
             ) {
-                sys_file_wait_async(load_info->read_request);
-                load_info->read_request = 0;
-                load_info->need_finish = 1;
+                update_load(&private->resources[index], 1);
             }
         }
     }
@@ -1380,6 +1395,7 @@ static void free_resource(ResourceInfo *resinfo __DEBUG_PARAMS)
                 sys_file_wait_async(resinfo->load_info->read_request);
             }
             /* すぐに解放するのでfinish_load()を呼び出す必要はない */
+            mem_free(resinfo->load_info->stream_buffer);
             mem_free(resinfo->load_info->file_data);
             mem_free(resinfo->load_info);
             resinfo->load_info = NULL;
@@ -1445,26 +1461,70 @@ static int load_from_package(ResourceInfo *resinfo, const char *path
         len = size;
     }
 
+    /* 部分解凍に対応していれば、圧縮データをストリーミング解凍する */
+    uint32_t state_size = 0;
+    if (compressed && pkginfo->decompress_state_size
+     && pkginfo->decompress_partial
+    ) {
+        state_size = (*pkginfo->decompress_state_size)(pkginfo);
+    }
+
     void *data;
-    if (compressed) {
+    if (compressed && !state_size) {
         /* MEM_ALLOC_TOPを反転することでメモリ断片化を回避。また、一時メモリ
          * のため、デバッグ有効時は呼び出し元ではなくこのファイルのものとして
          * 登録する */
         data = mem_alloc(len, 0, load_info->mem_flags ^ MEM_ALLOC_TOP);
     } else {
-        data = debug_mem_alloc(len, load_info->mem_align, load_info->mem_flags,
-                               file, line, resinfo->load_info->mem_type);
+        /* ストリーミング時は解凍先の最終バッファを先に確保する */
+        data = debug_mem_alloc(size, load_info->mem_align,
+                               load_info->mem_flags, file, line,
+                               resinfo->load_info->mem_type);
     }
     if (UNLIKELY(!data)) {
         DMSG("%s: Out of memory", path);
         return -1;
     }
 
-    load_info->read_request = sys_file_read_async(fp, data, len, pos);
-    if (UNLIKELY(!load_info->read_request)) {
-        DMSG("%s: Failed to read %u from %u in package file", path, len, pos);
-        mem_free(data);
-        return -1;
+    if (state_size) {
+        /* 状態バッファと読み込みバッファは一時メモリなので、上記と同様に
+         * MEM_ALLOC_TOPを反転して確保する */
+        const uint32_t chunk_size = ubound(len, STREAM_CHUNK_SIZE);
+        const uint32_t num_chunks = (len > chunk_size) ? 2 : 1;
+        state_size = align_up(state_size, 64);
+        load_info->stream_buffer = mem_alloc(
+            state_size + chunk_size * num_chunks, 64,
+            load_info->mem_flags ^ MEM_ALLOC_TOP
+        );
+        if (UNLIKELY(!load_info->stream_buffer)) {
+            DMSG("%s: Out of memory for stream buffer", path);
+            mem_free(data);
+            return -1;
+        }
+        mem_clear(load_info->stream_buffer, state_size);
+        load_info->stream_state_size = state_size;
+        load_info->stream_chunk_size = chunk_size;
+        load_info->stream_start      = pos;
+        load_info->stream_read       = 0;
+        load_info->stream_chunk      = 0;
+        load_info->compressed_size   = len;
+        load_info->fp                = fp;
+        if (UNLIKELY(!start_chunk_read(load_info))) {
+            DMSG("%s: Failed to read %u from %u in package file", path,
+                 load_info->stream_len, pos);
+            mem_free(load_info->stream_buffer);
+            load_info->stream_buffer = NULL;
+            mem_free(data);
+            return -1;
+        }
+    } else {
+        load_info->read_request = sys_file_read_async(fp, data, len, pos);
+        if (UNLIKELY(!load_info->read_request)) {
+            DMSG("%s: Failed to read %u from %u in package file", path, len,
+                 pos);
+            mem_free(data);
+            return -1;
+        }
     }
 
     load_info->compressed      = compressed;
@@ -1532,6 +1592,134 @@ static int load_from_file(ResourceInfo *resinfo, const char *path
 
 /*-----------------------------------------------------------------------*/
 
+/**
+ * start_chunk_read:  ストリーミング解凍において、次のチャンクの読み込みを
+ * load_info->stream_chunkが示すバッファに開始する。
+ *
+ * 【引　数】load_info: ロード情報構造体
+ * 【戻り値】0以外＝成功、0＝失敗
+ */
+static int start_chunk_read(LoadInfo *load_info)
+{
+    PRECOND_SOFT(load_info != NULL, return 0);
+    PRECOND_SOFT(load_info->stream_buffer != NULL, return 0);
+    PRECOND_SOFT(load_info->stream_read < load_info->compressed_size,
+                 return 0);
+
+    uint8_t *buffer = (uint8_t *)load_info->stream_buffer
+                    + load_info->stream_state_size
+                    + load_info->stream_chunk * load_info->stream_chunk_size;
+    load_info->stream_len = ubound(
+        load_info->compressed_size - load_info->stream_read,
+        load_info->stream_chunk_size
+    );
+    load_info->read_request = sys_file_read_async(
+        load_info->fp, buffer, load_info->stream_len,
+        load_info->stream_start + load_info->stream_read
+    );
+    if (UNLIKELY(!load_info->read_request)) {
+        return 0;
+    }
+    load_info->stream_read += load_info->stream_len;
+    return 1;
+}
+
+/*-----------------------------------------------------------------------*/
+
+/**
+ * update_load:  読み込み中のリソースの状態を確認し、読み込みが完了していれ
+ * ばneed_finishを設定する。ストリーミング解凍の場合は、読み込みが完了した
+ * チャンクについて次のチャンクの読み込みを開始してから解凍を行い、全データ
+ * の解凍が完了（または失敗）した時点でneed_finishを設定する。
+ *
+ * waitが0の場合、1回の呼び出しで解凍するのは最大1チャンクとし、フレーム
+ * 処理への影響を抑える。
+ *
+ * 【引　数】resinfo: リソース情報構造体
+ * 　　　　　   wait: 0以外＝読み込み完了まで待つ、0＝待たない
+ * 【戻り値】0以外＝読み込み完了（最終処理待ち）、0＝読み込み中
+ */
+static int update_load(ResourceInfo *resinfo, int wait)
+{
+    PRECOND_SOFT(resinfo != NULL, return 1);
+    PRECOND_SOFT(resinfo->load_info != NULL, return 1);
+    LoadInfo *load_info = resinfo->load_info;
+
+    if (!load_info->stream_buffer) {
+        if (!wait && sys_file_poll_async(load_info->read_request)) {
+            return 0;
+        }
+        sys_file_wait_async(load_info->read_request);
+        load_info->read_request = 0;
+        load_info->need_finish = 1;
+        return 1;
+    }
+
+    do {
+        if (!wait && sys_file_poll_async(load_info->read_request)) {
+            return 0;
+        }
+        const int32_t nread = sys_file_wait_async(load_info->read_request);
+        load_info->read_request = 0;
+        const uint32_t chunk_len = load_info->stream_len;
+        if (UNLIKELY(nread != chunk_len)) {
+            DMSG("%s: Read error at %u (got %d of %u bytes)",
+                 resinfo->debug_path, load_info->stream_read - chunk_len,
+                 nread, chunk_len);
+            goto fail;
+        }
+        const uint8_t *chunk =
+            (const uint8_t *)load_info->stream_buffer
+            + load_info->stream_state_size
+            + load_info->stream_chunk * load_info->stream_chunk_size;
+
+        /* 解凍中に読み込みが進むよう、先に次のチャンクの読み込みを開始する */
+        if (load_info->stream_read < load_info->compressed_size) {
+            load_info->stream_chunk ^= 1;
+            if (UNLIKELY(!start_chunk_read(load_info))) {
+                DMSG("%s: Failed to read %u from %u in package file",
+                     resinfo->debug_path, load_info->stream_len,
+                     load_info->stream_start + load_info->stream_read);
+                goto fail;
+            }
+        }
+
+        const int result = (*load_info->pkginfo->decompress_partial)(
+            load_info->pkginfo, load_info->stream_buffer, chunk, chunk_len,
+            load_info->file_data, load_info->data_size
+        );
+        if (result == 0) {
+            goto done;
+        } else if (UNLIKELY(result < 0)) {
+            DMSG("%s: Decompression failed", resinfo->debug_path);
+            goto fail;
+        } else if (UNLIKELY(!load_info->read_request)) {
+            DMSG("%s: Compressed data is truncated", resinfo->debug_path);
+            goto fail;
+        }
+    } while (wait);
+
+    return 0;
+
+  fail:
+    load_info->load_failed = 1;
+  done:
+    /* 圧縮データの末尾（チェックサム等）を読み込み中の場合もあるので、
+     * 読み込みを中止してからバッファを解放する */
+    if (load_info->read_request) {
+        sys_file_abort_async(load_info->read_request);
+        sys_file_wait_async(load_info->read_request);
+        load_info->read_request = 0;
+    }
+    mem_free(load_info->stream_buffer);
+    load_info->stream_buffer = NULL;
+    load_info->compressed = 0;
+    load_info->need_finish = 1;
+    return 1;
+}
+
+/*-----------------------------------------------------------------------*/
+
 /**
  * finish_load:  読み込みが完了したリソースの最終処理（圧縮解除等）を行う。
  * 読み込みが完了・成功したことが前提。
@@ -1553,6 +1741,12 @@ static void finish_load(ResourceInfo *resinfo __DEBUG_PARAMS)
         load_info->need_close = 0;
     }
 
+    /* ストリーミング解凍に失敗した場合は、データを破棄する */
+    if (load_info->load_failed) {
+        mem_free(load_info->file_data);
+        goto free_and_return;
+    }
+
     /* 圧縮を解凍する */
     if (load_info->compressed && load_info->pkginfo) {
         void *newdata = debug_mem_alloc(
@@ -18,6 +18,22 @@
  *
  * Version history:
  *
+ * Version 1.4, 2026-10-18
+ *   - Replaced the bit-by-bit Huffman tree walk with multi-level lookup
+ *     tables (9-bit first level for literals/lengths, 6-bit for
+ *     distances, with second-level subtables for longer codes).
+ *   - Widened the bit accumulator to 64 bits and added a fast decoding
+ *     loop which refills it several bytes at a time while enough input
+ *     and output space remain.
+ *   - The CRC is now computed eight bytes at a time ("slicing-by-8")
+ *     over completed output, and only when the caller requests it.
+ *   - Dynamic blocks declaring more than 286 literal/length codes or 30
+ *     distance codes are rejected, as in zlib.
+ *   - Fixed a bug in which a repeated string could be written past the
+ *     end of the output buffer if the buffer had already overflowed.
+ *   - Increased the size of the state buffer (and stack usage of
+ *     tinflate()) to around 4k.
+ *
  * Version 1.3a, 2010-03-26
  *   - Minor comment clarifications and whitespace cleanup; no functional
  *     changes.
@@ -48,12 +64,10 @@
  *
  * This file implements a simple, portable decompressor for the "deflate"
  * compression algorithm, as specified in RFC 1951.  The decompressor is
- * designed to be both independent of external libraries and as compact as
- * possible: it uses only around 2k of stack space (on the Intel x86
- * platform; other platforms may differ), and it does not require dynamic
- * memory management functions such as malloc() to be available.  Because
- * of this emphasis on size, however, the decompressor is not as fast as
- * other implementations, such as that in the "zlib" library.
+ * designed to be both independent of external libraries and compact: it
+ * uses only around 4k of stack space (on the Intel x86 platform; other
+ * platforms may differ), and it does not require dynamic memory
+ * management functions such as malloc() to be available.
  *
  * To decompress a stream of data compressed with the "deflate" algorithm,
  * call:
@@ -144,6 +158,54 @@
 # define UNLIKELY(x) (x)
 #endif
 
+/*
+ * Huffman codes are decoded by table lookup.  Each table consists of a
+ * first-level table indexed by the next ROOT_BITS bits of the stream
+ * (in stream order, i.e. with the first bit of the code in the lowest
+ * index bit), followed by any second-level subtables needed for codes
+ * longer than ROOT_BITS.  Each table entry is a 16-bit value which is
+ * either:
+ *    - a terminal entry: bits 4-14 hold the symbol and bits 0-3 hold the
+ *      total length of the code in bits; or
+ *    - a subtable link (first-level tables only): bit 15 is set, bits
+ *      4-14 hold the index of the subtable within the table array, and
+ *      bits 0-3 hold the number of additional bits used to index the
+ *      subtable.
+ * Table slots which do not correspond to any code (which only occur in
+ * tables with no symbols) hold a 1-bit entry for HUFF_INVALID_SYMBOL, so
+ * that the decoder's range check on the symbol rejects them.
+ *
+ * The table sizes below are the worst cases for the given alphabet sizes
+ * and first-level widths, as computed by the "enough" utility from zlib;
+ * gen_huffman_table() still checks for overflow.
+ */
+#define LITERAL_ROOT_BITS    9
+#define LITERAL_TABLE_SIZE   852
+#define DISTANCE_ROOT_BITS   6
+#define DISTANCE_TABLE_SIZE  592
+#define CODELEN_ROOT_BITS    7   // Code length codes are at most 7 bits.
+#define CODELEN_TABLE_SIZE   (1 << CODELEN_ROOT_BITS)
+
+#define HUFF_SUBTABLE           0x8000
+#define HUFF_ENTRY(symbol,len)  ((unsigned short)((symbol) << 4 | (len)))
+#define HUFF_LINK(index,bits)   ((unsigned short)(HUFF_SUBTABLE | (index) << 4 | (bits)))
+#define HUFF_SYMBOL(entry)      ((entry) >> 4)
+#define HUFF_LENGTH(entry)      ((entry) & 0xF)
+#define HUFF_SUB_INDEX(entry)   (((entry) >> 4) & 0x7FF)
+#define HUFF_SUB_BITS(entry)    ((entry) & 0xF)
+#define HUFF_INVALID_SYMBOL     0x7FF
+
+/*
+ * The fast decoding loop in tinflate_block() reads input eight bytes at a
+ * time and writes up to one maximum-length string (plus up to 7 bytes of
+ * slack from 8-byte copies) without checking for buffer space, so it is
+ * only used while at least this much input and output space remains.
+ * One refill leaves at least 56 bits in the accumulator, which is enough
+ * for a complete length/distance pair (15+5+15+13 = 48 bits).
+ */
+#define FAST_INPUT_MIN   8
+#define FAST_OUTPUT_MIN  (258+7)
+
 /* Structure of the decompression state buffer: */
 typedef struct DecompressionState_ {
     /* state: Parsing state.  Used to resume processing at the appropriate
@@ -179,10 +241,15 @@ typedef struct DecompressionState_ {
     /* out_size: Total number of bytes in the output buffer. */
     unsigned long out_size;
 
-    /* crc: Current CRC value. */
+    /* crc: CRC value of the first crc_ofs bytes of output. */
     unsigned long crc;
-    /* bit_accum: Bit accumulator. */
-    unsigned long bit_accum;
+    /* crc_ofs: Number of output bytes included in "crc".  The CRC is
+     * brought up to date only when the caller asks for it (or when output
+     * overflows the buffer). */
+    unsigned long crc_ofs;
+    /* bit_accum: Bit accumulator.  Bits above the lowest "num_bits" bits
+     * are either zero or a copy of the input bits which follow. */
+    uint64_t bit_accum;
     /* num_bits: Number of valid bits in accumulator. */
     unsigned int num_bits;
     /* final: Nonzero to indicate that the current block is the last one. */
@@ -206,27 +273,15 @@ typedef struct DecompressionState_ {
     /* nread: Number of bytes copied from an uncompressed block. */
     unsigned int nread;
 
-    /* literal_table: Code-to-symbol conversion table for the alphabet used
-     * for literals and length values.  Elements 0 and 1 correspond to a
-     * one-bit code of 0 or 1, respectively; other elements are linked
-     * (directly or indirectly) from these to represent the Huffman tree.
-     * The value of each element is:
-     *    - for terminal codes, the symbol corresponding to the code (a
-     *      nonnegative value);
-     *    - for nonterminal codes, the one's complement of the array index
-     *      corresponding to the code with a zero appended (the following
-     *      array element corresponds to the code with a one appended).
-     * For an alphabet of N symbols, a Huffman tree will have N-1 non-leaf
-     * nodes (including the root node, which is not represented in the
-     * array).  In the case of the literal/length alphabet, there are
-     * normally 286 symbols; however, the default (static) Huffman table
-     * uses a 288-symbol alphabet with two unused symbols, so we reserve
-     * enough space for that alphabet. */
-    short literal_table[288*2-2];
-    /* distance_table: Code-to-symbol conversion table for the alphabet
-     * used for distances.  This alphabet consists of 32 symbols, 2 of
-     * which are unused. */
-    short distance_table[32*2-2];
+    /* literal_table: Lookup table for the alphabet used for literals and
+     * length values, in the format described at the top of this file.
+     * In the case of the literal/length alphabet, there are normally 286
+     * symbols; however, the default (static) Huffman table uses a
+     * 288-symbol alphabet with two unused symbols. */
+    unsigned short literal_table[LITERAL_TABLE_SIZE];
+    /* distance_table: Lookup table for the alphabet used for distances.
+     * This alphabet consists of 32 symbols, 2 of which are unused. */
+    unsigned short distance_table[DISTANCE_TABLE_SIZE];
     /* literal_count: Number of literal codes in the Huffman table (HLIT in
      * RFC 1951). */
     unsigned int literal_count;
@@ -236,9 +291,8 @@ typedef struct DecompressionState_ {
     /* codelen_count: Number of code length codes in the Huffman table used
      * for decompressing the main Huffman tables (HCLEN in RFC 1591). */
     unsigned int codelen_count;
-    /* codelen_table: Code-to-symbol conversion table for the alphabet used
-     * for code lengths. */
-    short codelen_table[19*2-2];
+    /* codelen_table: Lookup table for the alphabet used for code lengths. */
+    unsigned short codelen_table[CODELEN_TABLE_SIZE];
     /* literal_len, distance_len, codelen_len: Code length of the code for
      * each symbol in each alphabet. */
     unsigned char literal_len[288], distance_len[32], codelen_len[19];
@@ -249,7 +303,33 @@ typedef struct DecompressionState_ {
 static int tinflate_block(DecompressionState *state);
 static int gen_huffman_table(int symbols,
                              const unsigned char *lengths,
-                             short *table);
+                             int root_bits,
+                             unsigned short *table,
+                             int table_size);
+static void update_crc(DecompressionState *state);
+static void crc_discarded_byte(DecompressionState *state,
+                               unsigned long out_ofs, unsigned char byte);
+static void init_crc32_tables(void);
+
+/* Base values and extra bit counts for length symbols 257-285 and
+ * distance symbols 0-29: */
+static const unsigned short length_base[29] = {
+    3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+    35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258
+};
+static const unsigned char length_extra[29] = {
+    0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+    3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0
+};
+static const unsigned short distance_base[30] = {
+    1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+    257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145,
+    8193, 12289, 16385, 24577
+};
+static const unsigned char distance_extra[30] = {
+    0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+    7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13
+};
 
 /* CRC-32 lookup table: */
 static const unsigned long crc32_table[256] = {
@@ -307,6 +387,14 @@ static const unsigned long crc32_table[256] = {
     0x2D02EF8DUL
 };
 
+/* Additional CRC-32 tables for processing eight bytes at a time:
+ * crc32_slice[n][i] is the CRC register after processing byte i followed
+ * by n+1 zero bytes.  These are generated from crc32_table[] on first
+ * use.  (Concurrent first calls may both generate the tables, but they
+ * write identical values, so this is harmless.) */
+static uint32_t crc32_slice[7][256];
+static int crc32_slice_ready;
+
 /*************************************************************************/
 /*************************************************************************/
 
@@ -376,6 +464,7 @@ long tinflate(const void *compressed_data, long compressed_size,
     state.state     = INVALID;
     state.out_ofs   = 0;
     state.crc       = 0;
+    state.crc_ofs   = 0;
     state.bit_accum = 0;
     state.num_bits  = 0;
     state.final     = 0;
@@ -485,10 +574,17 @@ int tinflate_partial(const void *compressed_data, long compressed_size,
     }
 
     /**** Decompress blocks until either the end of the compressed ****
-     **** data is reached or a block with the "final" bit is set.  ****/
+     **** data is reached or a block with the "final" bit is set.  ****
+     **** (Input may remain in the bit accumulator after the input  ****
+     **** buffer itself has been used up.)                          ****/
 
-    while (state->in_ptr < state->in_top) {
+    while (state->in_ptr < state->in_top || state->num_bits > 0) {
         int res = tinflate_block(state);
+        /* Bring the CRC up to date while the block's output is still
+         * likely to be in the cache. */
+        if (crc_ret) {
+            update_crc(state);
+        }
         if (res != 0) {
             return res;
         }
@@ -518,6 +614,7 @@ int tinflate_partial(const void *compressed_data, long compressed_size,
         *size_ret = state->out_ofs;
     }
     if (crc_ret) {
+        update_crc(state);
         *crc_ret = state->crc;
     }
     return 0;
@@ -546,13 +643,9 @@ static int tinflate_block(DecompressionState *state)
           unsigned char *out_base  = (state != NULL ? state->out_base  : NULL);
           unsigned long  out_ofs   = (state != NULL ? state->out_ofs   : 0);
           unsigned long  out_size  = (state != NULL ? state->out_size  : 0);
-          unsigned long  bit_accum = (state != NULL ? state->bit_accum : 0);
+          uint64_t       bit_accum = (state != NULL ? state->bit_accum : 0);
           unsigned int   num_bits  = (state != NULL ? state->num_bits  : 0);
 
-    /* icrc: Inverted (one's-complement) value of the running CRC for the
-     * stream. */
-    unsigned long icrc = ~(state != NULL ? state->crc : 0);
-
     /********************************/
 
     /* The GETBITS macro retrieves the specified number of bits (n) from
@@ -567,79 +660,102 @@ static int tinflate_block(DecompressionState *state)
             if (in_ptr >= in_top) {                             \
                 goto out_of_data;                               \
             }                                                   \
-            bit_accum |= ((unsigned long) *in_ptr) << num_bits; \
+            bit_accum |= ((uint64_t) *in_ptr) << num_bits;      \
             num_bits += 8;                                      \
             in_ptr++;                                           \
         }                                                       \
-        var = bit_accum & ((1UL << __n) - 1);                   \
+        var = (unsigned int)bit_accum & ((1UL << __n) - 1);     \
         bit_accum >>= __n;                                      \
         num_bits -= __n;                                        \
     } while (0)
 
+    /* The LOOKUP macro looks up the Huffman table entry (var) for the
+     * code at the bottom of the bit accumulator in the given table (table)
+     * with the given first-level size (root_bits).  The entry may be for
+     * a code longer than the number of valid bits in the accumulator. */
+#define LOOKUP(var,table,root_bits)                                     \
+    do {                                                                \
+        var = (table)[(unsigned int)bit_accum & ((1U<<(root_bits))-1)]; \
+        if (UNLIKELY(var & HUFF_SUBTABLE)) {                            \
+            var = (table)[HUFF_SUB_INDEX(var)                           \
+                          + ((unsigned int)(bit_accum >> (root_bits))   \
+                             & ((1U << HUFF_SUB_BITS(var)) - 1))];      \
+        }                                                               \
+    } while (0)
+
     /* The GETHUFF macro retrieves enough bits from the block to form a
-     * Huffman code according to the given Huffman table (table), storing
-     * the corresponding symbol into the given variable (var). */
-#define GETHUFF(var,table)                              \
+     * Huffman code according to the given Huffman table (table, with
+     * first-level size root_bits), storing the corresponding symbol into
+     * the given variable (var).  Since unloaded bits in the accumulator
+     * are either zero or correct, an entry whose length fits within the
+     * loaded bits is always the right one; otherwise we load another byte
+     * and try again. */
+#define GETHUFF(var,table,root_bits)                            \
+    do {                                                        \
+        unsigned int __entry;                                   \
+        for (;;) {                                              \
+            LOOKUP(__entry, (table), (root_bits));              \
+            if (LIKELY(HUFF_LENGTH(__entry) <= num_bits)) {     \
+                break;                                          \
+            }                                                   \
+            if (in_ptr >= in_top) {                             \
+                goto out_of_data;                               \
+            }                                                   \
+            bit_accum |= ((uint64_t) *in_ptr) << num_bits;      \
+            num_bits += 8;                                      \
+            in_ptr++;                                           \
+        }                                                       \
+        bit_accum >>= HUFF_LENGTH(__entry);                     \
+        num_bits -= HUFF_LENGTH(__entry);                       \
+        var = HUFF_SYMBOL(__entry);                             \
+    } while (0)
+
+    /* The REFILL macro fills the bit accumulator with as many whole bytes
+     * as will fit, leaving at least 56 valid bits.  The caller must ensure
+     * that at least 8 bytes of input remain.  Bytes which only partly fit
+     * are not counted as consumed, but their leading bits are left in the
+     * accumulator (see the bit_accum field description). */
+#ifdef IS_LITTLE_ENDIAN
+# define LOAD64(ptr)  (memcpy(&__word, (ptr), 8), __word)
+#else
+# define LOAD64(ptr)  ((uint64_t)(ptr)[0]       | (uint64_t)(ptr)[1] <<  8 \
+                       | (uint64_t)(ptr)[2] << 16 | (uint64_t)(ptr)[3] << 24 \
+                       | (uint64_t)(ptr)[4] << 32 | (uint64_t)(ptr)[5] << 40 \
+                       | (uint64_t)(ptr)[6] << 48 | (uint64_t)(ptr)[7] << 56)
+#endif
+#define REFILL()                                        \
     do {                                                \
-        unsigned int bits_used = 0;                     \
-        unsigned int index = 0;                         \
-        for (;;) {                                      \
-            if (UNLIKELY(num_bits <= bits_used)) {      \
-                if (in_ptr >= in_top) {                 \
-                    goto out_of_data;                   \
-                }                                       \
-                bit_accum |= *in_ptr << num_bits;       \
-                num_bits += 8;                          \
-                in_ptr++;                               \
-            }                                           \
-            index += (bit_accum >> bits_used) & 1;      \
-            bits_used++;                                \
-            if ((table)[index] >= 0) {                  \
-                break;                                  \
-            }                                           \
-            index = ~(table)[index];                    \
-        }                                               \
-        bit_accum >>= bits_used;                        \
-        num_bits -= bits_used;                          \
-        var = (table)[index];                           \
+        uint64_t __word;                                \
+        bit_accum |= LOAD64(in_ptr) << num_bits;        \
+        in_ptr += (63 - num_bits) >> 3;                 \
+        num_bits |= 56;                                 \
+        (void)__word;                                   \
+    } while (0)
+
+    /* The FASTBITS macro retrieves the specified number of bits (n) from
+     * the accumulator like GETBITS, but without checking whether enough
+     * bits are available.  It is used only after REFILL. */
+#define FASTBITS(n,var)                                         \
+    do {                                                        \
+        const unsigned int __n = (n);                           \
+        var = (unsigned int)bit_accum & ((1U << __n) - 1);      \
+        bit_accum >>= __n;                                      \
+        num_bits -= __n;                                        \
     } while (0)
 
     /* The PUTBYTE macro stores a byte into the output buffer, if any space
-     * is available, and updates the decompressed byte count and CRC. */
+     * is available, and updates the decompressed byte count.  Bytes which
+     * do not fit are still included in the CRC, since they cannot be
+     * picked up from the output buffer later. */
 #define PUTBYTE(byte)                           \
     do {                                        \
         const unsigned char __byte = (byte);    \
         if (LIKELY(out_ofs < out_size)) {       \
             out_base[out_ofs] = __byte;         \
+        } else {                                \
+            crc_discarded_byte(state, out_ofs, __byte); \
         }                                       \
         out_ofs++;                              \
-        UPDATECRC(__byte);                      \
-    } while (0)
-
-    /* The PUTBYTE_SAFE macro stores a byte into the output buffer and
-     * updates the byte count and CRC, like PUTBYTE; however, the output
-     * buffer is assumed to have space available.  This macro is used to
-     * avoid the space-available test when it has already been performed
-     * externally. */
-#define PUTBYTE_SAFE(byte)                      \
-    do {                                        \
-        const unsigned char __byte = (byte);    \
-        out_base[out_ofs] = __byte;             \
-        out_ofs++;                              \
-        UPDATECRC(__byte);                      \
-    } while (0)
-
-    /* The UPDATECRC macro updates the Adler32 CRC value stored in the
-     * "crc" variable for the given output byte.  Note that the local
-     * variable "__val" is renamed from "__byte" to avoid a name conflict
-     * when used with the PUTBYTE macro above.  Also, the final "&"
-     * operation is a no-op on systems where "unsigned long" is a 32-bit
-     * integer, but is required when "unsigned long" is larger than 32 bits
-     * to prevent incorrect results. */
-#define UPDATECRC(byte)                         \
-    do {                                        \
-        const unsigned char __val = (byte);     \
-        icrc = crc32_table[(icrc & 0xFF) ^ __val] ^ ((icrc >> 8) & 0xFFFFFFUL);\
     } while (0)
 
     /********************************/
@@ -694,7 +810,10 @@ static int tinflate_block(DecompressionState *state)
     /* Check for uncompressed blocks, and just copy them to the output
      * buffer. */
     if (state->block_type == 0) {
-        num_bits = 0;  /* Skip remaining bits in the previous byte */
+        /* Skip remaining bits in the current byte.  Any whole bytes left
+         * in the accumulator belong to the block and are used below. */
+        bit_accum >>= num_bits & 7;
+        num_bits -= num_bits & 7;
         state->state = UNCOMPRESSED_LEN;
       state_UNCOMPRESSED_LEN:
         GETBITS(16, state->len);
@@ -705,24 +824,43 @@ static int tinflate_block(DecompressionState *state)
             /* Length values don't match, so the stream must be corrupted. */
             goto error_return;
         }
-        /* Copy bytes to the output buffer. */
+        /* Copy bytes to the output buffer, starting with any still in
+         * the bit accumulator. */
         state->nread = 0;
         state->state = UNCOMPRESSED_DATA;
       state_UNCOMPRESSED_DATA:
+        while (state->nread < state->len && num_bits >= 8) {
+            PUTBYTE((unsigned char)bit_accum);
+            bit_accum >>= 8;
+            num_bits -= 8;
+            state->nread++;
+        }
+        if (num_bits == 0) {
+            bit_accum = 0;  /* Clear copies of bytes we are about to copy */
+        }
         while (state->nread < state->len) {
+            unsigned long count = state->len - state->nread;
             if (in_ptr >= in_top) {
                 goto out_of_data;
             }
-            PUTBYTE(*in_ptr++);
-            state->nread++;
+            if (count > in_top - in_ptr) {
+                count = in_top - in_ptr;
+            }
+            if (LIKELY(out_ofs <= out_size && count <= out_size - out_ofs)) {
+                memcpy(out_base + out_ofs, in_ptr, count);
+                out_ofs += count;
+                in_ptr += count;
+            } else {
+                unsigned long i;
+                for (i = 0; i < count; i++) {
+                    PUTBYTE(*in_ptr++);
+                }
+            }
+            state->nread += count;
         }
         /* Update the state buffer and return success. */
         state->in_ptr    = in_ptr;
         state->out_ofs   = out_ofs;
-        /* This "& 0xFFFFFFFFUL" is a no-op on systems where the "long"
-         * type is 32 bits wide, but where it is wider, the ~ operation
-         * will set the high bits of the variable, so clear them out. */
-        state->crc       = ~icrc & 0xFFFFFFFFUL;
         state->bit_accum = bit_accum;
         state->num_bits  = num_bits;
         state->state     = HEADER;
@@ -739,15 +877,23 @@ static int tinflate_block(DecompressionState *state)
             16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15
         };
 
-        /* Retrieve the three code counts from the block header. */
+        /* Retrieve the three code counts from the block header.  Counts
+         * beyond the defined symbols are not accepted (our table sizes
+         * do not allow for them). */
         state->state = LITERAL_COUNT;
       state_LITERAL_COUNT:
         GETBITS(5, state->literal_count);
         state->literal_count += 257;
+        if (state->literal_count > 286) {
+            goto error_return;
+        }
         state->state = DISTANCE_COUNT;
       state_DISTANCE_COUNT:
         GETBITS(5, state->distance_count);
         state->distance_count += 1;
+        if (state->distance_count > 30) {
+            goto error_return;
+        }
         state->state = CODELEN_COUNT;
       state_CODELEN_COUNT:
         GETBITS(4, state->codelen_count);
@@ -767,7 +913,8 @@ static int tinflate_block(DecompressionState *state)
         }
 
         /* Generate the code length Huffman table. */
-        if (!gen_huffman_table(19, state->codelen_len, state->codelen_table)) {
+        if (!gen_huffman_table(19, state->codelen_len, CODELEN_ROOT_BITS,
+                               state->codelen_table, CODELEN_TABLE_SIZE)) {
             goto error_return;
         }
 
@@ -787,7 +934,8 @@ static int tinflate_block(DecompressionState *state)
                 if (repeat_count == 0) {
                     /* Get the next value and/or repeat count from the
                      * bitstream. */
-                    GETHUFF(state->symbol, state->codelen_table);
+                    GETHUFF(state->symbol, state->codelen_table,
+                            CODELEN_ROOT_BITS);
                     if (state->symbol < 16) {
                         /* Literal bit length */
                         state->last_value = state->symbol;
@@ -805,13 +953,16 @@ static int tinflate_block(DecompressionState *state)
                       state_READ_LENGTHS_17:
                         GETBITS(3, repeat_count);
                         repeat_count += 3;
-                    } else {  /* symbol == 18 */
+                    } else if (state->symbol == 18) {
                         /* Repeat "0" 11-138 times */
                         state->last_value = 0;
                         state->state = READ_LENGTHS_18;
                       state_READ_LENGTHS_18:
                         GETBITS(7, repeat_count);
                         repeat_count += 11;
+                    } else {
+                        /* Invalid symbol (empty code length table) */
+                        goto error_return;
                     }
                 }  // if (repeat_count == 0)
                 if (state->counter < state->literal_count) {
@@ -827,66 +978,54 @@ static int tinflate_block(DecompressionState *state)
         }
 
         /* Generate the literal/length and distance Huffman tables. */
-        if (!gen_huffman_table(state->literal_count,  state->literal_len,
-                               state->literal_table)
+        if (!gen_huffman_table(state->literal_count, state->literal_len,
+                               LITERAL_ROOT_BITS, state->literal_table,
+                               LITERAL_TABLE_SIZE)
          || !gen_huffman_table(state->distance_count, state->distance_len,
-                               state->distance_table)
+                               DISTANCE_ROOT_BITS, state->distance_table,
+                               DISTANCE_TABLE_SIZE)
         ) {
             goto error_return;
         }
 
     } else {  /* Static tables */
 
-        int next_free = 2;  /* Next free index */
         int i;
 
-        /* All 1-6 bit codes are nonterminal. */
-        for (i = 0; i < 0x7E; i++) {
-            state->literal_table[i] = ~next_free;
-            next_free += 2;
-        }
-        /* 7-bit codes 000 0000 through 001 0111 correspond to symbols 256
-         * through 279. */
-        for (; i < 0x96; i++) {
-            state->literal_table[i] = (short)i + (256 - 0x7E);
-        }
-        /* All other 7-bit codes are nonterminal. */
-        for (; i < 0xFE; i++) {
-            state->literal_table[i] = ~next_free;
-            next_free += 2;
-        }
-        /* 8-bit codes 0011 0000 through 1011 1111 correspond to symbols 0
-         * through 143. */
-        for (; i < 0x18E; i++) {
-            state->literal_table[i] = (short)i + (0 - 0xFE);
-        }
-        /* 8-bit codes 1100 0000 through 1100 0111 correspond to symbols
-         * 280 through 287.  (Symbols 286 and 287 are not used in the
+        /* Literal/length codes are 8 bits for symbols 0-143, 9 bits for
+         * symbols 144-255, 7 bits for symbols 256-279, and 8 bits for
+         * symbols 280-287.  (Symbols 286 and 287 are not used in the
          * compressed data itself, but they take part in the construction
          * of the code table.) */
-        for (; i < 0x196; i++) {
-            state->literal_table[i] = (short)i + (280 - 0x18E);
+        for (i = 0; i < 144; i++) {
+            state->literal_len[i] = 8;
         }
-        /* 8-bit codes 1100 1000 through 1111 1111 are nonterminal. */
-        for (; i < 0x1CE; i++) {
-            state->literal_table[i] = ~next_free;
-            next_free += 2;
+        for (; i < 256; i++) {
+            state->literal_len[i] = 9;
         }
-        /* 9-bit codes 1 1001 0000 through 1 1111 1111 correspond to
-         * symbols 144 through 255. */
-        for (; i < 0x23E; i++) {
-            state->literal_table[i] = (short)i + (144 - 0x1CE);
+        for (; i < 280; i++) {
+            state->literal_len[i] = 7;
+        }
+        for (; i < 288; i++) {
+            state->literal_len[i] = 8;
         }
 
         /* Distance codes are represented as 5-bit integers for static
          * tables; we treat them as Huffman codes, and set up a table here
          * so that they can be processed in the same manner as for dynamic
          * Huffman coding.  */
-        for (i = 0; i < 0x1E; i++) {
-            state->distance_table[i] = ~(i*2+2);
+        for (i = 0; i < 32; i++) {
+            state->distance_len[i] = 5;
         }
-        for (i = 0x1E; i < 0x3E; i++) {
-            state->distance_table[i] = i - 0x1E;
+
+        if (!gen_huffman_table(288, state->literal_len,
+                               LITERAL_ROOT_BITS, state->literal_table,
+                               LITERAL_TABLE_SIZE)
+         || !gen_huffman_table(32, state->distance_len,
+                               DISTANCE_ROOT_BITS, state->distance_table,
+                               DISTANCE_TABLE_SIZE)
+        ) {
+            goto error_return;  // Impossible, but just for safety.
         }
 
     }  /* if (dynamic vs. static codes) */
@@ -918,8 +1057,76 @@ static int tinflate_block(DecompressionState *state)
 
         state->state = READ_SYMBOL;
       state_READ_SYMBOL:
+
+        /* As long as there is plenty of input data and output space,
+         * decode complete symbols (including any length/distance pair)
+         * without saving state or checking buffer limits.  Since we only
+         * leave this loop between symbols, the code below can pick up
+         * where it left off. */
+        while (LIKELY(in_top - in_ptr >= FAST_INPUT_MIN)
+            && LIKELY(out_ofs <= out_size)
+            && LIKELY(out_size - out_ofs >= FAST_OUTPUT_MIN)
+        ) {
+            unsigned int entry, symbol, length, extra;
+
+            REFILL();
+            LOOKUP(entry, state->literal_table, LITERAL_ROOT_BITS);
+            bit_accum >>= HUFF_LENGTH(entry);
+            num_bits -= HUFF_LENGTH(entry);
+            symbol = HUFF_SYMBOL(entry);
+            if (symbol < 256) {
+                out_base[out_ofs++] = symbol;
+                continue;
+            }
+            if (UNLIKELY(symbol == 256)) {
+                goto end_of_block;
+            }
+            symbol -= 257;
+            if (UNLIKELY(symbol >= 29)) {
+                goto error_return;
+            }
+            FASTBITS(length_extra[symbol], extra);
+            length = length_base[symbol] + extra;
+
+            LOOKUP(entry, state->distance_table, DISTANCE_ROOT_BITS);
+            bit_accum >>= HUFF_LENGTH(entry);
+            num_bits -= HUFF_LENGTH(entry);
+            symbol = HUFF_SYMBOL(entry);
+            if (UNLIKELY(symbol >= 30)) {
+                goto error_return;
+            }
+            FASTBITS(distance_extra[symbol], extra);
+            distance = distance_base[symbol] + extra;
+            if (UNLIKELY(out_ofs < distance)) {
+                goto error_return;
+            }
+
+            {
+                unsigned char *dest = out_base + out_ofs;
+                const unsigned char *src = dest - distance;
+                out_ofs += length;
+                if (distance >= 8) {
+                    /* The source never overlaps the part of the
+                     * destination being written, so we can copy eight
+                     * bytes at a time.  This may write up to 7 bytes past
+                     * the end of the string, which FAST_OUTPUT_MIN allows
+                     * for; those bytes will be overwritten later. */
+                    unsigned char * const dest_top = dest + length;
+                    do {
+                        memcpy(dest, src, 8);
+                        dest += 8;
+                        src += 8;
+                    } while (dest < dest_top);
+                } else {
+                    do {
+                        *dest++ = *src++;
+                    } while (--length > 0);
+                }
+            }
+        }
+
         /* Read a compressed symbol from the block. */
-        GETHUFF(state->symbol, state->literal_table);
+        GETHUFF(state->symbol, state->literal_table, LITERAL_ROOT_BITS);
 
         /* If the symbol is a literal, add it to the buffer and continue
          * with the next code. */
@@ -936,45 +1143,28 @@ static int tinflate_block(DecompressionState *state)
 
         /* The symbol must indicate a repeated string length, so determine
          * the length, reading extra bits from the stream as necessary. */
-        if (state->symbol <= 264) {
-            state->repeat_length = (state->symbol-257) + 3;
-        } else if (state->symbol <= 284) {
-            state->state = READ_LENGTH;
-          state_READ_LENGTH:
-            /* Empty statement to avoid syntax errors */ ;
-            {
-                const unsigned int length_bits = (state->symbol-261) / 4;
-                GETBITS(length_bits, state->repeat_length);
-                state->repeat_length +=
-                    3 + ((4 + ((state->symbol-265) & 3)) << length_bits);
-            }
-        } else if (state->symbol == 285) {
-            state->repeat_length = 258;
-        } else {
+        if (state->symbol > 285) {
             /* Invalid symbol */
             goto error_return;
         }
+        state->state = READ_LENGTH;
+      state_READ_LENGTH:
+        GETBITS(length_extra[state->symbol-257], state->repeat_length);
+        state->repeat_length += length_base[state->symbol-257];
 
         /* Read the distance symbol from the bitstream and determine the
          * backward distance to the string. */
         state->state = READ_DISTANCE;
       state_READ_DISTANCE:
-        GETHUFF(state->symbol, state->distance_table);
-        if (state->symbol <= 3) {
-            distance = state->symbol + 1;
-        } else if (state->symbol <=  29) {
-            state->state = READ_DISTANCE_EXTRA;
-          state_READ_DISTANCE_EXTRA:
-            /* Empty statement to avoid syntax errors */ ;
-            {
-                const unsigned int distance_bits = (state->symbol-2) / 2;
-                GETBITS(distance_bits, distance);
-                distance += 1 + ((2 + (state->symbol & 1)) << distance_bits);
-            }
-        } else {
+        GETHUFF(state->symbol, state->distance_table, DISTANCE_ROOT_BITS);
+        if (state->symbol > 29) {
             /* Invalid symbol */
             goto error_return;
         }
+        state->state = READ_DISTANCE_EXTRA;
+      state_READ_DISTANCE_EXTRA:
+        GETBITS(distance_extra[state->symbol], distance);
+        distance += distance_base[state->symbol];
 
         /* Ensure that the distance does not exceed the amount of data in
          * the output buffer.  If it does, return an error. */
@@ -986,20 +1176,23 @@ static int tinflate_block(DecompressionState *state)
          * the output pointer advances with each byte written, we can
          * simply use a constant offset (the value of "distance") from the
          * output pointer to retrieve the byte to copy.  If the output
-         * buffer becomes full during the copy, the CRC value will not be
-         * updated with the remaining bytes (as the source offset could
-         * subsequently run past the end of the output buffer as well), but
-         * since the CRC is explicitly undefined in this case, this is not
-         * a problem. */
+         * buffer becomes full during the copy, the remaining bytes are
+         * only counted (as the source offset could subsequently run past
+         * the end of the output buffer as well). */
         {
             unsigned int repeat_length = state->repeat_length;
             unsigned int overflow = 0;
             if (UNLIKELY(out_ofs + repeat_length > out_size)) {
-                overflow = (out_ofs + repeat_length) - out_size;
+                if (out_ofs >= out_size) {
+                    overflow = repeat_length;
+                } else {
+                    overflow = (out_ofs + repeat_length) - out_size;
+                }
                 repeat_length -= overflow;
             }
             for (; repeat_length > 0; repeat_length--) {
-                PUTBYTE_SAFE(out_base[out_ofs - distance]);
+                out_base[out_ofs] = out_base[out_ofs - distance];
+                out_ofs++;
             }
             out_ofs += overflow;
         }
@@ -1009,9 +1202,9 @@ static int tinflate_block(DecompressionState *state)
     /**** Update the state buffer with our local state variables, ****
      **** and return success.                                     ****/
 
+  end_of_block:
     state->in_ptr    = in_ptr;
     state->out_ofs   = out_ofs;
-    state->crc       = ~icrc & 0xFFFFFFFFUL;
     state->bit_accum = bit_accum;
     state->num_bits  = num_bits;
     state->state     = HEADER;
@@ -1025,7 +1218,6 @@ static int tinflate_block(DecompressionState *state)
   out_of_data:
     state->in_ptr    = in_ptr;
     state->out_ofs   = out_ofs;
-    state->crc       = ~icrc & 0xFFFFFFFFUL;
     state->bit_accum = bit_accum;
     state->num_bits  = num_bits;
     return 1;
@@ -1036,48 +1228,75 @@ static int tinflate_block(DecompressionState *state)
   error_return:
     state->in_ptr    = in_ptr;
     state->out_ofs   = out_ofs;
-    state->crc       = ~icrc & 0xFFFFFFFFUL;
     state->bit_accum = bit_accum;
     state->num_bits  = num_bits;
     return -1;
+
+#undef GETBITS
+#undef LOOKUP
+#undef GETHUFF
+#undef LOAD64
+#undef REFILL
+#undef FASTBITS
+#undef PUTBYTE
 }
 
 /*************************************************************************/
 
 /**
- * gen_huffman_table:  Generate a Huffman table from a set of code lengths,
- * using the algorithm described in RFC 1951.  The table format is as
- * described for the literal_table[] array in tinflate_block().
+ * gen_huffman_table:  Generate a Huffman lookup table from a set of code
+ * lengths, using the algorithm described in RFC 1951 to assign codes.
+ * The table format is as described at the top of this file.
  *
  * Parameters:
- *     symbols: Number of symbols in the alphabet.
- *     lengths: Bit lengths of the codes for each symbol (0 = symbol not used).
- *       table: Array into which the Huffman table will be stored.
+ *        symbols: Number of symbols in the alphabet.
+ *        lengths: Bit lengths of the codes for each symbol (0 = symbol
+ *                    not used).
+ *      root_bits: Number of bits used to index the first-level table
+ *                    (no greater than 9).
+ *          table: Array into which the Huffman table will be stored.
+ *     table_size: Number of elements in table[].
  * Return value:
  *     Nonzero on success, zero on failure (erroneous data).
  * Notes:
  *     The number of symbols must not be greater than 288; lengths[] must
- *     contain the number of elements specified by "symbols"; table[] must
- *     have enough room for symbols*2-2 elements, or for 2 elements if
- *     "symbols" is 1; and all code lengths must be no greater than 15.
+ *     contain the number of elements specified by "symbols"; and all code
+ *     lengths must be no greater than 15.  Apart from the degenerate
+ *     cases of zero or one symbol (for which every code decodes to the
+ *     single symbol, or to an invalid symbol, as a 1-bit code), the code
+ *     must be complete.
  */
 static int gen_huffman_table(int symbols,
                              const unsigned char *lengths,
-                             short *table)
+                             int root_bits,
+                             unsigned short *table,
+                             int table_size)
 {
     /* length_count: Count of symbols with each code length. */
     unsigned short length_count[16];
     /* total_count: Count of all symbols with non-zero lengths. */
-    unsigned short total_count;
-    /* first_code: First code value to be used for each code length. */
-    unsigned short first_code[16];
-    /* index: Current table index. */
-    unsigned int index;
+    unsigned int total_count;
+    /* next_code: Next code value to be used for each code length. */
+    unsigned short next_code[16];
+    /* codes: Code for each symbol, bit-reversed into stream order. */
+    unsigned short codes[288];
+    /* sub_bits: Number of subtable index bits needed for each first-level
+     * table slot (0 = no subtable). */
+    unsigned char sub_bits[1<<9];
+    /* root_size: Number of entries in the first-level table. */
+    const unsigned int root_size = 1U << root_bits;
+    /* next_index: Index of the next free table entry for subtables. */
+    unsigned int next_index;
+    /* left: Number of unused codes of the current length. */
+    int left;
 
     unsigned int i;
 
     /* Check parameter validity. */
-    if (symbols <= 0 || symbols > 288 || lengths == NULL || table == NULL) {
+    if (symbols <= 0 || symbols > 288 || lengths == NULL || table == NULL
+     || root_bits <= 0 || root_bits > 9 || root_size > table_size
+     || table_size > 0x800
+    ) {
         return 0;
     }
 
@@ -1098,68 +1317,98 @@ static int gen_huffman_table(int symbols,
     for (i = 1; i < 16; i++) {
         total_count += length_count[i];
     }
-    if (total_count == 0) {
-        return 1;
-    } else if (total_count == 1) {
+    if (total_count <= 1) {
+        unsigned short entry = HUFF_ENTRY(HUFF_INVALID_SYMBOL, 1);
         for (i = 0; i < symbols; i++) {
             if (lengths[i] != 0) {
-                table[0] = table[1] = i;
+                entry = HUFF_ENTRY(i, 1);
             }
         }
+        for (i = 0; i < root_size; i++) {
+            table[i] = entry;
+        }
         return 1;
     }
 
-    /* Determine the first code value for each code length.  */
-    first_code[1] = 0;
-    for (i = 2; i < 16; i++) {
-        first_code[i] = (first_code[i-1] + length_count[i-1]) << 1;
-    }
-
-    /* Create the Huffman table, assigning codes to symbols sequentially
-     * within each code length.  If the code value or table overflows
-     * (presumably due to invalid data), abort. */
-    const int table_entries = symbols*2 - 2;
-    index = 0;
+    /* Ensure that the code is neither oversubscribed nor incomplete. */
+    left = 1;
     for (i = 1; i < 16; i++) {
-        /* code_limit: Maximum code value for this code length. */
-        unsigned int code_limit = (unsigned short)(1UL << i);
-        /* next_code: First free code after all symbols with this code
-         * length have been assigned. */
-        unsigned int next_code = first_code[i] + length_count[i];
-        /* next_index: First array index for the next higher code length. */
-        unsigned int next_index = index + (code_limit - first_code[i]);
-        unsigned int j;
-
-        /* Check for code overflow. */
-        if (next_code > code_limit) {
+        left = (left << 1) - length_count[i];
+        if (left < 0) {
             return 0;
         }
+    }
+    if (left != 0) {
+        return 0;
+    }
 
-        /* Fill in any symbols of this code length. */
-        for (j = 0; j < symbols; j++) {
-            if (lengths[j] == i) {
-                if (index >= table_entries) {
-                    return 0;
-                }
-                table[index++] = j;
+    /* Determine the first code value for each code length, then assign
+     * codes to symbols sequentially within each code length.  Codes are
+     * stored most significant bit first, so reverse each one to get the
+     * table index. */
+    next_code[1] = 0;
+    for (i = 2; i < 16; i++) {
+        next_code[i] = (next_code[i-1] + length_count[i-1]) << 1;
+    }
+    for (i = 0; i < root_size; i++) {
+        sub_bits[i] = 0;
+    }
+    for (i = 0; i < symbols; i++) {
+        const unsigned int length = lengths[i];
+        unsigned int code, reversed, j;
+        if (length == 0) {
+            continue;
+        }
+        code = next_code[length]++;
+        reversed = 0;
+        for (j = 0; j < length; j++, code >>= 1) {
+            reversed = reversed<<1 | (code & 1);
+        }
+        codes[i] = reversed;
+        if (length > root_bits) {
+            const unsigned int slot = reversed & (root_size - 1);
+            if (sub_bits[slot] < length - root_bits) {
+                sub_bits[slot] = length - root_bits;
             }
         }
+    }
 
-        /* For i == 15 (the maximum code length), there must not be any
-         * remaining internal nodes. */
-        if (i == 15 && next_code != code_limit) {
-            return 0;
+    /* Allocate subtables for first-level slots which need them. */
+    next_index = root_size;
+    for (i = 0; i < root_size; i++) {
+        if (sub_bits[i] > 0) {
+            if (next_index + (1U << sub_bits[i]) > table_size) {
+                return 0;
+            }
+            table[i] = HUFF_LINK(next_index, sub_bits[i]);
+            next_index += 1U << sub_bits[i];
         }
+    }
 
-        /* Fill in remaining (internal) nodes for this length. */
-        if (index + (code_limit - next_code) > table_entries) {
-            return 0;
+    /* Store each symbol in every slot whose index starts with its code.
+     * Since the code is complete, this fills every slot. */
+    for (i = 0; i < symbols; i++) {
+        const unsigned int length = lengths[i];
+        const unsigned short entry = HUFF_ENTRY(i, length);
+        unsigned int j;
+        if (length == 0) {
+            continue;
         }
-        for (j = next_code; j < code_limit; j++) {
-            table[index++] = ~next_index;
-            next_index += 2;
+        if (length <= root_bits) {
+            for (j = codes[i]; j < root_size; j += 1U << length) {
+                table[j] = entry;
+            }
+        } else {
+            const unsigned short link = table[codes[i] & (root_size - 1)];
+            unsigned short * const subtable = table + HUFF_SUB_INDEX(link);
+            const unsigned int sub_size = 1U << HUFF_SUB_BITS(link);
+            for (j = codes[i] >> root_bits; j < sub_size;
+                 j += 1U << (length - root_bits)
+            ) {
+                subtable[j] = entry;
+            }
         }
-    }  /* for each code length */
+    }
 
     /* Return success. */
     return 1;
@@ -1167,6 +1416,114 @@ static int gen_huffman_table(int symbols,
 
 /*************************************************************************/
 
+/**
+ * update_crc:  Update the CRC stored in the state buffer to include all
+ * output data stored so far.
+ *
+ * Parameters:
+ *     state: Decompression state buffer.
+ * Return value:
+ *     None.
+ * Notes:
+ *     Data discarded due to a full output buffer is not included here (see
+ *     crc_discarded_byte()).
+ */
+static void update_crc(DecompressionState *state)
+{
+    const unsigned long end =
+        state->out_ofs < state->out_size ? state->out_ofs : state->out_size;
+    const unsigned char *ptr;
+    unsigned long size;
+    /* icrc: Inverted (one's-complement) value of the running CRC. */
+    uint32_t icrc;
+
+    if (end <= state->crc_ofs) {
+        return;
+    }
+    if (UNLIKELY(!crc32_slice_ready)) {
+        init_crc32_tables();
+    }
+
+    ptr = state->out_base + state->crc_ofs;
+    size = end - state->crc_ofs;
+    icrc = ~state->crc & 0xFFFFFFFFUL;
+
+    while (size >= 8) {
+        icrc ^= (uint32_t)ptr[0]       | (uint32_t)ptr[1] <<  8
+              | (uint32_t)ptr[2] << 16 | (uint32_t)ptr[3] << 24;
+        icrc = crc32_slice[6][icrc & 0xFF]
+             ^ crc32_slice[5][(icrc >>  8) & 0xFF]
+             ^ crc32_slice[4][(icrc >> 16) & 0xFF]
+             ^ crc32_slice[3][icrc >> 24]
+             ^ crc32_slice[2][ptr[4]]
+             ^ crc32_slice[1][ptr[5]]
+             ^ crc32_slice[0][ptr[6]]
+             ^ (uint32_t)crc32_table[ptr[7]];
+        ptr += 8;
+        size -= 8;
+    }
+    for (; size > 0; size--, ptr++) {
+        icrc = (uint32_t)crc32_table[(icrc & 0xFF) ^ *ptr] ^ (icrc >> 8);
+    }
+
+    state->crc = ~icrc & 0xFFFFFFFFUL;
+    state->crc_ofs = end;
+}
+
+/*************************************************************************/
+
+/**
+ * crc_discarded_byte:  Add a byte which did not fit in the output buffer
+ * to the CRC, if the CRC is otherwise up to date at that point.  (Bytes
+ * of repeated strings which do not fit are not included, since their
+ * values may not be known; the CRC is undefined in that case.)
+ *
+ * Parameters:
+ *       state: Decompression state buffer.
+ *     out_ofs: Output offset of the byte (no less than state->out_size).
+ *        byte: Value of the byte.
+ * Return value:
+ *     None.
+ */
+static void crc_discarded_byte(DecompressionState *state,
+                               unsigned long out_ofs, unsigned char byte)
+{
+    state->out_ofs = out_ofs;
+    update_crc(state);
+    if (state->crc_ofs == out_ofs) {
+        const uint32_t icrc = ~state->crc & 0xFFFFFFFFUL;
+        state->crc = ~((uint32_t)crc32_table[(icrc & 0xFF) ^ byte]
+                       ^ (icrc >> 8)) & 0xFFFFFFFFUL;
+        state->crc_ofs++;
+    }
+}
+
+/*************************************************************************/
+
+/**
+ * init_crc32_tables:  Generate the crc32_slice[] tables from crc32_table[].
+ *
+ * Parameters:
+ *     None.
+ * Return value:
+ *     None.
+ */
+static void init_crc32_tables(void)
+{
+    unsigned int i, n;
+
+    for (i = 0; i < 256; i++) {
+        uint32_t crc = (uint32_t)crc32_table[i];
+        for (n = 0; n < 7; n++) {
+            crc = (uint32_t)crc32_table[crc & 0xFF] ^ (crc >> 8);
+            crc32_slice[n][i] = crc;
+        }
+    }
+    crc32_slice_ready = 1;
+}
+
+/*************************************************************************/
+
 /* End of tinflate.c */
 
 /*
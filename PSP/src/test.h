@@ -97,6 +97,17 @@ extern int test_intersect(void);
 extern int test_memory(void);
 
 
+/******** test-resource.c ********/
+
+/**
+ * test_resource:  パッケージファイルからのリソース読み込みをテストする。
+ *
+ * 【引　数】なし
+ * 【戻り値】0以外＝全テストが成功した、0＝一つ以上のテストが失敗した
+ */
+extern int test_resource(void);
+
+
 /*************************************************************************/
 
 #endif  // TEST_H
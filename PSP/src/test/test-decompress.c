@@ -9,9 +9,13 @@
 
 #ifdef INCLUDE_TESTS  // ファイル末尾まで
 
+#include "../memory.h"
+#include "../sysdep.h"
 #include "../test.h"
 #include "../resource/tinflate.h"
 
+#include <zlib.h>
+
 /*************************************************************************/
 
 /* ローカル関数宣言 */
@@ -23,6 +27,21 @@ static int test_decompress_one(const uint8_t * const in,
                                const unsigned long expected_crc32,
                                const uint8_t * const test,
                                const int32_t test_size);
+static int test_decompress_large(void);
+static void fill_test_data(uint8_t *buf, uint32_t size);
+static int test_decompress_partial(const uint8_t *in, uint32_t in_size,
+                                   uint8_t *out, const uint8_t *data,
+                                   uint32_t size,
+                                   unsigned long expected_crc32,
+                                   uint32_t chunk);
+static void benchmark_decompress(const uint8_t *in, uint32_t in_size,
+                                 uint8_t *out, uint32_t size, int level);
+
+/* 大容量データテストのデータサイズ（バイト） */
+#define LARGE_DATA_SIZE  (512*1024)
+
+/* ベンチマークの繰り返し回数 */
+#define BENCHMARK_LOOPS  10
 
 /*************************************************************************/
 /*************************************************************************/
@@ -619,7 +638,7 @@ int test_decompress(void)
         }
     }
 
-    return 1;
+    return test_decompress_large();
 }
 
 /*************************************************************************/
@@ -668,6 +687,222 @@ static int test_decompress_one(const uint8_t * const in,
     return 1;
 }
 
+/*************************************************************************/
+
+/**
+ * test_decompress_large:  zlibで圧縮した大容量データで解凍関数をテストし、
+ * 解凍速度をzlibと比較する。各圧縮レベル（無圧縮・高速・最大）について、
+ * 一括解凍と分割解凍（tinflate_partial()）の結果を確認した後、両ライブラリ
+ * の解凍速度を計測して出力する。
+ *
+ * 【引　数】なし
+ * 【戻り値】0以外＝成功、0＝失敗
+ */
+static int test_decompress_large(void)
+{
+    static const int levels[] = {0, 1, 9};
+    static const uint32_t chunks[] = {1, 13, 4096};
+
+    const uint32_t size = LARGE_DATA_SIZE;
+    const uLong in_bufsize = compressBound(size);
+    uint8_t *data = mem_alloc(size, 0, MEM_ALLOC_TEMP);
+    uint8_t *in = mem_alloc(in_bufsize, 0, MEM_ALLOC_TEMP);
+    uint8_t *out = mem_alloc(size, 0, MEM_ALLOC_TEMP);
+    int result = 0;
+    int i, j;
+
+    if (!data || !in || !out) {
+        DMSG("FAIL: out of memory for test buffers");
+        goto out;
+    }
+    fill_test_data(data, size);
+    const unsigned long crc32_expected = crc32(crc32(0, NULL, 0), data, size);
+
+    for (i = 0; i < lenof(levels); i++) {
+        uLongf in_size = in_bufsize;
+        if (compress2(in, &in_size, data, size, levels[i]) != Z_OK) {
+            DMSG("FAIL: compress2() failed for level %d", levels[i]);
+            goto out;
+        }
+
+        mem_fill32(out, 0xDEADBEEF, size);
+        unsigned long crc32_result;
+        const long out_size = tinflate(in, in_size, out, size, &crc32_result);
+        if (out_size != size) {
+            DMSG("FAIL: level %d: expected result %u, got %ld",
+                 levels[i], size, out_size);
+            goto out;
+        }
+        if (crc32_result != crc32_expected) {
+            DMSG("FAIL: level %d: expected CRC32 %08lX, got %08lX",
+                 levels[i], crc32_expected, crc32_result);
+            goto out;
+        }
+        if (memcmp(out, data, size) != 0) {
+            DMSG("FAIL: level %d: data mismatch", levels[i]);
+            goto out;
+        }
+
+        for (j = 0; j < lenof(chunks); j++) {
+            if (!test_decompress_partial(in, in_size, out, data, size,
+                                         crc32_expected, chunks[j])) {
+                DMSG("FAIL: level %d: partial decompression failed with"
+                     " chunk size %u", levels[i], chunks[j]);
+                goto out;
+            }
+        }
+
+        benchmark_decompress(in, in_size, out, size, levels[i]);
+    }
+
+    result = 1;
+
+  out:
+    mem_free(out);
+    mem_free(in);
+    mem_free(data);
+    return result;
+}
+
+/*************************************************************************/
+
+/**
+ * fill_test_data:  大容量テスト用のデータを生成する。単語を擬似乱数で並べ
+ * たテキスト（動的ハフマン符号化・長短の距離）、乱数列（長い符号・無圧縮
+ * ブロック）、同一バイトの連続（距離1）を繰り返し含む。
+ *
+ * 【引　数】 buf: データを格納するバッファ
+ * 　　　　　size: データサイズ（バイト）
+ * 【戻り値】なし
+ */
+static void fill_test_data(uint8_t *buf, uint32_t size)
+{
+    static const char * const words[] = {
+        "the ", "sea ", "of ", "Aquaria ", "Naija ", "song ", "cave ",
+        "energy ", "form ", "\n", "<node id=\"", "\"/>", "0.5 ", "128 ",
+    };
+    uint32_t seed = 12345;
+    uint32_t pos = 0;
+
+    while (pos < size) {
+        seed = seed * 1103515245 + 12345;
+        const uint32_t section = (pos / 16384) % 8;
+        if (section == 6) {  // 乱数列
+            buf[pos++] = seed >> 24;
+        } else if (section == 7) {  // 同一バイトの連続
+            buf[pos] = (pos / 1000) & 0xFF;
+            pos++;
+        } else {
+            const char *word = words[(seed >> 16) % lenof(words)];
+            while (*word && pos < size) {
+                buf[pos++] = *word++;
+            }
+        }
+    }
+}
+
+/*************************************************************************/
+
+/**
+ * test_decompress_partial:  tinflate_partial()で圧縮データを指定サイズずつ
+ * 解凍し、結果を確認する。
+ *
+ * 【引　数】   in, in_size: 圧縮データとそのサイズ（バイト）
+ * 　　　　　           out: 出力バッファ（sizeバイト）
+ * 　　　　　    data, size: 期待出力データとそのサイズ（バイト）
+ * 　　　　　expected_crc32: 期待出力データのCRC32
+ * 　　　　　         chunk: 一回に渡す圧縮データのサイズ（バイト）
+ * 【戻り値】0以外＝成功、0＝失敗
+ */
+static int test_decompress_partial(const uint8_t *in, uint32_t in_size,
+                                   uint8_t *out, const uint8_t *data,
+                                   uint32_t size,
+                                   unsigned long expected_crc32,
+                                   uint32_t chunk)
+{
+    const int state_size = tinflate_state_size();
+    void *state = mem_alloc(state_size, 0, MEM_ALLOC_TEMP | MEM_ALLOC_CLEAR);
+    if (!state) {
+        DMSG("FAIL: out of memory for state buffer");
+        return 0;
+    }
+
+    mem_fill32(out, 0xDEADBEEF, size);
+    unsigned long size_result = 0, crc32_result = 0;
+    int result = 1;
+    uint32_t pos;
+    for (pos = 0; result > 0 && pos < in_size; ) {
+        /* zlibヘッダ（2バイト）は最初の呼び出しで渡す必要がある */
+        const uint32_t this_chunk =
+            ubound(pos == 0 ? lbound(chunk, 2) : chunk, in_size - pos);
+        result = tinflate_partial(in + pos, this_chunk, out, size,
+                                  &size_result, &crc32_result,
+                                  state, state_size);
+        pos += this_chunk;
+    }
+    mem_free(state);
+
+    if (result != 0) {
+        DMSG("FAIL: tinflate_partial() returned %d at offset %u",
+             result, pos);
+        return 0;
+    }
+    if (size_result != size) {
+        DMSG("FAIL: expected size %u, got %lu", size, size_result);
+        return 0;
+    }
+    if (crc32_result != expected_crc32) {
+        DMSG("FAIL: expected CRC32 %08lX, got %08lX",
+             expected_crc32, crc32_result);
+        return 0;
+    }
+    if (memcmp(out, data, size) != 0) {
+        DMSG("FAIL: data mismatch");
+        return 0;
+    }
+    return 1;
+}
+
+/*************************************************************************/
+
+/**
+ * benchmark_decompress:  tinflate()とzlibのuncompress()の解凍速度を計測し、
+ * 結果を出力する。条件を揃えるため、tinflate()でもCRCを計算させる（zlibは
+ * 常にAdler-32を検証する）。結果の合否は判定しない。
+ *
+ * 【引　数】in, in_size: 圧縮データとそのサイズ（バイト）
+ * 　　　　　        out: 出力バッファ（sizeバイト）
+ * 　　　　　       size: 解凍データサイズ（バイト）
+ * 　　　　　      level: 圧縮レベル（出力用）
+ * 【戻り値】なし
+ */
+static void benchmark_decompress(const uint8_t *in, uint32_t in_size,
+                                 uint8_t *out, uint32_t size, int level)
+{
+    double start, tinflate_time, zlib_time;
+    unsigned long crc32_result;
+    int i;
+
+    start = sys_time_now();
+    for (i = 0; i < BENCHMARK_LOOPS; i++) {
+        tinflate(in, in_size, out, size, &crc32_result);
+    }
+    tinflate_time = sys_time_now() - start;
+
+    start = sys_time_now();
+    for (i = 0; i < BENCHMARK_LOOPS; i++) {
+        uLongf out_size = size;
+        uncompress(out, &out_size, in, in_size);
+    }
+    zlib_time = sys_time_now() - start;
+
+    const double megabytes = (double)size * BENCHMARK_LOOPS / (1024*1024);
+    DMSG("level %d (%u -> %u bytes): tinflate %.1f MB/s, zlib %.1f MB/s",
+         level, in_size, size,
+         tinflate_time > 0 ? megabytes / tinflate_time : 0.0,
+         zlib_time > 0 ? megabytes / zlib_time : 0.0);
+}
+
 /*************************************************************************/
 /*************************************************************************/
 
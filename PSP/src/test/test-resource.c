@@ -0,0 +1,214 @@
+/*
+ * Aquaria PSP port
+ * Copyright (C) 2010 Andrew Church <achurch@achurch.org>
+ *
+ * src/test/test-resource.c: Test routines for resource loading from
+ * package files.
+ */
+
+#include "../common.h"
+
+#ifdef INCLUDE_TESTS  // ファイル末尾まで
+
+#include "../memory.h"
+#include "../resource.h"
+#include "../sysdep.h"
+#include "../test.h"
+
+#include "../resource/package.h"
+#include "../resource/tinflate.h"
+
+/*************************************************************************/
+
+/* テストする圧縮ファイルの最大数（全ファイルをテストすると時間がかかるため） */
+#define MAX_TEST_FILES  200
+
+/* 失敗メッセージを出力してfailedフラグを立てるマクロ */
+#define FAIL(msg,...) do {              \
+    DMSG("FAIL: " msg , ## __VA_ARGS__);\
+    failed = 1;                         \
+} while (0)
+
+/* 各種テストを実行する補助関数 */
+static int load_reference(PackageModuleInfo *pkginfo, const char *path,
+                          void **data_ret, uint32_t *size_ret);
+
+/*************************************************************************/
+/*************************************************************************/
+
+/**
+ * test_resource:  パッケージファイルからのリソース読み込みをテストする。
+ * パッケージ内の圧縮ファイルについて、ストリーミング解凍で読み込んだデータ
+ * が一括読み込み・一括解凍したデータと一致することを確認する。パッケージ
+ * ファイルがない場合や、圧縮ファイルがない場合（build-pkg -zで作成されて
+ * いない場合）は、何もテストできないため失敗とする。
+ *
+ * 【引　数】なし
+ * 【戻り値】0以外＝全テストが成功した、0＝一つ以上のテストが失敗した
+ */
+int test_resource(void)
+{
+    PackageModuleInfo *pkginfo = &package_info_aquaria;
+    if (!pkginfo->available) {
+        DMSG("FAIL: Package file not available");
+        return 0;
+    }
+
+    ResourceManager resmgr;
+    mem_clear(&resmgr, sizeof(resmgr));
+    if (!resource_create(&resmgr, 0)) {
+        DMSG("FAIL: resource_create() failed");
+        return 0;
+    }
+
+    int failed = 0;
+    int num_tested = 0;
+    const char *path;
+    if (!resource_list_files_start(pkginfo->prefix)) {
+        DMSG("FAIL: resource_list_files_start() failed");
+        resource_delete(&resmgr);
+        return 0;
+    }
+    while ((path = resource_list_files_next()) != NULL
+        && num_tested < MAX_TEST_FILES
+    ) {
+        SysFile *fp;
+        uint32_t pos, len, size;
+        int compressed;
+        if (!(*pkginfo->file_info)(pkginfo, path, &fp, &pos, &len,
+                                   &compressed, &size)) {
+            FAIL("%s: file_info() failed for listed file", path);
+            continue;
+        }
+        if (!compressed) {
+            continue;
+        }
+        num_tested++;
+
+        void *refdata;
+        uint32_t refsize;
+        if (!load_reference(pkginfo, path, &refdata, &refsize)) {
+            FAIL("%s: Failed to load reference data", path);
+            continue;
+        }
+
+        void *data = NULL;
+        uint32_t datasize = 0;
+        if (!resource_load_data(&resmgr, &data, &datasize, path, 0, 0)) {
+            FAIL("%s: resource_load_data() failed", path);
+            mem_free(refdata);
+            continue;
+        }
+        const int mark = resource_mark(&resmgr);
+
+        /* 待ち方を変えて、同期・非同期の両方の処理経路と、読み込み中の
+         * 解放を確認する */
+        switch (num_tested % 3) {
+          case 0:
+            resource_wait(&resmgr, mark);
+            break;
+          case 1:
+            while (!resource_sync(&resmgr, mark)) {
+                sys_time_delay(0.001);
+            }
+            break;
+          case 2:
+            resource_free(&resmgr, &data);
+            if (data) {
+                FAIL("%s: Data pointer not cleared on free", path);
+            }
+            mem_free(refdata);
+            continue;
+        }
+
+        if (!data) {
+            FAIL("%s: Load failed", path);
+        } else if (datasize != refsize) {
+            FAIL("%s: Size mismatch (got %u, expected %u)", path,
+                 datasize, refsize);
+        } else if (memcmp(data, refdata, refsize) != 0) {
+            FAIL("%s: Data mismatch", path);
+        }
+        resource_free(&resmgr, &data);
+        mem_free(refdata);
+    }
+
+    resource_delete(&resmgr);
+
+    if (!num_tested) {
+        DMSG("FAIL: No compressed files in package (build it with"
+             " build-pkg -z)");
+        failed = 1;
+    }
+    return !failed;
+}
+
+/*************************************************************************/
+/*************************************************************************/
+
+/**
+ * load_reference:  パッケージ内の圧縮ファイルを、リソース管理機能を経由せず
+ * に一括で読み込み、解凍する。
+ *
+ * 【引　数】 pkginfo: パッケージモジュール情報ポインタ
+ * 　　　　　    path: パス名
+ * 　　　　　data_ret: 解凍データバッファを格納する変数へのポインタ
+ * 　　　　　size_ret: 解凍データサイズ（バイト）を格納する変数へのポインタ
+ * 【戻り値】0以外＝成功、0＝失敗
+ */
+static int load_reference(PackageModuleInfo *pkginfo, const char *path,
+                          void **data_ret, uint32_t *size_ret)
+{
+    SysFile *fp;
+    uint32_t pos, len, size;
+    int compressed;
+    if (!(*pkginfo->file_info)(pkginfo, path, &fp, &pos, &len,
+                               &compressed, &size)) {
+        return 0;
+    }
+
+    void *compdata = mem_alloc(len, 0, MEM_ALLOC_TEMP);
+    void *data = mem_alloc(size, 0, 0);
+    if (!compdata || !data) {
+        DMSG("%s: Out of memory", path);
+        goto error;
+    }
+    const int request = sys_file_read_async(fp, compdata, len, pos);
+    if (!request) {
+        DMSG("%s: Failed to read %u from %u in package file", path, len, pos);
+        goto error;
+    }
+    if (sys_file_wait_async(request) != len) {
+        DMSG("%s: Short read from package file", path);
+        goto error;
+    }
+    if (tinflate(compdata, len, data, size, NULL) != size) {
+        DMSG("%s: tinflate() failed", path);
+        goto error;
+    }
+
+    mem_free(compdata);
+    *data_ret = data;
+    *size_ret = size;
+    return 1;
+
+  error:
+    mem_free(compdata);
+    mem_free(data);
+    return 0;
+}
+
+/*************************************************************************/
+/*************************************************************************/
+
+#endif  // INCLUDE_TESTS
+
+/*
+ * Local variables:
+ *   c-file-style: "stroustrup"
+ *   c-file-offsets: ((case-label . *) (statement-case-intro . *))
+ *   indent-tabs-mode: nil
+ * End:
+ *
+ * vim: expandtab shiftwidth=4:
+ */
@@ -36,6 +36,7 @@ int run_all_tests(void)
         DEFINE_TEST(intersect),
         DEFINE_TEST(memory),
         DEFINE_TEST(decompress),
+        DEFINE_TEST(resource),
 #undef DEFINE_TEST
     };
 
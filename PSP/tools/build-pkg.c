@@ -20,7 +20,12 @@
  * with "#" (comments) are ignored.
  *
  * Invoke the program as:
- *     build-pkg <control-file> <output-file>
+ *     build-pkg [-z] <control-file> <output-file>
+ *
+ * With -z, each file is compressed with zlib (deflate) and stored
+ * compressed if that makes it smaller.  The game decompresses such files
+ * as they are read.  Sound files (*.mp3, *.ogg) are always stored as is,
+ * since the game streams them directly from the package.
  */
 
 /*************************************************************************/
@@ -52,12 +57,18 @@
  * 　　 更してパッケージに記録する）。
  *
  * 制御ファイルの各ラインの長さはLINEMAXバイト以下でなければならない。
+ *
+ * -zオプションを指定した場合、各ファイルをdeflate方式（zlib形式）で圧縮し、
+ * 圧縮によってサイズが小さくなるファイルは圧縮データとして記録する。ただし
+ * 音声ファイル（*.mp3、*.ogg）はパッケージから直接ストリーミング再生される
+ * ため、常に無圧縮で記録する。
  */
 
 #include "../src/common.h"
 #include "../src/resource/package-pkg.h"
 
 #include <dirent.h>
+#include <zlib.h>
 
 #define LINEMAX  1000  // 制御ファイルの1ラインの最大長（バイト）
 
@@ -76,6 +87,10 @@ typedef struct FileInfo_ {
 } FileInfo;
 
 
+/* 圧縮フラグ（0以外＝-zオプション指定） */
+static int compress_files;
+
+
 /* 補助関数宣言 */
 static FileInfo *read_control_file(const char *filename, uint32_t *nfiles_ret);
 static int append_one_file(FileInfo **filelist_ptr, uint32_t *nfiles_ptr,
@@ -89,6 +104,9 @@ static int write_package(const char *filename, FileInfo *filelist,
                          PKGIndexEntry *index, uint32_t nfiles,
                          const char *namebuf, uint32_t namesize);
 
+static int is_streamed_file(const char *pathname);
+static uint8_t *deflate_file(const char *realfile, uint32_t filesize,
+                             uint32_t *len_ret);
 static void pkg_sort(PKGIndexEntry * const index, const uint32_t nfiles,
                       const char *namebuf,
                       const uint32_t left, const uint32_t right);
@@ -98,6 +116,7 @@ static void pkg_sort(PKGIndexEntry * const index, const uint32_t nfiles,
 
 /**
  * main:  メイン関数。コマンドライン引数として、
+ *     (0) 「-z」（任意。ファイルを圧縮して記録する）
  *     (1) 制御ファイルのパス名
  *     (2) 出力するパッケージファイルのパス名
  * を受ける。
@@ -113,14 +132,20 @@ int main(int argc, char **argv)
     setbuf(stderr, NULL);  // grr
 #endif
 
-    if (argc != 3) {
-        fprintf(stderr, "Usage: %s <control-file> <output-file>\n", argv[0]);
+    int argi = 1;
+    if (argc > 1 && strcmp(argv[1], "-z") == 0) {
+        compress_files = 1;
+        argi++;
+    }
+    if (argc - argi != 2) {
+        fprintf(stderr, "Usage: %s [-z] <control-file> <output-file>\n",
+                argv[0]);
         exit(1);
     }
 
     /* (1) 制御ファイルを読み込む */
     uint32_t nfiles;
-    FileInfo *filelist = read_control_file(argv[1], &nfiles);
+    FileInfo *filelist = read_control_file(argv[argi], &nfiles);
     if (!filelist) {
         exit(1);
     }
@@ -135,7 +160,7 @@ int main(int argc, char **argv)
     }
 
     /* (3) パッケージファイルを作成する */
-    if (!write_package(argv[2], filelist, index, nfiles, namebuf, namesize)) {
+    if (!write_package(argv[argi+1], filelist, index, nfiles, namebuf, namesize)) {
         exit(1);
     }
 
@@ -474,6 +499,24 @@ static PKGIndexEntry *filelist_to_index(FileInfo *filelist, int nfiles,
         index[i].datalen       = filesize;
         index[i].filesize      = filesize;
 
+        /* 圧縮指定時は、実際に圧縮してみて小さくなる場合のみ圧縮データを
+         * 記録する。データ自体はwrite_package()で再度圧縮して出力する */
+        if (compress_files && filesize > 0
+         && !is_streamed_file(filelist[i].pathname)
+        ) {
+            uint32_t complen;
+            uint8_t *compdata =
+                deflate_file(filelist[i].realfile, filesize, &complen);
+            if (!compdata) {
+                goto error_return;
+            }
+            free(compdata);
+            if (complen < filesize) {
+                index[i].nameofs_flags |= PKGF_DEFLATED;
+                index[i].datalen        = complen;
+            }
+        }
+
         const uint32_t thisnamelen = strlen(filelist[i].pathname) + 1;
         namebuf = realloc(namebuf, namesize + thisnamelen);
         if (!namebuf) {
@@ -600,13 +643,36 @@ static int write_package(const char *filename, FileInfo *filelist,
             }
             padding -= towrite;
         }
+        const PKGIndexEntry *entry = &index[filelist[i].index_entry];
+        if (entry->nameofs_flags & PKGF_DEFLATED) {
+            uint32_t complen;
+            uint8_t *compdata = deflate_file(filelist[i].realfile,
+                                             entry->filesize, &complen);
+            if (!compdata) {
+                goto error_close_pkg;
+            }
+            if (complen != entry->datalen) {
+                fprintf(stderr, "%s changed while writing package\n",
+                        filelist[i].realfile);
+                free(compdata);
+                goto error_close_pkg;
+            }
+            if (fwrite(compdata, 1, complen, pkg) != complen) {
+                fprintf(stderr, "Write error on %s (data for %s): %s\n",
+                        filename, filelist[i].pathname, strerror(errno));
+                free(compdata);
+                goto error_close_pkg;
+            }
+            free(compdata);
+            continue;
+        }
         FILE *f = fopen(filelist[i].realfile, "rb");
         if (!f) {
             fprintf(stderr, "Failed to open %s while writing package: %s\n",
                     filelist[i].realfile, strerror(errno));
             goto error_close_pkg;
         }
-        const uint32_t filesize = index[filelist[i].index_entry].filesize;
+        const uint32_t filesize = entry->filesize;
         char buf[65536];
         uint32_t copied = 0;
         while (copied < filesize) {
@@ -642,6 +708,79 @@ static int write_package(const char *filename, FileInfo *filelist,
 /*************************************************************************/
 /*************************************************************************/
 
+/**
+ * is_streamed_file:  指定されたファイルが、ゲーム側でパッケージから直接
+ * 読み込まれる（resource_open_as_file()でオープンされる）ファイルかどうか
+ * を返す。このようなファイルは圧縮するとオープンできなくなる。
+ *
+ * 【引　数】pathname: パッケージにおけるパス名
+ * 【戻り値】0以外＝直接読み込まれるファイル、0＝それ以外
+ */
+static int is_streamed_file(const char *pathname)
+{
+    PRECOND(pathname != NULL);
+
+    const char *ext = strrchr(pathname, '.');
+    return ext && (stricmp(ext, ".mp3") == 0 || stricmp(ext, ".ogg") == 0);
+}
+
+/*************************************************************************/
+
+/**
+ * deflate_file:  ファイルを読み込み、deflate方式（zlib形式）で圧縮する。
+ *
+ * 【引　数】realfile: 圧縮するファイルのパス名
+ * 　　　　　filesize: ファイルサイズ（バイト）
+ * 　　　　　 len_ret: 圧縮データ長（バイト）を格納する変数へのポインタ
+ * 【戻り値】圧縮データバッファ（free()で解放する。エラーの場合はNULL）
+ */
+static uint8_t *deflate_file(const char *realfile, uint32_t filesize,
+                             uint32_t *len_ret)
+{
+    PRECOND(realfile != NULL);
+    PRECOND(len_ret != NULL);
+
+    uint8_t *filedata = malloc(filesize);
+    uLongf complen = compressBound(filesize);
+    uint8_t *compdata = malloc(complen);
+    if (!filedata || !compdata) {
+        fprintf(stderr, "Out of memory compressing %s\n", realfile);
+        goto error_return;
+    }
+
+    FILE *f = fopen(realfile, "rb");
+    if (!f) {
+        fprintf(stderr, "Failed to open %s for compression: %s\n",
+                realfile, strerror(errno));
+        goto error_return;
+    }
+    const uint32_t nread = fread(filedata, 1, filesize, f);
+    fclose(f);
+    if (nread != filesize) {
+        fprintf(stderr, "Failed to read %s for compression\n", realfile);
+        goto error_return;
+    }
+
+    const int res = compress2(compdata, &complen, filedata, filesize,
+                              Z_BEST_COMPRESSION);
+    if (res != Z_OK) {
+        fprintf(stderr, "Failed to compress %s (zlib error %d)\n",
+                realfile, res);
+        goto error_return;
+    }
+
+    free(filedata);
+    *len_ret = complen;
+    return compdata;
+
+  error_return:
+    free(filedata);
+    free(compdata);
+    return NULL;
+}
+
+/*************************************************************************/
+
 /**
  * pkg_sort:  PKGIndexEntry構造体の配列をソートする。クイックソートアルゴ
  * リズムを使う。
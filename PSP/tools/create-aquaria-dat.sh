@@ -64,7 +64,9 @@ echo "Building data file list..."
     > "$TMPFILE"
 
 echo "Creating ${DIR}/aquaria.dat..."
-(cd "${DIR}"; "${ORIGDIR}/build-pkg" "${TMPFILE}" aquaria.dat)
+# -z stores each file compressed when that makes it smaller (sound files
+# excepted); the game inflates them as they are read.
+(cd "${DIR}"; "${ORIGDIR}/build-pkg" -z "${TMPFILE}" aquaria.dat)
 
 echo ""
 echo "The package file ${DIR}/aquaria.dat was successfully created."
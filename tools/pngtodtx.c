@@ -0,0 +1,492 @@
+/*
+Copyright (C) 2007, 2010 - Bit-Blot
+
+This file is part of Aquaria.
+
+Aquaria is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+
+See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+*/
+
+/*
+ * tools/pngtodtx.c: Program to convert PNG images to the *.dtx texture
+ * cache format loaded by the desktop engine (see BBGE/TextureCache.h).
+ *
+ * To use, run this program as:
+ *
+ *     pngtodtx [-g viewing-gamma] file1.png [file2.png...]
+ *
+ * This will save the converted data for each named PNG file next to it,
+ * with an extension of .dtx replacing the .png extension.  The pixel data
+ * is processed exactly as the game's PNG loader would process it, so the
+ * -g option (or the VIEWING_GAMMA environment variable) must match the
+ * setting used when running the game; the game ignores cache files
+ * written for a different gamma.  Images the cache format cannot
+ * represent exactly (16-bit channels, palette transparency, and so on)
+ * are skipped with a warning and will continue to be loaded from the PNG.
+ *
+ * The game only uses a cache file if it is at least as new as its PNG,
+ * so simply rerun this program after modifying any images.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../ExternalLibs/glpng/png/png.h"
+#include "../BBGE/TextureCache.h"
+
+/*************************************************************************/
+
+/* Decoded image data. */
+typedef struct Image_ {
+    unsigned int width, height;   // Size of the source image
+    unsigned int data_width;      // Size of the (power-of-two) pixel data
+    unsigned int data_height;
+    int components;               // 3 = RGB, 4 = RGBA
+    unsigned char *pixels;
+} Image;
+
+static double screen_gamma = 2.2;
+
+static int convert_file(const char *path);
+static int read_png(const char *path, Image *image);
+static void find_empty_edges(const Image *image, DTXFileHeader *header);
+static int write_dtx(const char *path, const Image *image);
+static unsigned int power_of_two(unsigned int size);
+static void resize(int components, const unsigned char *src,
+                   unsigned int sw, unsigned int sh,
+                   unsigned char *dest, unsigned int dw, unsigned int dh);
+static void half_size(int components, unsigned int width, unsigned int height,
+                      const unsigned char *src, unsigned char *dest);
+
+/*************************************************************************/
+/*************************************************************************/
+
+/**
+ * main:  Program entry point.  Parses command-line parameters and
+ * converts each named file.
+ *
+ * [Parameters]
+ *     argc: Command line argument count
+ *     argv: Command line argument vector
+ * [Return value]
+ *     Zero on successful completion, nonzero if an error occurred
+ */
+int main(int argc, char **argv)
+{
+    const char *gamma_env = getenv("VIEWING_GAMMA");
+    if (gamma_env) {
+        screen_gamma = 2.2 / atof(gamma_env);
+    }
+
+    int argi = 1;
+    while (argi < argc && argv[argi][0] == '-') {
+        if (strcmp(argv[argi], "-g") == 0 && argi+1 < argc
+         && atof(argv[argi+1]) > 0) {
+            screen_gamma = 2.2 / atof(argv[argi+1]);
+            argi += 2;
+        } else {
+            goto usage;
+        }
+    }
+    if (argi >= argc) {
+      usage:
+        fprintf(stderr, "Usage: %s [-g viewing-gamma] file1.png [file2.png...]\n",
+                argv[0]);
+        return 1;
+    }
+
+    int errors = 0;
+    for (; argi < argc; argi++) {
+        if (!convert_file(argv[argi])) {
+            errors = 1;
+        }
+    }
+    return errors;
+}
+
+/*************************************************************************/
+
+/**
+ * convert_file:  Convert a single PNG file to a cache file.  Files which
+ * cannot be represented in the cache format are skipped (and treated as
+ * successfully processed).
+ *
+ * [Parameters]
+ *     path: Pathname of PNG file
+ * [Return value]
+ *     Nonzero on success, zero on error
+ */
+static int convert_file(const char *path)
+{
+    const size_t pathlen = strlen(path);
+    if (pathlen < 4 || strcmp(path + pathlen-4, ".png") != 0) {
+        fprintf(stderr, "%s: Filename does not end in .png\n", path);
+        return 0;
+    }
+
+    Image image;
+    const int result = read_png(path, &image);
+    if (result < 0) {
+        return 1;  // Skipped.
+    } else if (result == 0) {
+        return 0;
+    }
+
+    char *outpath = malloc(pathlen + 1);
+    if (!outpath) {
+        fprintf(stderr, "%s: Out of memory\n", path);
+        free(image.pixels);
+        return 0;
+    }
+    memcpy(outpath, path, pathlen - 4);
+    strcpy(outpath + pathlen - 4, ".dtx");
+    const int ok = write_dtx(outpath, &image);
+    free(outpath);
+    free(image.pixels);
+    return ok;
+}
+
+/*************************************************************************/
+
+/**
+ * read_png:  Read a PNG file and convert it to power-of-two RGB or RGBA
+ * pixel data, applying the same transformations as the game's loader.
+ *
+ * [Parameters]
+ *      path: Pathname of PNG file
+ *     image: Image structure to fill in
+ * [Return value]
+ *     Positive on success, negative if the image should be skipped,
+ *     zero on error
+ */
+static int read_png(const char *path, Image *image)
+{
+    FILE *f = fopen(path, "rb");
+    if (!f) {
+        perror(path);
+        return 0;
+    }
+
+    unsigned char signature[8];
+    if (fread(signature, 1, 8, f) != 8 || !png_check_sig(signature, 8)) {
+        fprintf(stderr, "%s: Not a PNG file\n", path);
+        fclose(f);
+        return 0;
+    }
+
+    png_structp png = png_create_read_struct(PNG_LIBPNG_VER_STRING,
+                                             NULL, NULL, NULL);
+    png_infop info = png_create_info_struct(png);
+    png_infop endinfo = png_create_info_struct(png);
+    unsigned char *pixels = NULL;
+    png_bytep *rows = NULL;
+    if (setjmp(png->jmpbuf)) {
+        fprintf(stderr, "%s: Error reading PNG data\n", path);
+        png_destroy_read_struct(&png, &info, &endinfo);
+        free(rows);
+        free(pixels);
+        fclose(f);
+        return 0;
+    }
+
+    png_init_io(png, f);
+    png_set_sig_bytes(png, 8);
+    png_read_info(png, info);
+    png_uint_32 width, height;
+    int depth, color;
+    png_get_IHDR(png, info, &width, &height, &depth, &color, NULL, NULL, NULL);
+
+    if (color == PNG_COLOR_TYPE_GRAY || color == PNG_COLOR_TYPE_GRAY_ALPHA) {
+        png_set_gray_to_rgb(png);
+    }
+    if (color == PNG_COLOR_TYPE_PALETTE) {
+        png_set_expand(png);
+    }
+    double file_gamma;
+    if (png_get_gAMA(png, info, &file_gamma)) {
+        png_set_gamma(png, screen_gamma, file_gamma);
+    } else {
+        png_set_gamma(png, screen_gamma, 1.0/2.2);
+    }
+    png_read_update_info(png, info);
+
+    /* The loader decides between RGB and RGBA based on the original color
+     * type, so images whose decoded channel count differs from that (or
+     * which decode to 16-bit channels) can't be stored faithfully. */
+    const int components = (color & PNG_COLOR_MASK_ALPHA) ? 4 : 3;
+    const png_uint_32 rowbytes = png_get_rowbytes(png, info);
+    if (rowbytes != width * components) {
+        fprintf(stderr, "%s: Unsupported pixel format, skipping\n", path);
+        png_destroy_read_struct(&png, &info, &endinfo);
+        fclose(f);
+        return -1;
+    }
+
+    pixels = malloc(rowbytes * height);
+    rows = malloc(sizeof(*rows) * height);
+    if (!pixels || !rows) {
+        fprintf(stderr, "%s: Out of memory\n", path);
+        png_destroy_read_struct(&png, &info, &endinfo);
+        free(rows);
+        free(pixels);
+        fclose(f);
+        return 0;
+    }
+    png_uint_32 y;
+    for (y = 0; y < height; y++) {
+        rows[y] = pixels + y * rowbytes;
+    }
+    png_read_image(png, rows);
+    png_read_end(png, endinfo);
+    png_destroy_read_struct(&png, &info, &endinfo);
+    free(rows);
+    fclose(f);
+
+    image->width = width;
+    image->height = height;
+    image->data_width = power_of_two(width);
+    image->data_height = power_of_two(height);
+    image->components = components;
+    if (image->data_width != width || image->data_height != height) {
+        unsigned char *resized = malloc(image->data_width * image->data_height
+                                        * components);
+        if (!resized) {
+            fprintf(stderr, "%s: Out of memory\n", path);
+            free(pixels);
+            return 0;
+        }
+        resize(components, pixels, width, height,
+               resized, image->data_width, image->data_height);
+        free(pixels);
+        pixels = resized;
+    }
+    image->pixels = pixels;
+    return 1;
+}
+
+/*************************************************************************/
+
+/**
+ * find_empty_edges:  Count the fully transparent columns and rows on each
+ * edge of the image (in source image coordinates), leaving a 1-pixel
+ * margin so that bilinear filtering at the trimmed edge still blends
+ * toward transparency.
+ *
+ * [Parameters]
+ *      image: Image to examine
+ *     header: File header in which to store the results
+ */
+static void find_empty_edges(const Image *image, DTXFileHeader *header)
+{
+    header->empty_l = header->empty_r = 0;
+    header->empty_t = header->empty_b = 0;
+    if (image->components != 4
+     || image->data_width != image->width
+     || image->data_height != image->height) {
+        return;  // Only trim images whose data matches the source exactly.
+    }
+
+    const unsigned int w = image->width, h = image->height;
+    unsigned int left = w, right = 0, top = h, bottom = 0;
+    unsigned int x, y;
+    for (y = 0; y < h; y++) {
+        const unsigned char *p = image->pixels + (y * w) * 4;
+        for (x = 0; x < w; x++, p += 4) {
+            if (p[3] != 0) {
+                if (x < left) left = x;
+                if (x >= right) right = x+1;
+                if (y < top) top = y;
+                if (y >= bottom) bottom = y+1;
+            }
+        }
+    }
+    if (left >= right) {
+        return;  // Entirely transparent; leave it alone.
+    }
+
+    header->empty_l = left > 0 ? left-1 : 0;
+    header->empty_r = w-right > 0 ? (w-right)-1 : 0;
+    header->empty_t = top > 0 ? top-1 : 0;
+    header->empty_b = h-bottom > 0 ? (h-bottom)-1 : 0;
+}
+
+/*************************************************************************/
+
+/**
+ * write_dtx:  Write the given image, followed by its mipmaps, to a cache
+ * file.
+ *
+ * [Parameters]
+ *      path: Pathname of output file
+ *     image: Image to write
+ * [Return value]
+ *     Nonzero on success, zero on error
+ */
+static int write_dtx(const char *path, const Image *image)
+{
+    DTXFileHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, DTX_FILE_MAGIC, sizeof(header.magic));
+    header.version = DTX_FILE_VERSION;
+    header.components = image->components;
+    header.width = image->width;
+    header.height = image->height;
+    header.data_width = image->data_width;
+    header.data_height = image->data_height;
+    header.gamma = (float)screen_gamma;
+    header.pixels_offset = sizeof(header);
+    find_empty_edges(image, &header);
+
+    unsigned int w = image->data_width, h = image->data_height;
+    while (w > 1 || h > 1) {
+        header.mipmaps++;
+        if (w > 1) w /= 2;
+        if (h > 1) h /= 2;
+    }
+
+    FILE *f = fopen(path, "wb");
+    if (!f) {
+        perror(path);
+        return 0;
+    }
+    const size_t size = image->data_width * image->data_height
+                        * image->components;
+    unsigned char *mipmap = malloc(size/4 + 4);
+    if (!mipmap) {
+        fprintf(stderr, "%s: Out of memory\n", path);
+        fclose(f);
+        remove(path);
+        return 0;
+    }
+
+    int ok = fwrite(&header, sizeof(header), 1, f) == 1
+          && fwrite(image->pixels, size, 1, f) == 1;
+    const unsigned char *last = image->pixels;
+    w = image->data_width;
+    h = image->data_height;
+    while (ok && (w > 1 || h > 1)) {
+        half_size(image->components, w, h, last, mipmap);
+        if (w > 1) w /= 2;
+        if (h > 1) h /= 2;
+        ok = fwrite(mipmap, w * h * image->components, 1, f) == 1;
+        last = mipmap;
+    }
+    free(mipmap);
+
+    if (fclose(f) != 0) {
+        ok = 0;
+    }
+    if (!ok) {
+        fprintf(stderr, "%s: Write error\n", path);
+        remove(path);
+    }
+    return ok;
+}
+
+/*************************************************************************/
+/*************************************************************************/
+
+/**
+ * power_of_two:  Return the smallest power of two not less than the given
+ * size.
+ *
+ * [Parameters]
+ *     size: Image dimension
+ * [Return value]
+ *     Power-of-two dimension
+ */
+static unsigned int power_of_two(unsigned int size)
+{
+    unsigned int p = 1;
+    while (p < size && p < 1u<<23) {
+        p <<= 1;
+    }
+    return p;
+}
+
+/*************************************************************************/
+
+/**
+ * resize:  Resize an image using nearest-neighbor sampling, as the game's
+ * loader does.
+ *
+ * [Parameters]
+ *     components: Bytes per pixel
+ *            src: Source pixel data
+ *         sw, sh: Source image size
+ *           dest: Output buffer
+ *         dw, dh: Output image size
+ */
+static void resize(int components, const unsigned char *src,
+                   unsigned int sw, unsigned int sh,
+                   unsigned char *dest, unsigned int dw, unsigned int dh)
+{
+    const float sx = (float)sw/dw, sy = (float)sh/dh;
+    unsigned int x, y;
+    int c;
+    for (y = 0; y < dh; y++) {
+        const unsigned int yy = (unsigned int)(y*sy) * sw;
+        for (x = 0; x < dw; x++) {
+            const unsigned char *s = src + (yy + (unsigned int)(x*sx))*components;
+            for (c = 0; c < components; c++) {
+                *dest++ = *s++;
+            }
+        }
+    }
+}
+
+/*************************************************************************/
+
+/**
+ * half_size:  Generate the next mipmap level for an image by averaging
+ * each 2x2 (or 2x1) block of pixels, as the game's loader does.  The
+ * source and destination may be the same buffer.
+ *
+ * [Parameters]
+ *       components: Bytes per pixel
+ *    width, height: Source image size (at least one must be >1)
+ *              src: Source pixel data
+ *             dest: Output buffer
+ */
+static void half_size(int components, unsigned int width, unsigned int height,
+                      const unsigned char *src, unsigned char *dest)
+{
+    const unsigned int line = width * components;
+    const unsigned int xstep = width > 1 ? components : 0;
+    const unsigned int ystep = height > 1 ? line : 0;
+    const unsigned int xinc = width > 1 ? 2 : 1;
+    const unsigned int yinc = height > 1 ? 2 : 1;
+    const int shift = (xstep && ystep) ? 2 : 1;
+    unsigned int x, y;
+    int c;
+
+    for (y = 0; y < height; y += yinc) {
+        const unsigned char *s = src + y * line;
+        for (x = 0; x < width; x += xinc, s += xinc * components) {
+            for (c = 0; c < components; c++) {
+                int sum;
+                if (xstep && ystep) {
+                    sum = s[c] + s[c+xstep] + s[c+ystep] + s[c+xstep+ystep];
+                } else {
+                    sum = s[c] + s[c+xstep+ystep];
+                }
+                *dest++ = sum >> shift;
+            }
+        }
+    }
+}
+
+/*************************************************************************/